@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <random>
+#include <vector>
+#include "graph.hpp"
+#include "importedgraph.hpp"
+#include "randomgraph.hpp"
+#include "warehousegraph.hpp"
+
+namespace
+{
+    // Graph exposing the builder so benchmarks can lay out maps by hand
+    class BenchGraph : public graph::Graph
+    {
+    public:
+        using graph::Graph::_addEdge;
+        using graph::Graph::_addNode;
+        using graph::Graph::_freeze;
+    };
+
+    // Milliseconds spent running task
+    template <typename Task>
+    double timeMs(Task &&task)
+    {
+        auto start = std::chrono::steady_clock::now();
+        task();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Builds num_nodes nodes on a square lattice, each linked to degree / 2 random others
+    void buildDense(BenchGraph &g, int num_nodes, int degree)
+    {
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<> dist(0, num_nodes - 1);
+        int side = 1;
+        while (side * side < num_nodes)
+            side++;
+        for (int k = 0; k < num_nodes; ++k)
+            g._addNode(k, (k % side) * SCALE, (k / side) * SCALE, graph::Property::node);
+        for (int k = 0; k < num_nodes; ++k)
+            for (int e = 0; e < degree / 2; ++e)
+                g._addEdge(k, dist(gen), 1);
+        g._freeze();
+    }
+
+    // Builds a full side x side lattice
+    void buildLattice(BenchGraph &g, int side)
+    {
+        for (int k = 0; k < side * side; ++k)
+            g._addNode(k, (k % side) * SCALE, (k / side) * SCALE, graph::Property::node);
+        for (int k = 0; k < side * side; ++k)
+        {
+            if (k % side + 1 < side)
+                g._addEdge(k, k + 1);
+            if (k + side < side * side)
+                g._addEdge(k, k + side);
+        }
+        g._freeze();
+    }
+
+    // Builds a full side x side lattice with the nodes added in a random order, as a random walk generator leaves them
+    void buildScrambledLattice(BenchGraph &g, int side)
+    {
+        std::vector<int> ids(side * side);
+        for (int k = 0; k < side * side; ++k)
+            ids[k] = k;
+        std::shuffle(ids.begin(), ids.end(), std::mt19937(42));
+        for (int id : ids)
+            g._addNode(id, (id % side) * SCALE, (id / side) * SCALE, graph::Property::node);
+        for (int id = 0; id < side * side; ++id)
+        {
+            if (id % side + 1 < side)
+                g._addEdge(g.getNodeIndex(id), g.getNodeIndex(id + 1));
+            if (id + side < side * side)
+                g._addEdge(g.getNodeIndex(id), g.getNodeIndex(id + side));
+        }
+        g._freeze();
+    }
+
+    // Average BFS query time, bypassing the path cache
+    double timeBfs(graph::Graph &g, int queries)
+    {
+        graph::SearchWorkspace workspace;
+        std::vector<int> path;
+        const int n = g.getNumNodes();
+        double ms = timeMs([&]
+                           {
+            for (int q = 0; q < queries; ++q)
+                g.getShortestPath((q * 7919) % n, (q * 104729 + n / 2) % n, workspace, path, graph::SearchAlgorithm::bfs, false); });
+        return ms / queries;
+    }
+
+    // Average isEdge lookup time in nanoseconds, found counts the existing edges
+    double timeIsEdge(const graph::Graph &g, int lookups, int &found)
+    {
+        const int n = g.getNumNodes();
+        found = 0;
+        double ms = timeMs([&]
+                           {
+            int i = 0;
+            int j = n / 2;
+            for (int q = 0; q < lookups; ++q)
+            {
+                found += g.isEdge(i, j);
+                i = (i + 7919) % n;
+                j = (j + 104729) % n;
+            } });
+        return ms * 1e6 / lookups;
+    }
+
+    // Compares both backends on one graph
+    void compareBackends(const char *name, graph::Graph &g)
+    {
+        std::printf("%s: %d nodes, %d edges\n", name, g.getNumNodes(), g.getNumEdges());
+        for (auto backend : {graph::AdjacencyBackend::csr, graph::AdjacencyBackend::bitset})
+        {
+            g.setAdjacencyBackend(backend);
+            const char *label = backend == graph::AdjacencyBackend::csr ? "csr" : "bitset";
+            double bfs = timeBfs(g, 2000);
+            int found = 0;
+            double is_edge = timeIsEdge(g, 1000000, found);
+            std::printf("  %-6s  bfs %8.4f ms/query  isEdge %6.2f ns (%d hits)\n", label, bfs, is_edge, found);
+        }
+    }
+    // BFS throughput over the same pairs of node identifiers, in insertion order then along the Hilbert curve
+    void compareOrdering(const char *name, graph::Graph &g, int queries)
+    {
+        const int n = g.getNumNodes();
+        std::vector<std::pair<int, int>> pairs;
+        for (int q = 0, a = 0, b = n / 2; q < queries; ++q, a = (a + 7919) % n, b = (b + 104729) % n)
+            pairs.emplace_back(g.getNode(a).getId(), g.getNode(b).getId());
+
+        auto run = [&]
+        {
+            graph::SearchWorkspace workspace;
+            std::vector<int> path;
+            return timeMs([&]
+                          {
+                for (auto [a, b] : pairs)
+                    g.getShortestPath(g.getNodeIndex(a), g.getNodeIndex(b), workspace, path, graph::SearchAlgorithm::bfs, false); }) /
+                   queries;
+        };
+        std::printf("%s: %d nodes, %d edges\n", name, n, g.getNumEdges());
+        double before = run();
+        g.renumberNodes();
+        double after = run();
+        std::printf("  insertion order %8.3f ms/query (%7.1f queries/s)  Hilbert order %8.3f ms/query (%7.1f queries/s)\n",
+                    before, 1000.0 / before, after, 1000.0 / after);
+    }
+
+    // Writes the graph to a graph file and maps it back
+    void timeGraphFile(const char *name, graph::Graph &g)
+    {
+        const char *path = "bench_graph.bin";
+        BenchGraph loaded;
+        bool ok = true;
+        double save = timeMs([&]
+                             { ok = g.saveToFile(path); });
+        double load = timeMs([&]
+                             { ok = ok && loaded.loadFromFile(path); });
+        std::printf("%s: %d nodes, save %8.2f ms, load %8.2f ms%s\n", name, g.getNumNodes(), save, load, ok ? "" : " (failed)");
+        std::remove(path);
+    }
+
+    // Writes a side x side warehouse grid map (shelf rows cut by cross aisles) and imports it
+    void timeGridImport(int side)
+    {
+        const char *path = "bench_map.txt";
+        {
+            std::ofstream out(path);
+            std::string row(side, '.');
+            for (int y = 0; y < side; ++y)
+            {
+                for (int x = 0; x < side; ++x)
+                    row[x] = y % 4 == 1 && x % 20 != 0 ? '#' : x % 97 == 3 ? 'P' : x % 331 == 5 ? 'C' : '.';
+                out << row << '\n';
+            }
+        }
+        graph::ImportedGraph g;
+        bool ok = true;
+        double ms = timeMs([&]
+                           { ok = g.importFile(path); });
+        std::printf("Grid map import, %d x %d cells: %d nodes, %d edges in %8.2f ms%s\n", side, side, g.getNumNodes(),
+                    g.getNumEdges(), ms, ok ? "" : " (failed)");
+        std::remove(path);
+    }
+
+    // Generates random warehouses of growing size, 1% waiting, 1% charging and 5% pick-drop nodes
+    void timeGeneration()
+    {
+        for (int num_nodes : {1000, 10000, 100000, 1000000})
+        {
+            graph::RandomGraph g;
+            double ms = timeMs([&]
+                               { g.genRandomGraph(num_nodes, num_nodes / 100, num_nodes / 100, num_nodes / 20); });
+            std::printf("Random graph, %7d nodes requested: %7d nodes, %7d edges in %9.2f ms\n", num_nodes, g.getNumNodes(),
+                        g.getNumEdges(), ms);
+        }
+    }
+
+    // Generates warehouse templates of growing size, the tiles are built on every core
+    void timeWarehouse()
+    {
+        for (int num_aisles : {25, 250})
+        {
+            graph::WarehouseLayout layout;
+            layout.num_aisles = num_aisles;
+            layout.aisle_length = 2000;
+            layout.cross_aisle_spacing = 20;
+            graph::WarehouseGraph g;
+            bool ok = true;
+            double ms = timeMs([&]
+                               { ok = g.genWarehouseGraph(layout); });
+            std::printf("Warehouse, %3d aisles of %d cells: %7d nodes, %7d edges in %9.2f ms%s\n", num_aisles,
+                        layout.aisle_length, g.getNumNodes(), g.getNumEdges(), ms, ok ? "" : " (failed)");
+        }
+    }
+
+    // Streams a warehouse template straight into a graph file, then loads it
+    void timeWarehouseFile(int num_aisles)
+    {
+        const char *path = "bench_warehouse.bin";
+        graph::WarehouseLayout layout;
+        layout.num_aisles = num_aisles;
+        layout.aisle_length = 2000;
+        layout.cross_aisle_spacing = 20;
+        BenchGraph loaded;
+        bool ok = true;
+        double stream = timeMs([&]
+                               { ok = graph::WarehouseGraph::genWarehouseFile(layout, path); });
+        double load = timeMs([&]
+                             { ok = ok && loaded.loadFromFile(path); });
+        std::printf("Streamed warehouse, %d aisles: %d nodes, stream %8.2f ms, load %8.2f ms%s\n", num_aisles,
+                    loaded.getNumNodes(), stream, load, ok ? "" : " (failed)");
+        std::remove(path);
+    }
+
+    // Robot x task cost matrix: one query per pair, then the same pairs as a batch
+    void compareBatch(const char *name, graph::Graph &g, int num_robots, int num_tasks)
+    {
+        const int n = g.getNumNodes();
+        std::vector<std::pair<int, int>> queries;
+        for (int r = 0; r < num_robots; ++r)
+            for (int t = 0; t < num_tasks; ++t)
+                queries.emplace_back((r * 7919) % n, (t * 104729 + n / 3) % n);
+
+        graph::SearchWorkspace workspace;
+        std::vector<int> path;
+        std::vector<int> costs(queries.size());
+        double single = timeMs([&]
+                               {
+            for (std::size_t k = 0; k < queries.size(); ++k)
+            {
+                g.getShortestPath(queries[k].first, queries[k].second, workspace, path, graph::SearchAlgorithm::dijkstra, false);
+                costs[k] = g.getPathCost(path);
+            } });
+        double batch = timeMs([&]
+                              { g.getShortestPaths(queries, costs); });
+        std::printf("%s: %d x %d matrix, single queries %8.2f ms, batch %8.2f ms\n", name, num_robots, num_tasks, single, batch);
+    }
+} // namespace
+
+int benchgraph(int, char **)
+{
+    for (int degree : {16, 64, 256})
+    {
+        BenchGraph dense;
+        buildDense(dense, 4096, degree);
+        char name[64];
+        std::snprintf(name, sizeof(name), "Dense, average degree %d", degree);
+        compareBackends(name, dense);
+    }
+
+    graph::RandomGraph lattice;
+    lattice.genRandomGraph(4000, 40, 40, 400);
+    compareBackends("Generated lattice", lattice);
+
+    BenchGraph grid;
+    buildLattice(grid, 200);
+    compareBatch("200 x 200 lattice", grid, 32, 64);
+
+    for (int side : {300, 1000})
+    {
+        BenchGraph scrambled;
+        buildScrambledLattice(scrambled, side);
+        char name[64];
+        std::snprintf(name, sizeof(name), "Scrambled %d x %d lattice", side, side);
+        compareOrdering(name, scrambled, side == 1000 ? 50 : 200);
+    }
+
+    timeGridImport(2000);
+    timeGeneration();
+    timeWarehouse();
+    timeWarehouseFile(250);
+
+    for (int side : {1000, 2000})
+    {
+        BenchGraph large;
+        buildLattice(large, side);
+        char name[64];
+        std::snprintf(name, sizeof(name), "Graph file, %d x %d lattice", side, side);
+        timeGraphFile(name, large);
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#ifndef CONTRACTIONHIERARCHY_HPP
+#define CONTRACTIONHIERARCHY_HPP
+
+#include "graphfile.hpp"
+#include "searchworkspace.hpp"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#define CH_WITNESS_SETTLE_LIMIT 100 // Nodes a witness search settles before giving up (may add superfluous shortcuts)
+#define CH_PRIORITY_SETTLE_LIMIT 30 // Same limit while estimating the priority of a node, which only needs an approximation
+
+namespace graph
+{
+    class Graph;
+
+    // Contraction hierarchy over the travel times of a graph. Nodes are contracted in rounds of
+    // independent nodes, shortcuts keep the distances between the remaining ones, and a query
+    // only follows arcs towards higher ranked nodes from both ends.
+    class ContractionHierarchy
+    {
+    public:
+        // Contracts every node of the graph, spreading each round over all cores
+        explicit ContractionHierarchy(const Graph &graph) noexcept;
+
+        // Writes the cheapest path into path using one workspace per search direction, returns false if unreachable
+        bool getPath(int i, int j, SearchWorkspace &forward, SearchWorkspace &backward, std::vector<int> &path) const noexcept;
+
+        // Appends the rank, offset and arc sections to a graph file
+        void saveToFile(GraphFileWriter &writer) const noexcept;
+
+        // Reads the hierarchy back from a graph file of num_nodes nodes (nullptr if it holds none or it is inconsistent)
+        static std::shared_ptr<const ContractionHierarchy> loadFromFile(const GraphFileReader &reader, int num_nodes) noexcept;
+
+        // Getters for the preprocessing statistics
+        int getNumShortcuts() const noexcept;
+        double getBuildTime() const noexcept; // Milliseconds
+        std::size_t getMemoryUsage() const noexcept;
+
+    private:
+        ContractionHierarchy() noexcept = default;
+
+        // Arc towards a higher ranked node, middle is the contracted node a shortcut bypasses (-1 for an edge)
+        struct Arc
+        {
+            int target;
+            int weight;
+            int middle;
+        };
+
+        // Shortcut found while contracting a node
+        struct Shortcut
+        {
+            int from;
+            int to;
+            int weight;
+        };
+
+        int _num_nodes = 0;
+        std::vector<int> _rank;    // Contraction order of each node
+        std::vector<int> _offsets; // Upward arcs of v are in [_offsets[v], _offsets[v + 1])
+        std::vector<Arc> _arcs;    // Upward arcs of every node
+        int _num_shortcuts = 0;
+        double _build_time = 0.0;
+
+        // Finds the shortcuts contracting v would need, returns their number
+        static int _simulateContraction(int v, const std::vector<std::vector<Arc>> &remaining, SearchWorkspace &workspace,
+                                        std::vector<Shortcut> *shortcuts) noexcept;
+
+        // Adds an arc, or lowers the weight of an existing one, returns true if the arc changed
+        static bool _addOrImprove(std::vector<Arc> &arcs, const Arc &arc) noexcept;
+
+        // Runs a Dijkstra search following upward arcs only
+        void _searchUpward(int source, SearchWorkspace &workspace) const noexcept;
+
+        // Finds the arc between two nodes, it is stored at the lower ranked one
+        const Arc *_findArc(int a, int b) const noexcept;
+
+        // Appends the original nodes of the arc a -> b (excluding a) to path
+        void _unpack(int a, int b, std::vector<int> &path) const noexcept;
+    };
+} // namespace graph
+
+#endif // CONTRACTIONHIERARCHY_HPP
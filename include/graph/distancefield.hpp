@@ -0,0 +1,61 @@
+#ifndef DISTANCEFIELD_HPP
+#define DISTANCEFIELD_HPP
+
+#include "node.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace graph
+{
+    class Graph;
+
+    // Hop distance from every node to the closest node of one property, with that node
+    // and the next hop towards it, so "nearest charging station" is a single lookup
+    class DistanceField
+    {
+    public:
+        // Builds the field with one BFS seeded from every node of the property
+        DistanceField(const Graph &graph, Property prop) noexcept;
+
+        // Brings the field up to date after the edge between node_1 and node_2 was added or removed.
+        // Only the nodes whose route to a source changes are visited
+        void repairEdge(const Graph &graph, int node_1, int node_2) noexcept;
+
+        // Extends the field to the node appended last, which has no edge yet
+        void repairAddedNode(const Graph &graph) noexcept;
+
+        // Follows the last node of the field moving to index node, whose own node was removed once isolated
+        void repairRemovedNode(const Graph &graph, int node) noexcept;
+
+        // Returns the property the field measures the distance to
+        Property getProperty() const noexcept;
+
+        // Returns the epoch of the graph the field was built from
+        std::uint64_t getEpoch() const noexcept;
+
+        // Returns the number of hops from node to the closest source (-1 if none is reachable)
+        int getDistance(int node) const noexcept;
+
+        // Returns the closest source of node (-1 if none is reachable)
+        int getNearestSource(int node) const noexcept;
+
+        // Returns the neighbour of node on a shortest path to its closest source (node itself for a source, -1 if unreachable)
+        int getNextHop(int node) const noexcept;
+
+        // Writes the route from node to its closest source into path, returns false if unreachable
+        bool getPath(int node, std::vector<int> &path) const noexcept;
+
+        // Returns the number of bytes held by the field
+        std::size_t getMemoryUsage() const noexcept;
+
+    private:
+        Property _prop;
+        std::uint64_t _epoch;
+        std::vector<int> _distance; // Hops to the closest source, -1 if unreachable
+        std::vector<int> _nearest;  // Closest source, -1 if unreachable
+        std::vector<int> _next_hop; // Parent in the BFS forest, -1 if unreachable
+    };
+} // namespace graph
+
+#endif // DISTANCEFIELD_HPP
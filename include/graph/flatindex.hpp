@@ -0,0 +1,82 @@
+#ifndef FLATINDEX_HPP
+#define FLATINDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#define FLAT_INDEX_MIN_CAPACITY 16 // Slots allocated by the first insertion
+#define FLAT_INDEX_BUILD_WINDOW 8   // build() inserts the keys 2^8 slots at a time, in order
+
+namespace graph
+{
+    // Open addressing map from 64-bit keys to node indices, probed linearly. The table is two plain
+    // arrays, so it can be written to a graph file and copied back without rehashing anything.
+    class FlatIndex
+    {
+    public:
+        // Returns the value stored for key (-1 if there is none)
+        int find(std::uint64_t key) const noexcept
+        {
+            if (_values.empty())
+            {
+                return -1;
+            }
+            for (std::size_t slot = _slotOf(key);; slot = (slot + 1) & _mask)
+            {
+                if (_values[slot] == -1 || _keys[slot] == key)
+                {
+                    return _values[slot];
+                }
+            }
+        }
+
+        // Stores value for key unless the key is already present, value must not be negative
+        void insert(std::uint64_t key, int value) noexcept;
+
+        // Removes a key, returns false if it was not there
+        bool erase(std::uint64_t key) noexcept;
+
+        // Replaces the content by keys[i] -> i for every i (the first of equal keys wins)
+        void build(std::span<const std::uint64_t> keys) noexcept;
+
+        // Makes room for num_keys keys without growing
+        void reserve(std::size_t num_keys) noexcept;
+
+        // Removes every key
+        void clear() noexcept;
+
+        // Replaces every stored value v by new_values[v]
+        void remap(std::span<const int> new_values) noexcept;
+
+        // Returns the number of keys
+        std::size_t size() const noexcept;
+
+        // Returns the slots, empty ones hold the value -1
+        std::span<const std::uint64_t> getKeys() const noexcept;
+        std::span<const int> getValues() const noexcept;
+
+        // Takes the slots of another table, returns false (leaving the index empty) unless their number is a
+        // power of two and every value is -1 or below max_value
+        bool assign(std::span<const std::uint64_t> keys, std::span<const int> values, int max_value) noexcept;
+
+    private:
+        std::vector<std::uint64_t> _keys; // Key of each slot
+        std::vector<int> _values;         // Value of each slot, -1 for an empty slot
+        std::size_t _mask = 0;            // Number of slots - 1
+        std::size_t _size = 0;            // Number of keys
+        int _shift = 64;                  // 64 - log2(number of slots)
+
+        // Fibonacci hashing, the top bits of the product pick the slot
+        std::size_t _slotOf(std::uint64_t key) const noexcept
+        {
+            return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> _shift) & _mask;
+        }
+
+        // Reallocates num_slots slots (a power of two) and inserts the keys again
+        void _rehash(std::size_t num_slots) noexcept;
+    };
+} // namespace graph
+
+#endif // FLATINDEX_HPP
@@ -1,30 +1,204 @@
 #ifndef GRAPH_HPP
 #define GRAPH_HPP
 
+#include "flatindex.hpp"
+#include "hierarchicalgraph.hpp"
+#include "landmarks.hpp"
 #include "node.hpp"
+#include "pathcache.hpp"
+#include "rng.hpp"
+#include "searchworkspace.hpp"
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <span>
 #include <string>
+#include <utility>
+
+#define SCALE 50               // 50 pixels between nodes
+#define SNAP_MAX_RADIUS 8      // Lattice rings searched by getNearestNode before falling back to a full scan
+#define BITSET_MAX_NODES 16384 // Largest graph given bitset rows (N^2 / 8 bytes, 32 MB at the limit)
+#define BFS_ALPHA 14           // Bitset BFS goes bottom-up once the frontier has more than 1 / ALPHA of the unexplored edges
+#define BFS_BETA 24            // and back top-down once the frontier holds less than 1 / BETA of the nodes
 
 namespace graph
 {
+    class ContractionHierarchy;
+    class DistanceField;
+    class RoutingTable;
+
+    // Path finding engines that can be picked for each query
+    enum class SearchAlgorithm
+    {
+        bfs,                   // Uninformed breadth-first search, fewest hops
+        astar,                 // A* guided by the Manhattan distance between node coordinates, least travel time
+        routing_table,         // Walk of the precomputed routing table, A* when none is built
+        dijkstra,              // Dijkstra on a radix heap, least travel time
+        contraction_hierarchy, // Upward search in the contraction hierarchy, Dijkstra when none is built
+        alt,                   // A* bounded by landmark distances (ALT), plain A* when no landmarks are built
+        jump_point,            // Jump point search over the SCALE lattice, A* when the graph is not a uniform lattice
+        hierarchical,          // Route planned on the cluster graph (HPA*) then refined, Dijkstra when none is built
+        automatic              // Fastest engine available: routing table, contraction hierarchy, ALT, jump points, then A*
+    };
+
+    // Storage used for the adjacency queries of isEdge and the BFS engine
+    enum class AdjacencyBackend
+    {
+        csr,   // Sorted neighbour rows, compact for sparse layouts
+        bitset // One packed bit row per node next to the CSR store, direction-optimizing BFS for dense layouts
+    };
+
+    // Paths of a batch of queries packed back to back, the nodes of query k are in [offsets[k], offsets[k + 1])
+    struct BatchPaths
+    {
+        std::vector<int> offsets;
+        std::vector<int> nodes;
+    };
+
     class Graph
     {
     public:
-        // Retrieves the node by its index
-        const Node &getNode(int i) const noexcept;
+        Graph() noexcept = default;
+
+        // Copies the nodes, the edges and the precomputed structures of another graph, with an empty route cache.
+        // Edits are made on a copy of the published snapshot while robots keep routing on the original
+        Graph(const Graph &other) noexcept;
+        Graph &operator=(const Graph &) = delete;
+
+        // Retrieves a view of the node by its index
+        Node getNode(int i) const noexcept;
+
+        // Returns the coordinates of every node, indexed like the nodes
+        std::span<const int> getXs() const noexcept;
+        std::span<const int> getYs() const noexcept;
+
+        // Returns the indices of the nodes with the given property
+        std::span<const int> getNodesWith(Property prop) const noexcept;
+
+        // Returns the index of the node with the given identifier (-1 if there is none)
+        int getNodeIndex(int id) const noexcept;
+
+        // Returns the number of nodes in the graph
+        int getNumNodes() const noexcept;
+
+        // Returns the number of (undirected) edges stored in the frozen graph
+        int getNumEdges() const noexcept;
 
         // Checks if there's an edge between nodes i and j
         int isEdge(int i, int j) const noexcept;
 
-        // Returns a random pick-drop node index
-        int getRandomPickDrop() const noexcept;
+        // Tells whether every edge links lattice neighbours SCALE apart with the same travel time
+        bool isLattice() const noexcept;
+
+        // Returns the sorted neighbours of node i (empty until the graph is frozen)
+        std::span<const int> getNeighbours(int i) const noexcept;
+
+        // Returns the travel times of the edges of node i, in the order of getNeighbours(i)
+        std::span<const int> getEdgeWeights(int i) const noexcept;
+
+        // Returns the travel time of the edge between i and j (-1 if there is no edge)
+        int getEdgeWeight(int i, int j) const noexcept;
+
+        // Returns the total travel time of a path (-1 if two consecutive nodes are not connected)
+        int getPathCost(std::span<const int> path) const noexcept;
+
+        // Returns a random pick-drop node index drawn from rng
+        int getRandomPickDrop(Rng &rng) const noexcept;
 
         // Retrieves the node at the specified (x, y) coordinates
         int getNodeAt(int x, int y) const noexcept;
 
-        // Finds the shortest path between two nodes using BFS
-        std::vector<int> getShortestPath(int i, int j) const noexcept;
+        // Retrieves the node closest to the specified position (-1 if the graph is empty)
+        int getNearestNode(float x, float y) const noexcept;
+
+        // Finds the shortest path between two nodes (empty if unreachable)
+        std::vector<int> getShortestPath(int i, int j, SearchAlgorithm algorithm = SearchAlgorithm::bfs) const noexcept;
+
+        // Writes the shortest path into path using the caller's workspace, returns false if unreachable.
+        // use_cache = false skips the route cache, for callers that never repeat a query
+        bool getShortestPath(int i, int j, SearchWorkspace &workspace, std::vector<int> &path,
+                             SearchAlgorithm algorithm = SearchAlgorithm::bfs, bool use_cache = true) const noexcept;
+
+        // Answers a batch of (source, target) queries by travel time. Queries sharing a source are served by one
+        // Dijkstra tree and the sources are spread over all cores. costs[k] receives the travel time of query k
+        // (-1 if unreachable), paths (if given) receives the nodes of every route
+        void getShortestPaths(std::span<const std::pair<int, int>> queries, std::span<int> costs,
+                              BatchPaths *paths = nullptr) const noexcept;
+
+        // Returns the number of hops between two nodes (-1 if unreachable)
+        int getDistance(int i, int j) const noexcept;
+
+        // Builds the all-pairs routing table, returns false above ROUTING_TABLE_MAX_NODES
+        // or when edge weights differ (the table ranks routes by hops)
+        bool buildRoutingTable() noexcept;
+
+        // Returns the routing table (nullptr if it has not been built)
+        const RoutingTable *getRoutingTable() const noexcept;
+
+        // Builds the contraction hierarchy used for large graphs
+        void buildContractionHierarchy() noexcept;
+
+        // Returns the contraction hierarchy (nullptr if it has not been built)
+        const ContractionHierarchy *getContractionHierarchy() const noexcept;
+
+        // Picks landmarks and computes their distances for the ALT engine (k ints per node)
+        void buildLandmarks(int num_landmarks = ALT_NUM_LANDMARKS) noexcept;
+
+        // Returns the landmarks (nullptr if they have not been built)
+        const Landmarks *getLandmarks() const noexcept;
+
+        // Builds the cluster graph used for hierarchical planning
+        void buildHierarchy(int cluster_size = HPA_CLUSTER_SIZE) noexcept;
+
+        // Returns the cluster graph (nullptr if it has not been built), callers may keep it across threads
+        std::shared_ptr<const HierarchicalGraph> getHierarchy() const noexcept;
+
+        // Builds the distance field of every property for the current epoch
+        void buildDistanceFields() noexcept;
+
+        // Returns the distance field of a property, rebuilt first if the graph changed since it was built
+        std::shared_ptr<const DistanceField> getDistanceField(Property prop) const noexcept;
+
+        // Returns the node of the property closest to node in hops (-1 if none is reachable)
+        int getNearestWith(int node, Property prop) const noexcept;
+
+        // Selects the adjacency storage, returns false (keeping CSR) above BITSET_MAX_NODES
+        bool setAdjacencyBackend(AdjacencyBackend backend) noexcept;
+
+        // Returns the adjacency storage in use
+        AdjacencyBackend getAdjacencyBackend() const noexcept;
+
+        // Renumbers the nodes along a Hilbert curve over their lattice cells so that neighbours sit close in memory.
+        // Identifiers are kept but indices change, so indices held from before must be mapped again by identifier
+        void renumberNodes() noexcept;
+
+        // Writes the frozen graph to a binary graph file, with its contraction hierarchy and landmarks if built
+        bool saveToFile(const std::string &path) const noexcept;
+
+        // Replaces the graph by the content of a binary graph file mapped in memory, returns false
+        // (leaving the graph empty) if the file cannot be read or is inconsistent
+        bool loadFromFile(const std::string &path) noexcept;
+
+        // Adds a node without edges, returns its index (-1 if its identifier or its position is taken)
+        int addNode(int id, int x, int y, Property prop) noexcept;
+
+        // Removes a node and its edges, the last node takes its index. Returns false if i is not a node
+        bool removeNode(int i) noexcept;
+
+        // Adds an edge weighing its travel time (its Manhattan length if weight is -1),
+        // returns false if the nodes are not valid or already linked
+        bool addEdge(int i, int j, int weight = -1) noexcept;
+
+        // Removes the edge between i and j, returns false if there is none
+        bool removeEdge(int i, int j) noexcept;
+
+        // Returns the epoch of the graph, bumped whenever its nodes or edges change
+        std::uint64_t getEpoch() const noexcept;
+
+        // Returns the cache sitting in front of getShortestPath
+        PathCache &getPathCache() const noexcept;
 
         // Clears the graph
         void clear() noexcept;
@@ -33,17 +207,110 @@ namespace graph
         std::string getToJson() const noexcept;
 
     protected:
-        // Adds a node to the graph
-        void _addNode(int id, int x, int y, const Property &prop) noexcept;
+        // Adds a node to the graph. Bulk loaders that never look nodes up while they build can leave
+        // them out of the indexes, _indexNodes() then fills both indexes at once
+        void _addNode(int id, int x, int y, const Property &prop, bool indexed = true) noexcept;
+
+        // Adds an edge between nodes, weighing its travel time (its Manhattan length if weight is -1)
+        void _addEdge(int node_1, int node_2, int weight = -1) noexcept;
+
+        // Changes the property of a node while building, moving it between the property lists
+        void _setProperty(int i, const Property &prop) noexcept;
+
+        // Takes a node out of the list of its property, the last node of the list fills its slot
+        void _unlistProperty(int i) noexcept;
 
-        // Adds an edge between nodes
-        void _addEdge(int node_1, int node_2) noexcept;
+        // Reserves builder capacity ahead of a bulk load
+        void _reserve(int num_nodes, int num_edges) noexcept;
+
+        // Packs the edges added so far into the CSR neighbour store
+        void _freeze() noexcept;
+
+        // Rebuilds the spatial and identifier indexes from the node arrays
+        void _indexNodes() noexcept;
+
+        // Packs (x, y) coordinates into a single key for the spatial index
+        static std::uint64_t _coordinatesKey(int x, int y) noexcept;
 
     private:
-        std::vector<std::unique_ptr<Node>> _nodes; // Vector holding all nodes
-        std::vector<std::vector<int>> _edges; // Adjacency matrix representing edges
-        std::vector<int> _pickdropNodes;      // Vector holding indices of pickdrop nodes
+        // Search engines, they leave the predecessors of the found path in the workspace
+        bool _findPathBfs(int i, int j, SearchWorkspace &workspace) const noexcept;
+        bool _findPathBfsBitset(int i, int j, SearchWorkspace &workspace) const noexcept;
+        bool _findPathAStar(int i, int j, SearchWorkspace &workspace, const Landmarks *landmarks = nullptr) const noexcept;
+        bool _findPathDijkstra(int i, int j, SearchWorkspace &workspace) const noexcept;
+
+        // Jump point search, writes the full path itself since its search states are (node, direction) pairs
+        bool _findPathJumpPoint(int i, int j, SearchWorkspace &workspace, std::vector<int> &path) const noexcept;
+
+        // Lower bound on the travel time between two nodes, tightened by the landmarks if given
+        int _getHeuristic(int i, int j, const Landmarks *landmarks = nullptr) const noexcept;
+
+        // Lattice direction (up, right, down, left) of an offset between lattice neighbours, -1 for any other offset
+        static int _getLatticeDirection(int dx, int dy) noexcept;
+
+        // Moves the node arrays and the CSR rows so that the node at index order[k] becomes node k
+        void _permuteNodes(std::span<const int> order) noexcept;
+
+        // Drops the structures derived from the nodes and edges and moves to a new epoch
+        void _dropPrecomputed() noexcept;
+
+        // Freezes the pending edges before an edit, which works on the CSR rows
+        void _ensureFrozen() noexcept;
+
+        // Inserts j into the sorted row of i, or takes it out
+        void _insertArc(int i, int j, int weight) noexcept;
+        void _eraseArc(int i, int j) noexcept;
+
+        // Takes the edge between i and j out of the rows, the lattice links and the bit rows, without any repair
+        void _detachEdge(int i, int j) noexcept;
+
+        // Moves to a new epoch and repairs the precomputed structures after the edge between i and j was added or removed
+        void _repairEdge(int i, int j) noexcept;
+
+        // Sets or clears the lattice links between two nodes, or drops them if the edge does not fit the lattice
+        void _updateLatticeLinks(int i, int j, bool linked) noexcept;
+
+        // Rebuilds the bit rows from the CSR store
+        void _buildBitset() noexcept;
+
+        // Tells whether the bitset backend is active and its rows match the nodes
+        bool _hasBitsetRows() const noexcept;
+
+        // Edge waiting in the bulk builder
+        struct PendingEdge
+        {
+            int node_1;
+            int node_2;
+            int weight;
+        };
+
+        std::vector<int> _ids;                           // Node identifiers, the node arrays are indexed alike
+        std::vector<int> _xs;                            // Node x coordinates
+        std::vector<int> _ys;                            // Node y coordinates
+        std::vector<Property> _props;                    // Node properties
+        std::array<std::vector<int>, NUM_PROPERTIES> _property_nodes; // Indices of the nodes of each property
+        std::vector<int> _property_slots;                // Position of each node in the list of its property
+        std::vector<PendingEdge> _pending_edges;         // Edges added since the last freeze (bulk builder)
+        std::vector<int> _offsets;                       // CSR row offsets, neighbours of i are in [_offsets[i], _offsets[i + 1])
+        std::vector<int> _neighbours;                    // CSR neighbour array, sorted within each row
+        std::vector<int> _weights;                       // CSR travel times, parallel to _neighbours
+        std::vector<int> _lattice_links;                 // Neighbour of node i in lattice direction d at [i * 4 + d] (up, right, down, left), -1 if none
+        AdjacencyBackend _backend = AdjacencyBackend::csr; // Storage answering isEdge and BFS
+        int _bitset_words = 0;                           // Words per bit row
+        std::vector<std::uint64_t> _adjacency_bits;      // Bit rows of the bitset backend, row i starts at i * _bitset_words
+        FlatIndex _node_index;                           // Maps packed (x, y) coordinates to node indices
+        FlatIndex _id_index;                             // Maps node identifiers to node indices
+        double _min_weight_per_length = 1.0;             // Smallest travel time per pixel of an edge, scales the A* heuristic
+        bool _uniform_weights = true;                    // Every edge has the same travel time
+        std::shared_ptr<const RoutingTable> _routing_table; // Optional all-pairs routes, dropped whenever edges change
+        std::shared_ptr<const ContractionHierarchy> _contraction_hierarchy; // Optional shortcuts, dropped whenever edges change
+        std::shared_ptr<const Landmarks> _landmarks;     // Optional ALT distances, dropped whenever edges change
+        std::shared_ptr<const HierarchicalGraph> _hierarchy; // Optional cluster graph, dropped whenever edges change
+        mutable std::array<std::shared_ptr<const DistanceField>, NUM_PROPERTIES> _distance_fields; // Rebuilt lazily once the epoch moves
+        mutable std::mutex _distance_fields_mutex;       // Guards the distance fields against concurrent rebuilds
+        std::uint64_t _epoch = 1;                        // Version of the nodes and edges, tags the cached routes
+        std::unique_ptr<PathCache> _path_cache = std::make_unique<PathCache>(); // Routes already computed
     };
 } // namespace graph
 
-#endif // GRAPH_HPP
\ No newline at end of file
+#endif // GRAPH_HPP
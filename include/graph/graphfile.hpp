@@ -0,0 +1,110 @@
+#ifndef GRAPHFILE_HPP
+#define GRAPHFILE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+
+#define GRAPH_FILE_MAGIC 0x31485052474d43ull // "CMGRPH1" read as a little-endian word, rejects files of the other byte order
+#define GRAPH_FILE_VERSION 1                 // Bumped whenever the layout of a section changes
+#define GRAPH_FILE_ALIGNMENT 64              // Sections start on cache line boundaries
+#define GRAPH_FILE_UNIFORM_WEIGHTS 1u        // Header flag: every edge has the same travel time
+
+namespace graph
+{
+    // Arrays stored in a graph file, all of them made of 32-bit integers in host byte order
+    enum class GraphSection : std::uint32_t
+    {
+        ids,                // Node identifiers
+        xs,                 // Node x coordinates
+        ys,                 // Node y coordinates
+        props,              // Node properties
+        offsets,            // CSR row offsets (nodes + 1)
+        neighbours,         // CSR neighbour array
+        weights,            // CSR travel times
+        lattice_links,      // Jump point links (4 per node), empty unless the graph is a uniform lattice
+        property_offsets,   // Nodes of property p are property_nodes[property_offsets[p], property_offsets[p + 1])
+        property_nodes,     // Node indices grouped by property
+        spatial_keys,       // Slots of the coordinate index, 64-bit keys stored as two values each
+        spatial_values,     // Node index of each slot, -1 for an empty slot
+        id_keys,            // Slots of the identifier index, same layout
+        id_values,
+        ch_rank,            // Optional contraction hierarchy: contraction order of each node
+        ch_offsets,         // Upward arc offsets
+        ch_arcs,            // Upward arcs as (target, weight, middle) triples
+        landmark_nodes,     // Optional ALT landmarks
+        landmark_distances, // Node-major landmark distances
+        num_sections
+    };
+
+    // Fixed header at the start of a graph file, the sections follow it
+    struct GraphFileHeader
+    {
+        std::uint64_t magic = GRAPH_FILE_MAGIC;
+        std::uint32_t version = GRAPH_FILE_VERSION;
+        std::uint32_t flags = 0;            // GRAPH_FILE_* flags
+        double min_weight_per_length = 1.0; // Scales the A* heuristic
+        std::uint64_t num_shortcuts = 0;    // Statistics of the stored contraction hierarchy
+        std::array<std::uint64_t, static_cast<int>(GraphSection::num_sections)> offsets{}; // Byte offset of each section
+        std::array<std::uint64_t, static_cast<int>(GraphSection::num_sections)> sizes{};   // Number of values in each section
+    };
+
+    // Streams the sections of a graph file one after the other, the header is written last by finish()
+    class GraphFileWriter
+    {
+    public:
+        // Opens the file and reserves room for the header
+        explicit GraphFileWriter(const std::string &path) noexcept;
+
+        // Appends a section, aligned on GRAPH_FILE_ALIGNMENT bytes
+        void write(GraphSection section, std::span<const std::int32_t> values) noexcept;
+
+        // Appends values to the section written last, or starts the section if it is another one, so that
+        // a section can be streamed in chunks
+        void append(GraphSection section, std::span<const std::int32_t> values) noexcept;
+
+        // Gives access to the header fields before they are written
+        GraphFileHeader &getHeader() noexcept;
+
+        // Writes the header and closes the file, returns false if any write failed
+        bool finish() noexcept;
+
+    private:
+        std::ofstream _out;
+        GraphFileHeader _header;
+        GraphSection _current = GraphSection::num_sections; // Section written last
+    };
+
+    // Read-only mapping of a graph file. The sections are used in place from the mapping,
+    // which is released with the reader
+    class GraphFileReader
+    {
+    public:
+        // Maps the file and checks its header and section bounds. Unless populate is set, pages are only read
+        // when a section is scanned and the system may drop them again, for files larger than the memory
+        explicit GraphFileReader(const std::string &path, bool populate = true) noexcept;
+        ~GraphFileReader();
+
+        GraphFileReader(const GraphFileReader &) = delete;
+        GraphFileReader &operator=(const GraphFileReader &) = delete;
+
+        // Tells whether the file was mapped and its header is valid
+        bool isValid() const noexcept;
+
+        // Returns the header of the file
+        const GraphFileHeader &getHeader() const noexcept;
+
+        // Returns the values of a section, straight from the mapping
+        std::span<const std::int32_t> getSection(GraphSection section) const noexcept;
+
+    private:
+        const std::byte *_data = nullptr;
+        std::size_t _size = 0;
+        bool _valid = false;
+    };
+} // namespace graph
+
+#endif // GRAPHFILE_HPP
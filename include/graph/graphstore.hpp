@@ -0,0 +1,35 @@
+#ifndef GRAPHSTORE_HPP
+#define GRAPHSTORE_HPP
+
+#include "graph.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace graph
+{
+    // Publishes immutable graph snapshots (read-copy-update). A new graph is built off to the side,
+    // fully precomputed, then swapped in atomically. Readers pin the snapshot they loaded without
+    // taking any lock, and a replaced snapshot is freed once its last reader drops it.
+    class GraphStore
+    {
+    public:
+        // Starts with an empty graph so readers never see a null snapshot
+        GraphStore() noexcept;
+
+        // Returns the current snapshot, it stays valid for as long as the caller holds it
+        std::shared_ptr<const Graph> load() const noexcept;
+
+        // Makes graph the current snapshot, it must not be modified afterwards
+        void publish(std::shared_ptr<const Graph> graph) noexcept;
+
+        // Returns the number of snapshots published so far
+        std::uint64_t getVersion() const noexcept;
+
+    private:
+        std::atomic<std::shared_ptr<const Graph>> _current; // Snapshot handed to new readers
+        std::atomic<std::uint64_t> _version{0};             // Bumped by every publish
+    };
+} // namespace graph
+
+#endif // GRAPHSTORE_HPP
@@ -0,0 +1,83 @@
+#ifndef HIERARCHICALGRAPH_HPP
+#define HIERARCHICALGRAPH_HPP
+
+#include "searchworkspace.hpp"
+#include <cstddef>
+#include <vector>
+
+#define HPA_CLUSTER_SIZE 10 // Lattice cells along each side of a cluster
+
+namespace graph
+{
+    class Graph;
+
+    // Abstract graph for hierarchical path finding (HPA*). The map is cut into square clusters,
+    // every node with an edge leaving its cluster is an entrance, and entrances are linked by
+    // their inter-cluster edges and by their travel times within the cluster. Since every border
+    // node is an entrance, routes planned on the abstract graph are as cheap as exact ones.
+    // It reads the graph it was built from, which must stay unchanged while it is in use.
+    class HierarchicalGraph
+    {
+    public:
+        // Finds the entrances and runs the intra-cluster searches, one cluster at a time on each core
+        HierarchicalGraph(const Graph &graph, int cluster_size) noexcept;
+
+        // Copies a cluster graph so that it reads graph, a copy of the graph it was built from
+        HierarchicalGraph(const HierarchicalGraph &other, const Graph &graph) noexcept;
+
+        // Brings the abstract graph up to date after the edge between node_1 and node_2 was added or removed.
+        // Only the entrances of the clusters of both nodes are searched again, the others keep their links
+        void repairEdge(int node_1, int node_2) noexcept;
+
+        // Plans a route on the abstract graph: writes i, the entrances crossed, then j into waypoints
+        // Returns false if j cannot be reached
+        bool getAbstractPath(int i, int j, std::vector<int> &waypoints) const noexcept;
+
+        // Appends the nodes of the route between two consecutive waypoints (excluding from) to path
+        bool refineSegment(int from, int to, std::vector<int> &path) const noexcept;
+
+        // Plans and refines the whole route at once, returns false if unreachable
+        bool getPath(int i, int j, std::vector<int> &path) const noexcept;
+
+        // Returns the cluster of a node
+        int getCluster(int node) const noexcept;
+
+        // Getters for the preprocessing statistics
+        int getNumClusters() const noexcept;
+        int getNumEntrances() const noexcept;
+        double getBuildTime() const noexcept; // Milliseconds
+        std::size_t getMemoryUsage() const noexcept;
+
+    private:
+        // Abstract edge towards another entrance
+        struct Link
+        {
+            int target; // Entrance index
+            int weight;
+        };
+
+        const Graph *_graph;
+        std::vector<int> _cluster;            // Cluster of each node
+        std::vector<int> _entrance_of;        // Entrance index of each node, -1 for interior nodes
+        std::vector<int> _entrances;          // Node of each entrance
+        std::vector<int> _cluster_offsets;    // Entrances of cluster c are _cluster_entrances[_cluster_offsets[c], _cluster_offsets[c + 1])
+        std::vector<int> _cluster_entrances;  // Entrance indices grouped by cluster
+        std::vector<int> _link_offsets;       // Links of entrance e are in [_link_offsets[e], _link_offsets[e + 1])
+        std::vector<Link> _links;             // Abstract edges of every entrance
+        double _build_time = 0.0;
+
+        // Lists the inter-cluster edges of an entrance, then its travel times to the other entrances of its cluster
+        void _linkEntrance(int e, SearchWorkspace &workspace, std::vector<Link> &links) const noexcept;
+
+        // Packs the links of every entrance into the flat arrays
+        void _packLinks(const std::vector<std::vector<Link>> &links) noexcept;
+
+        // Groups the entrances by cluster
+        void _groupEntrances() noexcept;
+
+        // Dijkstra from source that never leaves its cluster, stops early once target is settled (-1 explores the cluster)
+        void _searchCluster(int source, int target, SearchWorkspace &workspace) const noexcept;
+    };
+} // namespace graph
+
+#endif // HIERARCHICALGRAPH_HPP
@@ -0,0 +1,47 @@
+#ifndef IMPORTEDGRAPH_HPP
+#define IMPORTEDGRAPH_HPP
+
+#include "graph.hpp"
+#include <cstddef>
+#include <istream>
+#include <string>
+
+#define MAP_CELL_NODE '.'     // Grid map cell holding a normal node
+#define MAP_CELL_PICKDROP 'P' // Grid map cell holding a pick-drop node
+#define MAP_CELL_WAITING 'W'  // Grid map cell holding a waiting node
+#define MAP_CELL_CHARGING 'C' // Grid map cell holding a charging node
+#define MAP_CELL_WALL '#'     // Grid map cell without a node (a space or a short line also leaves cells empty)
+
+namespace graph
+{
+    // Graph read from a warehouse floor plan. The input is streamed line by line straight into the
+    // bulk builder, only the line being read and one row of node indices are held besides the graph.
+    class ImportedGraph : public Graph
+    {
+    public:
+        // Imports a file, as a node/edge list if its name ends in .csv and as a grid map otherwise
+        bool importFile(const std::string &path) noexcept;
+
+        // Imports a grid map, one character per cell and one line per row. Every node is linked to the nodes
+        // of the cells next to it. expected_cells reserves room ahead when the size of the map is known
+        bool importGrid(std::istream &in, std::size_t expected_cells = 0) noexcept;
+
+        // Imports a node/edge list: "node,id,x,y,property" and "edge,id,id[,travel time]" lines (edges after
+        // their nodes), coordinates in pixels, blank lines and lines starting with '#' are skipped
+        bool importCsv(std::istream &in) noexcept;
+
+        // Returns the line the last import stopped at when it failed (0 if it succeeded)
+        int getErrorLine() const noexcept;
+
+    private:
+        int _error_line = 0;
+
+        // Packs the imported graph and lays its nodes out along the Hilbert curve
+        void _finish() noexcept;
+
+        // Records the failing line and leaves the graph empty
+        bool _fail(int line) noexcept;
+    };
+} // namespace graph
+
+#endif // IMPORTEDGRAPH_HPP
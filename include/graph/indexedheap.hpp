@@ -0,0 +1,46 @@
+#ifndef INDEXEDHEAP_HPP
+#define INDEXEDHEAP_HPP
+
+#include <cstdint>
+#include <vector>
+
+namespace graph
+{
+    // Binary min-heap of node indices that tracks where each node sits, so a queued
+    // node can have its key decreased in place instead of being pushed twice
+    class IndexedHeap
+    {
+    public:
+        // Makes room for nodes in [0, num_items)
+        void reserve(int num_items) noexcept;
+
+        // Removes the remaining entries, only touching the nodes still queued
+        void clear() noexcept;
+
+        bool empty() const noexcept { return _heap.empty(); }
+        bool contains(int item) const noexcept { return _positions[item] != -1; }
+        std::uint64_t topKey() const noexcept { return _heap.front().key; }
+
+        // Inserts the node, or lowers its key if it is already queued with a larger one
+        void push(int item, std::uint64_t key) noexcept;
+
+        // Removes and returns the node with the smallest key
+        int pop() noexcept;
+
+    private:
+        struct Entry
+        {
+            std::uint64_t key;
+            int item;
+        };
+
+        std::vector<Entry> _heap;    // Heap ordered entries
+        std::vector<int> _positions; // Slot of each node in _heap, -1 if not queued
+
+        // Restores the heap order around a slot
+        void _siftUp(std::size_t slot) noexcept;
+        void _siftDown(std::size_t slot) noexcept;
+    };
+} // namespace graph
+
+#endif // INDEXEDHEAP_HPP
@@ -0,0 +1,77 @@
+#ifndef LANDMARKS_HPP
+#define LANDMARKS_HPP
+
+#include "graphfile.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#define ALT_NUM_LANDMARKS 16 // Landmarks picked by default, memory is ALT_NUM_LANDMARKS ints per node
+
+namespace graph
+{
+    class Graph;
+
+    // Travel times from a few landmarks to every node. By the triangle inequality
+    // |d(l, t) - d(l, v)| never exceeds d(v, t), which gives A* a lower bound that
+    // follows the walls of the map instead of the straight line.
+    class Landmarks
+    {
+    public:
+        // Picks up to num_landmarks landmarks on the border of the map and runs one Dijkstra per landmark, spread over all cores
+        Landmarks(const Graph &graph, int num_landmarks) noexcept;
+
+        // Returns the landmark nodes (-1 for a landmark whose node was removed, its distances still bound routes)
+        const std::vector<int> &getLandmarks() const noexcept;
+
+        // Returns the travel time between a landmark and a node (-1 if unreachable)
+        int getDistance(int landmark, int node) const noexcept;
+
+        // Lower bound on the travel time between v and t, 0 when no landmark reaches both
+        int getLowerBound(int v, int t) const noexcept
+        {
+            const int *row_v = _distances.data() + static_cast<std::size_t>(v) * _num_landmarks;
+            const int *row_t = _distances.data() + static_cast<std::size_t>(t) * _num_landmarks;
+            int bound = 0;
+            for (int l = 0; l < _num_landmarks; ++l)
+            {
+                if (row_v[l] >= 0 && row_t[l] >= 0)
+                {
+                    bound = std::max(bound, std::abs(row_t[l] - row_v[l]));
+                }
+            }
+            return bound;
+        }
+
+        // Lowers the distances that the edge added between node_1 and node_2 shortens. Removed edges need no
+        // repair: distances only grow, so the stored ones keep d(l, u) <= d(l, v) + w(v, u) on every edge
+        // left, which is all the lower bound relies on
+        void repairEdge(const Graph &graph, int node_1, int node_2) noexcept;
+
+        // Extends the distances to the node appended last, unreachable until its edges are added
+        void repairAddedNode() noexcept;
+
+        // Moves the distances of the last node to index node, whose own node was removed
+        void repairRemovedNode(int node) noexcept;
+
+        // Returns the number of bytes held by the distances
+        std::size_t getMemoryUsage() const noexcept;
+
+        // Appends the landmark and distance sections to a graph file
+        void saveToFile(GraphFileWriter &writer) const noexcept;
+
+        // Reads the landmarks back from a graph file of num_nodes nodes (nullptr if it holds none or they are inconsistent)
+        static std::shared_ptr<const Landmarks> loadFromFile(const GraphFileReader &reader, int num_nodes) noexcept;
+
+    private:
+        Landmarks() noexcept = default;
+
+        int _num_landmarks = 0;
+        std::vector<int> _landmarks; // Landmark nodes
+        std::vector<int> _distances; // Node-major, distances of v are in [v * _num_landmarks, (v + 1) * _num_landmarks)
+    };
+} // namespace graph
+
+#endif // LANDMARKS_HPP
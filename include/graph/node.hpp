@@ -2,6 +2,9 @@
 #define NODE_HPP
 
 #include <string>
+#include <string_view>
+
+#define NUM_PROPERTIES 4 // Number of values of Property
 
 namespace graph
 {
@@ -13,6 +16,13 @@ namespace graph
         charging
     };
 
+    // Returns the name of a property as written in the JSON representation
+    const char *getPropertyName(Property prop) noexcept;
+
+    // Reads a property back from its name, returns false if the name is unknown
+    bool getPropertyFromName(std::string_view name, Property &prop) noexcept;
+
+    // Lightweight view of a node, copied out of the parallel arrays of the graph
     class Node
     {
     public:
@@ -28,10 +38,10 @@ namespace graph
         std::string getToJson() const noexcept;
 
     private:
-        const int _id;
-        const int _x;
-        const int _y;
-        const Property _prop;
+        int _id;
+        int _x;
+        int _y;
+        Property _prop;
     };
 } // namespace graph
 
@@ -0,0 +1,48 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace graph
+{
+    // Number of worker threads parallelFor uses for count items
+    inline int parallelWorkers(int count) noexcept
+    {
+        int hardware = static_cast<int>(std::thread::hardware_concurrency());
+        return std::max(1, std::min(std::max(hardware, 1), count));
+    }
+
+    // Runs task(k, worker) for every k in [0, count), items are handed out one by one to
+    // parallelWorkers(count) threads and worker identifies the thread in [0, parallelWorkers(count))
+    template <typename Task>
+    void parallelFor(int count, const Task &task) noexcept
+    {
+        const int num_workers = parallelWorkers(count);
+        std::atomic<int> next{0};
+
+        auto work = [&](int worker)
+        {
+            for (int k = next++; k < count; k = next++)
+            {
+                task(k, worker);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(num_workers - 1);
+        for (int worker = 1; worker < num_workers; ++worker)
+        {
+            threads.emplace_back(work, worker);
+        }
+        work(0);
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+} // namespace graph
+
+#endif // PARALLEL_HPP
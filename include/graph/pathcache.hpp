@@ -0,0 +1,77 @@
+#ifndef PATHCACHE_HPP
+#define PATHCACHE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define PATH_CACHE_SHARDS 16      // Independent LRU lists, each behind its own mutex
+#define PATH_CACHE_CAPACITY 16384 // Routes kept across all shards
+
+namespace graph
+{
+    // Thread-safe LRU cache of computed routes keyed by (source, target, engine).
+    // Every entry belongs to a graph epoch, a shard seeing a newer epoch drops its content.
+    class PathCache
+    {
+    public:
+        // Constructor with the total number of routes to keep
+        explicit PathCache(std::size_t capacity = PATH_CACHE_CAPACITY) noexcept;
+
+        // Copies the cached route into path, returns false on a miss
+        bool find(std::uint64_t epoch, int i, int j, int engine, std::vector<int> &path) noexcept;
+
+        // Stores a route (an empty path records an unreachable target)
+        void insert(std::uint64_t epoch, int i, int j, int engine, const std::vector<int> &path) noexcept;
+
+        // Drops every route
+        void clear() noexcept;
+
+        // Getters for the cache statistics
+        std::uint64_t getHits() const noexcept;
+        std::uint64_t getMisses() const noexcept;
+        std::uint64_t getEvictions() const noexcept;
+        std::size_t getSize() noexcept;
+        std::size_t getCapacity() const noexcept;
+
+        // Method to get the JSON representation of the cache statistics
+        std::string getToJson() noexcept;
+
+    private:
+        struct Entry
+        {
+            std::uint64_t key;
+            std::vector<int> path;
+        };
+
+        struct Shard
+        {
+            std::mutex mutex;
+            std::uint64_t epoch = 0;
+            std::list<Entry> lru; // Most recently used first
+            std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index;
+        };
+
+        std::array<Shard, PATH_CACHE_SHARDS> _shards;
+        std::size_t _shard_capacity;
+        std::atomic<std::uint64_t> _hits{0};
+        std::atomic<std::uint64_t> _misses{0};
+        std::atomic<std::uint64_t> _evictions{0};
+
+        // Packs a query into a key, returns false if the node indices are too large to be cached
+        static bool _makeKey(int i, int j, int engine, std::uint64_t &key) noexcept;
+
+        // Selects the shard of a key
+        Shard &_getShard(std::uint64_t key) noexcept;
+
+        // Moves a shard to a newer epoch, dropping its routes (the caller holds the shard mutex)
+        static void _syncEpoch(Shard &shard, std::uint64_t epoch) noexcept;
+    };
+} // namespace graph
+
+#endif // PATHCACHE_HPP
@@ -0,0 +1,43 @@
+#ifndef RADIXHEAP_HPP
+#define RADIXHEAP_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace graph
+{
+    // Monotone priority queue for small integer keys: a pushed key is never smaller than
+    // the last popped one, which is always true for Dijkstra with non-negative weights.
+    // Each entry moves down at most 32 buckets over its lifetime.
+    class RadixHeap
+    {
+    public:
+        // Empties the heap and restarts the keys at 0
+        void clear() noexcept;
+
+        bool empty() const noexcept { return _size == 0; }
+
+        // Inserts a node, key must not be smaller than the last popped key
+        void push(int item, std::uint32_t key) noexcept;
+
+        // Removes the node with the smallest key, writing the key into key
+        int pop(std::uint32_t &key) noexcept;
+
+    private:
+        struct Entry
+        {
+            std::uint32_t key;
+            int item;
+        };
+
+        std::array<std::vector<Entry>, 33> _buckets; // Bucket b holds keys whose highest bit differing from _last is b - 1
+        std::uint32_t _last = 0;                     // Last popped key
+        std::size_t _size = 0;                       // Number of queued entries
+
+        // Bucket of a key relative to the last popped key
+        int _getBucket(std::uint32_t key) const noexcept;
+    };
+} // namespace graph
+
+#endif // RADIXHEAP_HPP
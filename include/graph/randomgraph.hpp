@@ -2,10 +2,10 @@
 #define RANDOMGRAPH_HPP
 
 #include "graph.hpp"
-#include <array>
+#include <cstdint>
+#include <vector>
 
 #define CONNECTIVITY 3 // 33.33% connectivity between normal nodes
-#define SCALE 50       // 50 pixels between nodes
 
 namespace graph
 {
@@ -21,11 +21,13 @@ namespace graph
     class RandomGraph : public Graph
     {
     public:
-        // Constructor to initialize the random graph
-        RandomGraph() noexcept;
+        // Constructor taking the engine that draws the layout, a given seed always gives the same graph
+        explicit RandomGraph(Rng rng = Rng()) noexcept;
 
-        // Generates a random graph with the specified number of nodes
-        void genRandomGraph(int num_node, int num_waiting, int num_charging, int num_pickdrop) noexcept;
+        // Generates a connected random graph with the specified number of nodes, stored with the given adjacency
+        // backend. Returns false if a count could not be reached, getNodesWith() tells how many nodes were placed
+        bool genRandomGraph(int num_node, int num_waiting, int num_charging, int num_pickdrop,
+                            AdjacencyBackend backend = AdjacencyBackend::csr) noexcept;
 
     private:
         // Number of different types of nodes in the graph
@@ -34,17 +36,42 @@ namespace graph
         int _num_charging;
         int _num_pickdrop;
 
-        int _id_node;        // Unique identifier for nodes
-        int _current_node;   // Currently active node during generation
-        int _from_direction; // Direction from which the current node was entered
+        int _id_node; // Unique identifier for nodes
+        Rng _rng;     // Draws directions, node types and extra links
 
-        std::array<bool, static_cast<int>(Direction::num_directions)> _tested_directions; // Tracks tested directions
+        std::vector<std::uint8_t> _links;  // Per node bitmask of connected directions, kept while building
+        std::vector<std::uint8_t> _tested; // Per node bitmask of the directions the walk has tried from it
+        std::vector<int> _walk;            // Normal nodes of the walk from the start, the last one is extended
+        std::vector<int> _open_leaves;     // Special leaves that may still have an empty cell next to them
+        std::vector<int> _normal_leaves;   // Normal nodes that may still be linked to their parent only
+        int _perimeter;                    // Empty cells next to a normal node, the room left for special leaves
+        FlatIndex _occupancy;              // Lattice cells taken so far, the graph indexes are only filled at the end
 
         // Finds the node at the specified (x, y) coordinates
         int _getNodeAt(int x, int y) const noexcept;
 
-        // Resets the direction test array
-        inline void _clearTestedDirections() noexcept;
+        // Adds a node to the graph and to the link masks
+        void _createNode(int x, int y, const Property &prop) noexcept;
+
+        // Connects a node to its lattice neighbour in the given direction
+        void _connect(int node_1, int node_2, int direction) noexcept;
+
+        // Counts the empty cells around (x, y) that no normal node touches yet, the cells a normal node there would
+        // add to the perimeter
+        int _getPerimeterGain(int x, int y) const noexcept;
+
+        // Returns the untested direction of a node leading to the empty cell with the largest perimeter gain,
+        // -1 if every untested direction leads to a node
+        int _getWidestDirection(int node, int &gain) noexcept;
+
+        // Takes a normal node linked to its normal parent only off the candidates, returns -1 if there is none
+        int _popNormalLeaf() noexcept;
+
+        // Restarts the walk from a special leaf that has an empty cell next to it, returns false if none can be used
+        bool _reopenWalk() noexcept;
+
+        // Returns the number of nodes of a property still to be placed
+        int &_getRemaining(Property prop) noexcept;
 
         // Calculates new coordinates based on the direction
         static inline std::pair<int, int> _getNewCoordinates(int x, int y, Direction direction) noexcept;
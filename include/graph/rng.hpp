@@ -0,0 +1,54 @@
+#ifndef RNG_HPP
+#define RNG_HPP
+
+#include <cstdint>
+#include <limits>
+
+#define RNG_DEFAULT_SEED 0x9E3779B97F4A7C15ull // Seed of default constructed engines, so unseeded runs repeat too
+
+namespace graph
+{
+    // xoshiro256** engine: four words of state, a handful of instructions per draw and no system call.
+    // Models UniformRandomBitGenerator, so the standard distributions accept it as well
+    class Rng
+    {
+    public:
+        using result_type = std::uint64_t;
+
+        // Seeds the engine, equal seeds give equal sequences on every platform
+        explicit Rng(std::uint64_t seed = RNG_DEFAULT_SEED) noexcept;
+
+        // Restarts the sequence from a seed, expanded into the state with splitmix64
+        void seed(std::uint64_t seed) noexcept;
+
+        // Draws the next 64 random bits
+        std::uint64_t operator()() noexcept
+        {
+            const std::uint64_t result = _rotl(_state[1] * 5, 7) * 9;
+            const std::uint64_t t = _state[1] << 17;
+            _state[2] ^= _state[0];
+            _state[3] ^= _state[1];
+            _state[1] ^= _state[2];
+            _state[0] ^= _state[3];
+            _state[2] ^= t;
+            _state[3] = _rotl(_state[3], 45);
+            return result;
+        }
+
+        // Draws an integer in [0, bound) with a multiply instead of a division, bound must be positive
+        int below(int bound) noexcept
+        {
+            return static_cast<int>(((*this)() >> 32) * static_cast<std::uint64_t>(bound) >> 32);
+        }
+
+        static constexpr std::uint64_t min() noexcept { return 0; }
+        static constexpr std::uint64_t max() noexcept { return std::numeric_limits<std::uint64_t>::max(); }
+
+    private:
+        std::uint64_t _state[4];
+
+        static std::uint64_t _rotl(std::uint64_t x, int k) noexcept { return (x << k) | (x >> (64 - k)); }
+    };
+} // namespace graph
+
+#endif // RNG_HPP
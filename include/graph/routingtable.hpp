@@ -0,0 +1,58 @@
+#ifndef ROUTINGTABLE_HPP
+#define ROUTINGTABLE_HPP
+
+#include "searchworkspace.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define ROUTING_TABLE_MAX_NODES 4096 // Above this node count routes are searched on demand (4096 nodes use 64 MiB)
+
+namespace graph
+{
+    class Graph;
+
+    // All-pairs next-hop and distance matrices, stored target-major so walking a
+    // route towards one target reads a single contiguous column
+    class RoutingTable
+    {
+    public:
+        // Builds the table with one BFS per target node, spread over all cores
+        explicit RoutingTable(const Graph &graph) noexcept;
+
+        // Refills the columns of the targets whose routes change with the edge added or removed between
+        // node_1 and node_2, the other columns are kept as they are. The graph must keep its nodes
+        void repairEdge(const Graph &graph, int node_1, int node_2) noexcept;
+
+        // Returns the neighbour of i on a shortest path to j (-1 if unreachable, j if i == j)
+        int getNextHop(int i, int j) const noexcept;
+
+        // Returns the number of hops between i and j (-1 if unreachable)
+        int getDistance(int i, int j) const noexcept;
+
+        // Writes the route from i to j into path, returns false if unreachable
+        bool getPath(int i, int j, std::vector<int> &path) const noexcept;
+
+        // Returns the number of bytes held by the matrices
+        std::size_t getMemoryUsage() const noexcept;
+
+    private:
+        int _num_nodes;
+        bool _compact; // Entries are stored on 16 bits when node indices fit
+
+        // One of each pair is used, depending on _compact
+        std::vector<std::uint16_t> _next_hop_16;
+        std::vector<std::uint16_t> _distance_16;
+        std::vector<std::uint32_t> _next_hop_32;
+        std::vector<std::uint32_t> _distance_32;
+
+        // Writes the column of one target with a BFS from it
+        void _fillColumn(const Graph &graph, int target, SearchWorkspace &workspace) noexcept;
+
+        // Reads an entry, mapping the unreachable marker to -1
+        int _getNextHopEntry(std::size_t entry) const noexcept;
+        int _getDistanceEntry(std::size_t entry) const noexcept;
+    };
+} // namespace graph
+
+#endif // ROUTINGTABLE_HPP
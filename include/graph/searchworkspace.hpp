@@ -0,0 +1,68 @@
+#ifndef SEARCHWORKSPACE_HPP
+#define SEARCHWORKSPACE_HPP
+
+#include "indexedheap.hpp"
+#include "radixheap.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace graph
+{
+    // Scratch memory reused across graph searches. Visited marks are stamped with a
+    // generation counter so starting a new search never clears the arrays.
+    class SearchWorkspace
+    {
+    public:
+        // Starts a new search over a graph of num_nodes nodes (allocates only when the graph grew)
+        void begin(int num_nodes) noexcept;
+
+        // Visited marks and predecessors of the current search
+        bool isVisited(int node) const noexcept { return _stamps[node] == _generation; }
+        void visit(int node, int pred) noexcept
+        {
+            _stamps[node] = _generation;
+            _pred[node] = pred;
+        }
+        int getPred(int node) const noexcept { return _pred[node]; }
+
+        // Best known cost of a visited node (only meaningful for cost-ordered searches)
+        int getCost(int node) const noexcept { return _cost[node]; }
+        void setCost(int node, int cost) noexcept { _cost[node] = cost; }
+
+        // Priority queues used by cost-ordered searches
+        IndexedHeap &getHeap() noexcept { return _heap; }
+        RadixHeap &getRadixHeap() noexcept { return _radix_heap; }
+
+        // Number of nodes expanded by the current search
+        int getExpanded() const noexcept { return _expanded; }
+        void countExpanded() noexcept { ++_expanded; }
+
+        // Ring buffer frontier of the current search
+        bool empty() const noexcept { return _head == _tail; }
+        void push(int node) noexcept { _frontier[_tail++ & _mask] = node; }
+        int pop() noexcept { return _frontier[_head++ & _mask]; }
+
+        // Packed node sets of the bitset BFS, one bit per node (sized by the search itself)
+        std::vector<std::uint64_t> &getFrontierBits() noexcept { return _frontier_bits; }
+        std::vector<std::uint64_t> &getNextBits() noexcept { return _next_bits; }
+        std::vector<std::uint64_t> &getVisitedBits() noexcept { return _visited_bits; }
+
+    private:
+        std::vector<std::uint32_t> _stamps; // Generation at which each node was last visited
+        std::vector<int> _pred;             // Predecessor of each visited node
+        std::vector<int> _cost;             // Cost of each visited node
+        IndexedHeap _heap;                  // Open list of cost-ordered searches
+        RadixHeap _radix_heap;              // Open list of Dijkstra searches
+        std::vector<int> _frontier;         // Ring buffer, its size is a power of two
+        std::size_t _mask = 0;              // Frontier size - 1
+        std::size_t _head = 0;              // Next slot to pop
+        std::size_t _tail = 0;              // Next slot to push
+        std::vector<std::uint64_t> _frontier_bits; // Current level of the bitset BFS
+        std::vector<std::uint64_t> _next_bits;     // Level being discovered
+        std::vector<std::uint64_t> _visited_bits;  // Nodes reached so far
+        std::uint32_t _generation = 0;      // Stamp of the current search
+        int _expanded = 0;                  // Nodes expanded by the current search
+    };
+} // namespace graph
+
+#endif // SEARCHWORKSPACE_HPP
@@ -0,0 +1,79 @@
+#ifndef WAREHOUSEGRAPH_HPP
+#define WAREHOUSEGRAPH_HPP
+
+#include "graph.hpp"
+#include "graphfile.hpp"
+#include <string>
+#include <vector>
+
+#define WAREHOUSE_MAX_CELLS (1 << 28)     // Largest floor the generator lays out, node identifiers stay well inside int
+#define WAREHOUSE_STREAM_CHUNK (1 << 16) // Values buffered per section before they are appended to a streamed file
+
+namespace graph
+{
+    // Floor plan of a warehouse template, in lattice cells. Aisles run along y between a front and a back
+    // cross-aisle, with racks on both sides. A dock row in front of the front cross-aisle holds the
+    // charging and waiting spots, pick-drop stations sit in the racks, facing their aisle
+    struct WarehouseLayout
+    {
+        int num_aisles = 10;          // Aisles side by side
+        int aisle_length = 40;        // Aisle cells between the front and the back cross-aisles
+        int rack_depth = 2;           // Rack cells on each side of an aisle, two racks back to back between aisles
+        int cross_aisle_spacing = 10; // Aisle cells between two cross-aisles, 0 for the front and back ones only
+        int pickdrop_spacing = 2;     // A pick-drop station on both sides of every that many aisle cells
+        int charging_spacing = 7;     // A charging spot on the dock row every that many columns, 0 for none
+        int waiting_spacing = 3;      // A waiting spot on the other dock cells every that many columns, 0 for none
+    };
+
+    // Graph laid out from a warehouse template. Every aisle and its racks form a tile, the tiles are built
+    // on all cores and stitched together along the cross-aisles
+    class WarehouseGraph : public Graph
+    {
+    public:
+        // Generates the floor of the layout, returns false (leaving the graph empty) if it is invalid or too large
+        bool genWarehouseGraph(const WarehouseLayout &layout, AdjacencyBackend backend = AdjacencyBackend::csr) noexcept;
+
+        // Streams the floor of the layout into a graph file without holding it in memory: only three tiles and
+        // one chunk per section are kept while writing. Nodes are numbered aisle by aisle and the file has no
+        // lookup tables, loadFromFile() builds them. Returns false if the layout is invalid or a write failed
+        static bool genWarehouseFile(const WarehouseLayout &layout, const std::string &path) noexcept;
+
+    private:
+        // Nodes and edges of one tile, numbered from 0 within the tile
+        struct Tile
+        {
+            std::vector<int> xs, ys;                 // Cell of each node
+            std::vector<Property> props;             // Property of each node
+            std::vector<std::pair<int, int>> edges;  // Links between nodes of the tile
+            std::vector<int> west, east;             // Node of the first and last column of each row (-1 if none)
+        };
+
+        // Rows of the nodes of a tile, with the neighbours numbered across the whole floor
+        struct TileRows
+        {
+            std::vector<int> offsets;    // Row k is neighbours[offsets[k], offsets[k + 1])
+            std::vector<int> neighbours; // Sorted neighbours of each node
+            std::vector<int> links;      // Lattice link of each node in each direction (-1 if none)
+        };
+
+        // Tells whether the layout can be generated
+        static bool _isValid(const WarehouseLayout &layout) noexcept;
+
+        // Lays out the tile of an aisle
+        static void _buildTile(const WarehouseLayout &layout, int aisle, Tile &tile) noexcept;
+
+        // Returns the property of the node at a cell of the floor, -1 for a cell without a node
+        static int _getCell(const WarehouseLayout &layout, int x, int y) noexcept;
+
+        // Numbers the edges of a tile and its stitches to the tiles on both sides, first is the index of the first
+        // node of the previous tile (empty for the first aisle), the tile and the next one (empty after the last)
+        static void _linkTile(const WarehouseLayout &layout, const Tile &previous, const Tile &tile, const Tile &next,
+                              int first, TileRows &rows) noexcept;
+
+        // Builds every tile in order and hands each one to visit(tile, rows, first node of the tile)
+        template <typename Visit>
+        static void _visitTiles(const WarehouseLayout &layout, Visit &&visit) noexcept;
+    };
+} // namespace graph
+
+#endif // WAREHOUSEGRAPH_HPP
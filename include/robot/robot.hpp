@@ -40,12 +40,16 @@ namespace robot
         // A method to check if the robot is running
         bool isAvailable() noexcept;
 
-        // Adds a move task to the robot's task queue
-        void move(int x, int y) noexcept;
+        // Adds a move task to the robot's task queue, paced to last travel_time time units
+        // of SPEED milliseconds (one pixel per time unit if travel_time is -1)
+        void move(int x, int y, int travel_time = -1) noexcept;
 
         // Marks the given task as done after executing all moves
         void markTaskDone(task::Task* task) noexcept;
 
+        // Runs callback on the worker thread once the moves queued before it are done
+        void schedule(const std::function<void()> &callback) noexcept;
+
         // Executes tasks in the robot's task queue
         void executeTasks() noexcept;
 
@@ -61,6 +65,7 @@ namespace robot
         std::atomic<float> _battery; // Battery level in percentage
         std::atomic<float> _angle;   // Angle in degrees
         std::atomic<bool> _running;  // Flag to control the robot's running state
+        bool _executing = false;     // A task taken from the queue is running (guarded by _queue_mutex)
 
         std::queue<std::function<void()>> _robot_task_queue; // Queue of tasks for the robot
         std::mutex _queue_mutex;                             // Mutex to protect the task queue
@@ -2,8 +2,10 @@
 #define ROBOTSMANAGER_HPP
 
 #include "robot.hpp"
-#include "graph.hpp"
+#include "graphstore.hpp"
 #include "tasksmanager.hpp"
+#include <cstdint>
+#include <future>
 #include <memory>
 #include <vector>
 #include <string>
@@ -13,10 +15,10 @@ namespace robot
     class RobotsManager
     {
     public:
-        // Constructor with parameters to initialize the RobotsManager with a graph and a task manager
-        RobotsManager(std::shared_ptr<graph::Graph> graph, std::shared_ptr<task::TasksManager> tasks_manager) noexcept;
+        // Constructor with parameters to initialize the RobotsManager with the graph snapshots and a task manager
+        RobotsManager(std::shared_ptr<graph::GraphStore> graphs, std::shared_ptr<task::TasksManager> tasks_manager) noexcept;
 
-        // Adds a new robot to the manager
+        // Adds a new robot to the manager, placed on the node closest to (x, y)
         void addRobot(float x, float y) noexcept;
 
         // Clears all robots from the manager
@@ -32,11 +34,47 @@ namespace robot
         std::string getToJson() const noexcept;
 
     private:
-        std::shared_ptr<graph::Graph> _graph; // Shared pointer to the graph object
+        std::shared_ptr<graph::GraphStore> _graphs; // Store publishing the graph snapshots
         std::shared_ptr<task::TasksManager> _tasks_manager; // Shared pointer to the task manager object
         std::vector<std::shared_ptr<Robot>> _robots; // Vector holding all managed robots
+        std::vector<int> _path; // Path buffer reused by every route planned by the dispatcher
         int _id_robot = 0; // Counter for robot IDs
         bool _running; // Flag to control the main loop
+
+        // Task route queued on the robot one segment at a time, so that a graph edit is seen before the next one.
+        // With a cluster graph its waypoints are refined one segment ahead of the robot, otherwise each hop is a segment
+        struct LazyRoute
+        {
+            std::shared_ptr<const graph::Graph> graph;                 // Snapshot the route was planned on, pinned with its hierarchy
+            std::shared_ptr<const graph::HierarchicalGraph> hierarchy; // Kept alive while the robot follows the route
+            std::uint64_t version = 0;                                 // Store version of the snapshot, an edit replans the route
+            std::vector<int> waypoints;                                // Abstract route of both legs
+            std::size_t pick = 0;                                      // Waypoint of the pick-up node
+            std::size_t next = 1;                                      // Waypoint ending the segment being refined
+            std::future<std::vector<int>> pending;                     // Segment refined while the robot moves
+            task::Task *task = nullptr;                                // Task marked done at the end of the route
+        };
+
+        // Plans the route of a task from start_node on a snapshot and queues it on the robot
+        void _assignTask(const std::shared_ptr<const graph::Graph> &graph, std::uint64_t version,
+                         const std::shared_ptr<Robot> &robot, task::Task *pending_task, int start_node) noexcept;
+
+        // Plans the route from start_node to the drop-off node on the route's snapshot, through the pick-up node unless
+        // it is already reached. Returns false if a leg is unreachable
+        static bool _planRoute(LazyRoute &route, int start_node, bool picked, std::vector<int> &leg) noexcept;
+
+        // Moves a route to the current snapshot from node, a node of its old snapshot, then queues the rest of the task.
+        // The task is marked done if the robot is cut off from its remaining stops
+        void _replanRoute(const std::shared_ptr<Robot> &robot, std::shared_ptr<LazyRoute> route, int node) noexcept;
+
+        // Queues the moves of a path of the snapshot on the robot
+        static void _moveAlongPath(Robot &robot, const graph::Graph &graph, const std::vector<int> &path) noexcept;
+
+        // Starts refining the next segment of the route in the background
+        static void _refineNextSegment(LazyRoute &route) noexcept;
+
+        // Queues the refined segment, then either the next one or the end of the task, on the robot's worker thread
+        void _followRoute(std::shared_ptr<Robot> robot, std::shared_ptr<LazyRoute> route) noexcept;
     };
 } // namespace robot
 
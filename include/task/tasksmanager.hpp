@@ -1,7 +1,9 @@
 #ifndef TASKSMANAGER_HPP
 #define TASKSMANAGER_HPP
 
+#include "graphstore.hpp"
 #include "task.hpp"
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <string>
@@ -11,12 +13,15 @@ namespace task
     class TasksManager
     {
     public:
-        // Constructor with a shared pointer to a Graph object
-        TasksManager(std::shared_ptr<graph::Graph> graph) noexcept;
+        // Constructor with the store publishing the graph snapshots and the engine drawing the tasks
+        TasksManager(std::shared_ptr<graph::GraphStore> graphs, graph::Rng rng = graph::Rng()) noexcept;
 
         // Adds random tasks
         void addRandomTasks(int n) noexcept;
 
+        // Restarts the task draws from a seed, so a batch can be replayed exactly
+        void seed(std::uint64_t seed) noexcept;
+
         // Returns a reference to the tasks
         std::vector<Task> &getTasks() noexcept;
 
@@ -28,8 +33,9 @@ namespace task
 
     private:
         std::vector<Task> _tasks;             // Vector holding all tasks
-        std::shared_ptr<graph::Graph> _graph; // Graph reference
+        std::shared_ptr<graph::GraphStore> _graphs; // Graph snapshots
         int _task_id = 0;                     // Task ID counter
+        graph::Rng _rng;                      // Draws the pick and drop nodes
     };
 } // namespace task
 
@@ -2,17 +2,23 @@
 #define SERVER_HPP
 
 #include "httplib.hpp"
-#include "randomgraph.hpp"
+#include "graphstore.hpp"
 #include "robotsmanager.hpp"
 #include "tasksmanager.hpp"
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+
+#define MAPS_DIRECTORY "./maps" // Graph files and floor plans named by the requests live under this directory
+
 namespace web
 {
     class Server
     {
     public:
         Server() = delete;
-        Server(int port, std::shared_ptr<graph::RandomGraph> graph, std::shared_ptr<robot::RobotsManager> robots_manager, std::shared_ptr<task::TasksManager> tasks_manager) noexcept;
+        Server(int port, std::shared_ptr<graph::GraphStore> graphs, std::shared_ptr<robot::RobotsManager> robots_manager, std::shared_ptr<task::TasksManager> tasks_manager) noexcept;
 
         void start();
         void stop();
@@ -21,11 +27,22 @@ namespace web
         void setHTTPServer();
         void listen();
 
+        // Resolves the path parameter of a request inside MAPS_DIRECTORY. Absolute paths and ".." components are
+        // rejected, so that a client can neither read nor overwrite a file outside of it
+        static bool resolveMapPath(const httplib::Request &req, std::string &path);
+
+        // Builds the routing indexes a graph is missing before it gets published
+        void prepareGraph(graph::Graph &graph);
+
+        // Applies an edit to a copy of the published graph and publishes the copy, routes in flight are replanned on it
+        void editGraph(const std::function<bool(graph::Graph &)> &edit, httplib::Response &res);
+
         const int _port;
-        const std::shared_ptr<graph::RandomGraph> _graph;
+        const std::shared_ptr<graph::GraphStore> _graphs;
         const std::shared_ptr<robot::RobotsManager> _robots_manager;
         const std::shared_ptr<task::TasksManager> _tasks_manager;
         httplib::Server _svr;
+        std::mutex _publish_mutex; // Serializes the requests publishing a graph, so that no edit is lost
     };
 } // namespace web
 #endif // SERVER_HPP
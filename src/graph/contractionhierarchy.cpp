@@ -0,0 +1,439 @@
+#include "contractionhierarchy.hpp"
+#include "graph.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <utility>
+
+namespace graph
+{
+    // Contracts the nodes in rounds: priorities of the nodes touched by the last round are refreshed,
+    // nodes whose priority is the smallest within two hops are contracted together
+    ContractionHierarchy::ContractionHierarchy(const Graph &graph) noexcept
+        : _num_nodes(graph.getNumNodes()), _rank(graph.getNumNodes(), -1)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        // Remaining graph, arcs to contracted nodes are removed as the contraction goes
+        std::vector<std::vector<Arc>> remaining(_num_nodes);
+        for (int v = 0; v < _num_nodes; ++v)
+        {
+            auto neighbours = graph.getNeighbours(v);
+            auto weights = graph.getEdgeWeights(v);
+            for (std::size_t k = 0; k < neighbours.size(); ++k)
+            {
+                remaining[v].push_back({neighbours[k], weights[k], -1});
+            }
+        }
+
+        std::vector<std::vector<Arc>> upward(_num_nodes);
+        std::vector<std::vector<Shortcut>> shortcuts(_num_nodes);
+        std::vector<int> priority(_num_nodes, 0);
+        std::vector<int> deleted_neighbours(_num_nodes, 0);
+        std::vector<int> depth(_num_nodes, 0);
+        std::vector<char> dirty(_num_nodes, 1);
+        std::vector<char> selected(_num_nodes, 0);
+        std::vector<SearchWorkspace> workspaces(parallelWorkers(_num_nodes));
+
+        std::vector<int> active(_num_nodes);
+        for (int v = 0; v < _num_nodes; ++v)
+        {
+            active[v] = v;
+        }
+
+        int next_rank = 0;
+        while (!active.empty())
+        {
+            const int num_active = static_cast<int>(active.size());
+
+            // Refresh the priorities: edge difference, contracted neighbours and depth in the hierarchy
+            parallelFor(num_active, [&](int k, int worker)
+                        {
+                int v = active[k];
+                if (dirty[v])
+                {
+                    int added = _simulateContraction(v, remaining, workspaces[worker], nullptr);
+                    priority[v] = 2 * (added - static_cast<int>(remaining[v].size())) + deleted_neighbours[v] + depth[v];
+                    dirty[v] = 0;
+                } });
+
+            // Select the nodes that come first within their two-hop neighbourhood. Ties are broken by a
+            // hash of the index, breaking them by index would only let one corner of a lattice through.
+            auto tie = [](int v)
+            {
+                return static_cast<std::uint32_t>(v) * 2654435761u;
+            };
+            auto before = [&](int a, int b)
+            {
+                return priority[a] < priority[b] || (priority[a] == priority[b] && tie(a) < tie(b));
+            };
+            parallelFor(num_active, [&](int k, int)
+                        {
+                int v = active[k];
+                bool first = true;
+                for (const Arc &arc : remaining[v])
+                {
+                    first = first && before(v, arc.target);
+                    for (const Arc &second : remaining[arc.target])
+                    {
+                        first = first && (second.target == v || before(v, second.target));
+                    }
+                }
+                selected[v] = first; });
+
+            // Shortcuts of independent nodes do not interfere, they are searched in parallel
+            std::vector<int> round;
+            for (int v : active)
+            {
+                if (selected[v])
+                {
+                    round.push_back(v);
+                }
+            }
+            parallelFor(static_cast<int>(round.size()), [&](int k, int worker)
+                        { _simulateContraction(round[k], remaining, workspaces[worker], &shortcuts[round[k]]); });
+
+            // Contract the round
+            for (int v : round)
+            {
+                _rank[v] = next_rank++;
+                for (const Arc &arc : remaining[v])
+                {
+                    int u = arc.target;
+                    std::erase_if(remaining[u], [v](const Arc &back)
+                                  { return back.target == v; });
+                    deleted_neighbours[u]++;
+                    depth[u] = std::max(depth[u], depth[v] + 1);
+                    dirty[u] = 1;
+                }
+                for (const Shortcut &shortcut : shortcuts[v])
+                {
+                    if (_addOrImprove(remaining[shortcut.from], {shortcut.to, shortcut.weight, v}))
+                    {
+                        _addOrImprove(remaining[shortcut.to], {shortcut.from, shortcut.weight, v});
+                        _num_shortcuts++;
+                    }
+                }
+                upward[v] = std::move(remaining[v]);
+                remaining[v] = {};
+                shortcuts[v] = {};
+                selected[v] = 0;
+            }
+            std::erase_if(active, [&](int v)
+                          { return _rank[v] != -1; });
+        }
+
+        // Pack the upward arcs
+        _offsets.assign(_num_nodes + 1, 0);
+        for (int v = 0; v < _num_nodes; ++v)
+        {
+            _offsets[v + 1] = _offsets[v] + static_cast<int>(upward[v].size());
+        }
+        _arcs.reserve(_offsets[_num_nodes]);
+        for (int v = 0; v < _num_nodes; ++v)
+        {
+            _arcs.insert(_arcs.end(), upward[v].begin(), upward[v].end());
+        }
+
+        _build_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Bidirectional upward search, the cheapest meeting node gives the path
+    bool ContractionHierarchy::getPath(int i, int j, SearchWorkspace &forward, SearchWorkspace &backward, std::vector<int> &path) const noexcept
+    {
+        path.clear();
+        if (i < 0 || j < 0 || i >= _num_nodes || j >= _num_nodes)
+        {
+            return false;
+        }
+
+        // The forward search space is small, it is explored completely
+        _searchUpward(i, forward);
+
+        // The backward search stops once no cheaper meeting node can be found
+        backward.begin(_num_nodes);
+        IndexedHeap &heap = backward.getHeap();
+        backward.visit(j, -1);
+        backward.setCost(j, 0);
+        heap.push(j, 0);
+
+        int best = std::numeric_limits<int>::max();
+        int meet = -1;
+        while (!heap.empty() && heap.topKey() < static_cast<std::uint64_t>(best))
+        {
+            int node = heap.pop();
+            backward.countExpanded();
+            int cost = backward.getCost(node);
+            if (forward.isVisited(node) && forward.getCost(node) + cost < best)
+            {
+                best = forward.getCost(node) + cost;
+                meet = node;
+            }
+
+            for (int k = _offsets[node]; k < _offsets[node + 1]; ++k)
+            {
+                const Arc &arc = _arcs[k];
+                if (!backward.isVisited(arc.target) || cost + arc.weight < backward.getCost(arc.target))
+                {
+                    backward.visit(arc.target, node);
+                    backward.setCost(arc.target, cost + arc.weight);
+                    heap.push(arc.target, static_cast<std::uint64_t>(cost + arc.weight));
+                }
+            }
+        }
+
+        if (meet == -1)
+        {
+            return false;
+        }
+
+        // Upward chain from i to the meeting node, then down to j
+        for (int node = meet; node != -1; node = forward.getPred(node))
+        {
+            path.push_back(node);
+        }
+        std::reverse(path.begin(), path.end());
+        for (int node = meet; backward.getPred(node) != -1; node = backward.getPred(node))
+        {
+            path.push_back(backward.getPred(node));
+        }
+
+        // Replace the shortcuts by the nodes they bypass
+        thread_local std::vector<int> packed;
+        packed.assign(path.begin(), path.end());
+        path.assign(1, packed.front());
+        for (std::size_t k = 1; k < packed.size(); ++k)
+        {
+            _unpack(packed[k - 1], packed[k], path);
+        }
+        return true;
+    }
+
+    // Getters for the preprocessing statistics
+    int ContractionHierarchy::getNumShortcuts() const noexcept { return _num_shortcuts; }
+    double ContractionHierarchy::getBuildTime() const noexcept { return _build_time; }
+
+    // Sums the capacity of the ranks and arcs
+    std::size_t ContractionHierarchy::getMemoryUsage() const noexcept
+    {
+        return (_rank.capacity() + _offsets.capacity()) * sizeof(int) + _arcs.capacity() * sizeof(Arc);
+    }
+
+    // The arcs are written as (target, weight, middle) triples
+    void ContractionHierarchy::saveToFile(GraphFileWriter &writer) const noexcept
+    {
+        static_assert(sizeof(Arc) == 3 * sizeof(std::int32_t), "Arcs are stored as three ints");
+        writer.getHeader().num_shortcuts = static_cast<std::uint64_t>(_num_shortcuts);
+        writer.write(GraphSection::ch_rank, _rank);
+        writer.write(GraphSection::ch_offsets, _offsets);
+        writer.write(GraphSection::ch_arcs, {reinterpret_cast<const std::int32_t *>(_arcs.data()), _arcs.size() * 3});
+    }
+
+    // Arcs must lead upwards and bypass lower ranked nodes, otherwise unpacking a path would never end
+    std::shared_ptr<const ContractionHierarchy> ContractionHierarchy::loadFromFile(const GraphFileReader &reader, int num_nodes) noexcept
+    {
+        auto rank = reader.getSection(GraphSection::ch_rank);
+        auto offsets = reader.getSection(GraphSection::ch_offsets);
+        auto arcs = reader.getSection(GraphSection::ch_arcs);
+        const auto n = static_cast<std::size_t>(num_nodes);
+        if (n == 0 || rank.size() != n || offsets.size() != n + 1 || offsets[0] != 0 ||
+            static_cast<std::size_t>(offsets[n]) * 3 != arcs.size())
+        {
+            return nullptr;
+        }
+
+        std::shared_ptr<ContractionHierarchy> hierarchy(new ContractionHierarchy());
+        hierarchy->_num_nodes = num_nodes;
+        hierarchy->_rank.assign(rank.begin(), rank.end());
+        hierarchy->_offsets.assign(offsets.begin(), offsets.end());
+        hierarchy->_arcs.resize(arcs.size() / 3);
+        for (std::size_t k = 0; k < hierarchy->_arcs.size(); ++k)
+        {
+            hierarchy->_arcs[k] = {arcs[k * 3], arcs[k * 3 + 1], arcs[k * 3 + 2]};
+        }
+        hierarchy->_num_shortcuts = static_cast<int>(reader.getHeader().num_shortcuts);
+
+        for (int v : hierarchy->_rank)
+        {
+            if (v < 0 || v >= num_nodes)
+            {
+                return nullptr;
+            }
+        }
+        for (int v = 0; v < num_nodes; ++v)
+        {
+            if (offsets[v] > offsets[v + 1])
+            {
+                return nullptr;
+            }
+            for (int k = offsets[v]; k < offsets[v + 1]; ++k)
+            {
+                const Arc &arc = hierarchy->_arcs[k];
+                if (arc.target < 0 || arc.target >= num_nodes || rank[arc.target] <= rank[v] || arc.middle < -1 ||
+                    arc.middle >= num_nodes || (arc.middle != -1 && rank[arc.middle] >= rank[v]))
+                {
+                    return nullptr;
+                }
+            }
+        }
+        return hierarchy;
+    }
+
+    // Witness searches from every neighbour of v decide which neighbour pairs need a shortcut through v
+    int ContractionHierarchy::_simulateContraction(int v, const std::vector<std::vector<Arc>> &remaining, SearchWorkspace &workspace,
+                                                   std::vector<Shortcut> *shortcuts) noexcept
+    {
+        const auto &arcs = remaining[v];
+        const int settle_limit = shortcuts ? CH_WITNESS_SETTLE_LIMIT : CH_PRIORITY_SETTLE_LIMIT;
+        int added = 0;
+
+        for (std::size_t a = 0; a < arcs.size(); ++a)
+        {
+            // The search never needs to go further than the most expensive route through v
+            int limit = 0;
+            for (std::size_t b = a + 1; b < arcs.size(); ++b)
+            {
+                limit = std::max(limit, arcs[a].weight + arcs[b].weight);
+            }
+            if (limit == 0)
+            {
+                continue;
+            }
+
+            const int source = arcs[a].target;
+            workspace.begin(static_cast<int>(remaining.size()));
+            IndexedHeap &heap = workspace.getHeap();
+            workspace.visit(source, -1);
+            workspace.setCost(source, 0);
+            heap.push(source, 0);
+
+            // Stop once every other neighbour of v is settled
+            int settled = 0;
+            int targets_left = static_cast<int>(arcs.size() - a - 1);
+            while (!heap.empty() && heap.topKey() <= static_cast<std::uint64_t>(limit) && settled < settle_limit && targets_left > 0)
+            {
+                int node = heap.pop();
+                settled++;
+                for (std::size_t b = a + 1; b < arcs.size(); ++b)
+                {
+                    targets_left -= arcs[b].target == node;
+                }
+                int cost = workspace.getCost(node);
+                for (const Arc &arc : remaining[node])
+                {
+                    if (arc.target == v)
+                    {
+                        continue; // Witnesses avoid the contracted node
+                    }
+                    if (!workspace.isVisited(arc.target) || cost + arc.weight < workspace.getCost(arc.target))
+                    {
+                        workspace.visit(arc.target, node);
+                        workspace.setCost(arc.target, cost + arc.weight);
+                        heap.push(arc.target, static_cast<std::uint64_t>(cost + arc.weight));
+                    }
+                }
+            }
+
+            // Pairs without a witness at most as cheap as the route through v need a shortcut
+            for (std::size_t b = a + 1; b < arcs.size(); ++b)
+            {
+                const int target = arcs[b].target;
+                const int through = arcs[a].weight + arcs[b].weight;
+                if (!workspace.isVisited(target) || workspace.getCost(target) > through)
+                {
+                    added++;
+                    if (shortcuts)
+                    {
+                        shortcuts->push_back({source, target, through});
+                    }
+                }
+            }
+        }
+        return added;
+    }
+
+    // Keeps a single arc per target, the cheapest one
+    bool ContractionHierarchy::_addOrImprove(std::vector<Arc> &arcs, const Arc &arc) noexcept
+    {
+        for (Arc &existing : arcs)
+        {
+            if (existing.target == arc.target)
+            {
+                if (arc.weight < existing.weight)
+                {
+                    existing = arc;
+                    return true;
+                }
+                return false;
+            }
+        }
+        arcs.push_back(arc);
+        return true;
+    }
+
+    // Dijkstra over the upward arcs, explored until the queue is empty
+    void ContractionHierarchy::_searchUpward(int source, SearchWorkspace &workspace) const noexcept
+    {
+        workspace.begin(_num_nodes);
+        IndexedHeap &heap = workspace.getHeap();
+        workspace.visit(source, -1);
+        workspace.setCost(source, 0);
+        heap.push(source, 0);
+
+        while (!heap.empty())
+        {
+            int node = heap.pop();
+            workspace.countExpanded();
+            int cost = workspace.getCost(node);
+            for (int k = _offsets[node]; k < _offsets[node + 1]; ++k)
+            {
+                const Arc &arc = _arcs[k];
+                if (!workspace.isVisited(arc.target) || cost + arc.weight < workspace.getCost(arc.target))
+                {
+                    workspace.visit(arc.target, node);
+                    workspace.setCost(arc.target, cost + arc.weight);
+                    heap.push(arc.target, static_cast<std::uint64_t>(cost + arc.weight));
+                }
+            }
+        }
+    }
+
+    // Looks the arc up in the row of the lower ranked node
+    const ContractionHierarchy::Arc *ContractionHierarchy::_findArc(int a, int b) const noexcept
+    {
+        int lower = _rank[a] < _rank[b] ? a : b;
+        int higher = lower == a ? b : a;
+        for (int k = _offsets[lower]; k < _offsets[lower + 1]; ++k)
+        {
+            if (_arcs[k].target == higher)
+            {
+                return &_arcs[k];
+            }
+        }
+        return nullptr;
+    }
+
+    // Expands nested shortcuts with an explicit stack
+    void ContractionHierarchy::_unpack(int a, int b, std::vector<int> &path) const noexcept
+    {
+        thread_local std::vector<std::pair<int, int>> stack;
+        stack.assign(1, {a, b});
+        while (!stack.empty())
+        {
+            auto [from, to] = stack.back();
+            stack.pop_back();
+
+            const Arc *arc = _findArc(from, to);
+            if (arc == nullptr || arc->middle == -1)
+            {
+                path.push_back(to);
+            }
+            else
+            {
+                stack.push_back({arc->middle, to});
+                stack.push_back({from, arc->middle});
+            }
+        }
+    }
+} // namespace graph
@@ -0,0 +1,252 @@
+#include "distancefield.hpp"
+#include "graph.hpp"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace graph
+{
+    // Runs a single BFS with every source in the initial frontier, each node inherits the source of its parent
+    DistanceField::DistanceField(const Graph &graph, Property prop) noexcept
+        : _prop(prop), _epoch(graph.getEpoch()), _distance(graph.getNumNodes(), -1), _nearest(graph.getNumNodes(), -1),
+          _next_hop(graph.getNumNodes(), -1)
+    {
+        thread_local SearchWorkspace workspace;
+        workspace.begin(graph.getNumNodes());
+        for (int source : graph.getNodesWith(prop))
+        {
+            workspace.visit(source, source);
+            workspace.push(source);
+            _distance[source] = 0;
+            _nearest[source] = source;
+            _next_hop[source] = source;
+        }
+
+        while (!workspace.empty())
+        {
+            int node = workspace.pop();
+            for (int next : graph.getNeighbours(node))
+            {
+                if (!workspace.isVisited(next))
+                {
+                    workspace.visit(next, node);
+                    workspace.push(next);
+                    _distance[next] = _distance[node] + 1;
+                    _nearest[next] = _nearest[node];
+                    _next_hop[next] = node;
+                }
+            }
+        }
+    }
+
+    // An added edge can only shorten routes: the improvement spreads from its far end as a BFS.
+    // A removed edge cuts the subtree hanging below it off the BFS forest, those nodes are
+    // seeded from their neighbours outside of it and settled again in order of distance
+    void DistanceField::repairEdge(const Graph &graph, int node_1, int node_2) noexcept
+    {
+        _epoch = graph.getEpoch();
+        thread_local SearchWorkspace workspace;
+        workspace.begin(graph.getNumNodes());
+
+        if (graph.isEdge(node_1, node_2))
+        {
+            for (auto [from, to] : {std::pair{node_1, node_2}, std::pair{node_2, node_1}})
+            {
+                if (_distance[from] != -1 && (_distance[to] == -1 || _distance[from] + 1 < _distance[to]))
+                {
+                    _distance[to] = _distance[from] + 1;
+                    _nearest[to] = _nearest[from];
+                    _next_hop[to] = from;
+                    workspace.push(to);
+                }
+            }
+            while (!workspace.empty())
+            {
+                int node = workspace.pop();
+                for (int next : graph.getNeighbours(node))
+                {
+                    if (_distance[next] == -1 || _distance[node] + 1 < _distance[next])
+                    {
+                        _distance[next] = _distance[node] + 1;
+                        _nearest[next] = _nearest[node];
+                        _next_hop[next] = node;
+                        workspace.push(next);
+                    }
+                }
+            }
+            return;
+        }
+
+        // Collect the subtree below the removed tree edge, if it was one
+        std::vector<int> cut;
+        for (auto [parent, child] : {std::pair{node_1, node_2}, std::pair{node_2, node_1}})
+        {
+            if (_distance[child] > 0 && _next_hop[child] == parent)
+            {
+                workspace.visit(child, parent);
+                cut.push_back(child);
+            }
+        }
+        for (std::size_t k = 0; k < cut.size(); ++k)
+        {
+            for (int next : graph.getNeighbours(cut[k]))
+            {
+                if (!workspace.isVisited(next) && _next_hop[next] == cut[k])
+                {
+                    workspace.visit(next, cut[k]);
+                    cut.push_back(next);
+                }
+            }
+        }
+
+        // Reattach the cut nodes through their neighbours that kept their route
+        using Entry = std::pair<int, int>; // (distance, node)
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+        for (int node : cut)
+        {
+            _distance[node] = -1;
+            _nearest[node] = -1;
+            _next_hop[node] = -1;
+        }
+        for (int node : cut)
+        {
+            for (int next : graph.getNeighbours(node))
+            {
+                if (!workspace.isVisited(next) && _distance[next] != -1 &&
+                    (_distance[node] == -1 || _distance[next] + 1 < _distance[node]))
+                {
+                    _distance[node] = _distance[next] + 1;
+                    _nearest[node] = _nearest[next];
+                    _next_hop[node] = next;
+                }
+            }
+            if (_distance[node] != -1)
+            {
+                open.emplace(_distance[node], node);
+            }
+        }
+        while (!open.empty())
+        {
+            auto [distance, node] = open.top();
+            open.pop();
+            if (distance != _distance[node])
+            {
+                continue; // Stale entry
+            }
+            for (int next : graph.getNeighbours(node))
+            {
+                if (workspace.isVisited(next) && (_distance[next] == -1 || distance + 1 < _distance[next]))
+                {
+                    _distance[next] = distance + 1;
+                    _nearest[next] = _nearest[node];
+                    _next_hop[next] = node;
+                    open.emplace(distance + 1, next);
+                }
+            }
+        }
+    }
+
+    // A node of the property is a source of its own, any other node starts unreachable
+    void DistanceField::repairAddedNode(const Graph &graph) noexcept
+    {
+        _epoch = graph.getEpoch();
+        const int node = static_cast<int>(_distance.size());
+        const bool source = graph.getNode(node).getProperty() == _prop;
+        _distance.push_back(source ? 0 : -1);
+        _nearest.push_back(source ? node : -1);
+        _next_hop.push_back(source ? node : -1);
+    }
+
+    // The entries of the last node move to its new index, then its children in the forest (and the
+    // whole region it is the source of) are renamed. The graph already holds the moved node at node
+    void DistanceField::repairRemovedNode(const Graph &graph, int node) noexcept
+    {
+        _epoch = graph.getEpoch();
+        const int last = static_cast<int>(_distance.size()) - 1;
+        if (node != last)
+        {
+            const bool source = _nearest[last] == last;
+            _distance[node] = _distance[last];
+            _nearest[node] = source ? node : _nearest[last];
+            _next_hop[node] = source ? node : _next_hop[last];
+
+            std::vector<int> region{node};
+            for (std::size_t k = 0; k < region.size(); ++k)
+            {
+                for (int next : graph.getNeighbours(region[k]))
+                {
+                    if (next != node && _next_hop[next] == (region[k] == node ? last : region[k]))
+                    {
+                        _next_hop[next] = region[k];
+                        if (source)
+                        {
+                            _nearest[next] = node;
+                            region.push_back(next);
+                        }
+                    }
+                }
+            }
+        }
+        _distance.pop_back();
+        _nearest.pop_back();
+        _next_hop.pop_back();
+    }
+
+    // Getters for the field description
+    Property DistanceField::getProperty() const noexcept { return _prop; }
+    std::uint64_t DistanceField::getEpoch() const noexcept { return _epoch; }
+
+    // Reads the distance of a node
+    int DistanceField::getDistance(int node) const noexcept
+    {
+        if (node < 0 || static_cast<std::size_t>(node) >= _distance.size())
+        {
+            return -1;
+        }
+        return _distance[node];
+    }
+
+    // Reads the closest source of a node
+    int DistanceField::getNearestSource(int node) const noexcept
+    {
+        if (node < 0 || static_cast<std::size_t>(node) >= _nearest.size())
+        {
+            return -1;
+        }
+        return _nearest[node];
+    }
+
+    // Reads the next hop of a node
+    int DistanceField::getNextHop(int node) const noexcept
+    {
+        if (node < 0 || static_cast<std::size_t>(node) >= _next_hop.size())
+        {
+            return -1;
+        }
+        return _next_hop[node];
+    }
+
+    // Follows the next hops down to the source
+    bool DistanceField::getPath(int node, std::vector<int> &path) const noexcept
+    {
+        path.clear();
+        if (getDistance(node) == -1)
+        {
+            return false;
+        }
+        path.push_back(node);
+        while (_distance[node] > 0)
+        {
+            node = _next_hop[node];
+            path.push_back(node);
+        }
+        return true;
+    }
+
+    // Sums the capacity of the three arrays
+    std::size_t DistanceField::getMemoryUsage() const noexcept
+    {
+        return (_distance.capacity() + _nearest.capacity() + _next_hop.capacity()) * sizeof(int);
+    }
+} // namespace graph
@@ -0,0 +1,189 @@
+#include "flatindex.hpp"
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+namespace graph
+{
+    // Grows the table past three quarters full, then probes from the hashed slot
+    void FlatIndex::insert(std::uint64_t key, int value) noexcept
+    {
+        if ((_size + 1) * 4 > _values.size() * 3)
+        {
+            _rehash(std::max<std::size_t>(_values.size() * 2, FLAT_INDEX_MIN_CAPACITY));
+        }
+        for (std::size_t slot = _slotOf(key);; slot = (slot + 1) & _mask)
+        {
+            if (_values[slot] == -1)
+            {
+                _keys[slot] = key;
+                _values[slot] = value;
+                _size++;
+                return;
+            }
+            if (_keys[slot] == key)
+            {
+                return;
+            }
+        }
+    }
+
+    // Backward shift deletion: the keys probed past the freed slot move back so that no probe stops early
+    bool FlatIndex::erase(std::uint64_t key) noexcept
+    {
+        if (_values.empty())
+        {
+            return false;
+        }
+        std::size_t slot = _slotOf(key);
+        while (_keys[slot] != key || _values[slot] == -1)
+        {
+            if (_values[slot] == -1)
+            {
+                return false;
+            }
+            slot = (slot + 1) & _mask;
+        }
+
+        for (std::size_t next = (slot + 1) & _mask; _values[next] != -1; next = (next + 1) & _mask)
+        {
+            // The key at next can fill the hole unless its own slot lies between the hole and next
+            const std::size_t home = _slotOf(_keys[next]);
+            if (((next - home) & _mask) >= ((next - slot) & _mask))
+            {
+                _keys[slot] = _keys[next];
+                _values[slot] = _values[next];
+                slot = next;
+            }
+        }
+        _values[slot] = -1;
+        _size--;
+        return true;
+    }
+
+    // Random insertions miss the cache on every key once the table is large, so the keys are first
+    // grouped by window of slots (stable counting sort) and the table is then filled from start to end
+    void FlatIndex::build(std::span<const std::uint64_t> keys) noexcept
+    {
+        clear();
+        reserve(keys.size());
+        const std::size_t num_windows = (_mask >> FLAT_INDEX_BUILD_WINDOW) + 1;
+        std::vector<int> window_offsets(num_windows + 1, 0);
+        for (std::uint64_t key : keys)
+        {
+            window_offsets[(_slotOf(key) >> FLAT_INDEX_BUILD_WINDOW) + 1]++;
+        }
+        for (std::size_t w = 0; w < num_windows; ++w)
+        {
+            window_offsets[w + 1] += window_offsets[w];
+        }
+        std::vector<int> order(keys.size());
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            order[window_offsets[_slotOf(keys[i]) >> FLAT_INDEX_BUILD_WINDOW]++] = static_cast<int>(i);
+        }
+        for (int i : order)
+        {
+            insert(keys[i], i);
+        }
+    }
+
+    // Sizes the table so that num_keys keys stay under three quarters of it
+    void FlatIndex::reserve(std::size_t num_keys) noexcept
+    {
+        const std::size_t num_slots = std::bit_ceil(std::max<std::size_t>(num_keys * 4 / 3 + 1, FLAT_INDEX_MIN_CAPACITY));
+        if (num_slots > _values.size())
+        {
+            _rehash(num_slots);
+        }
+    }
+
+    // Releases the slots
+    void FlatIndex::clear() noexcept
+    {
+        _keys.clear();
+        _values.clear();
+        _mask = 0;
+        _size = 0;
+        _shift = 64;
+    }
+
+    // Keys keep their slots, only the values change
+    void FlatIndex::remap(std::span<const int> new_values) noexcept
+    {
+        for (int &value : _values)
+        {
+            if (value != -1)
+            {
+                value = new_values[value];
+            }
+        }
+    }
+
+    // Returns the number of keys
+    std::size_t FlatIndex::size() const noexcept
+    {
+        return _size;
+    }
+
+    // Returns the key slots
+    std::span<const std::uint64_t> FlatIndex::getKeys() const noexcept
+    {
+        return _keys;
+    }
+
+    // Returns the value slots
+    std::span<const int> FlatIndex::getValues() const noexcept
+    {
+        return _values;
+    }
+
+    // Copies the slots as they are, the hash of a key does not depend on anything but the number of slots
+    bool FlatIndex::assign(std::span<const std::uint64_t> keys, std::span<const int> values, int max_value) noexcept
+    {
+        clear();
+        if (keys.size() != values.size() || (!values.empty() && !std::has_single_bit(values.size())))
+        {
+            return false;
+        }
+        std::size_t size = 0;
+        for (int value : values)
+        {
+            if (value < -1 || value >= max_value)
+            {
+                return false;
+            }
+            size += value != -1;
+        }
+        if (size == values.size() && !values.empty())
+        {
+            return false; // A full table would never end a probe
+        }
+
+        _keys.assign(keys.begin(), keys.end());
+        _values.assign(values.begin(), values.end());
+        _size = size;
+        _mask = values.empty() ? 0 : values.size() - 1;
+        _shift = 64 - std::countr_zero(std::max<std::size_t>(values.size(), 1));
+        return true;
+    }
+
+    // Moves every key to its slot in the new table
+    void FlatIndex::_rehash(std::size_t num_slots) noexcept
+    {
+        std::vector<std::uint64_t> keys = std::move(_keys);
+        std::vector<int> values = std::move(_values);
+        _keys.assign(num_slots, 0);
+        _values.assign(num_slots, -1);
+        _mask = num_slots - 1;
+        _shift = 64 - std::countr_zero(num_slots);
+        _size = 0;
+        for (std::size_t slot = 0; slot < values.size(); ++slot)
+        {
+            if (values[slot] != -1)
+            {
+                insert(keys[slot], values[slot]);
+            }
+        }
+    }
+} // namespace graph
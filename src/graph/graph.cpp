@@ -1,127 +1,751 @@
 #include "graph.hpp"
-#include <random>
+#include "contractionhierarchy.hpp"
+#include "distancefield.hpp"
+#include "parallel.hpp"
+#include "routingtable.hpp"
 #include <algorithm>
-#include <queue>
+#include <cmath>
+#include <limits>
 #include <sstream>
+#include <type_traits>
 namespace graph
 {
+  // Packs (x, y) coordinates into a single key for the spatial index
+  std::uint64_t Graph::_coordinatesKey(int x, int y) noexcept
+  {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+  }
+
+  // Directions are numbered clockwise from up
+  int Graph::_getLatticeDirection(int dx, int dy) noexcept
+  {
+    return dy == -SCALE && dx == 0   ? 0
+           : dx == SCALE && dy == 0  ? 1
+           : dy == SCALE && dx == 0  ? 2
+           : dx == -SCALE && dy == 0 ? 3
+                                     : -1;
+  }
+
+  // Position of cell (x, y) along the Hilbert curve filling a side x side square (side is a power of two)
+  static inline std::uint64_t _hilbertKey(std::uint32_t x, std::uint32_t y, std::uint32_t side) noexcept
+  {
+    std::uint64_t key = 0;
+    for (std::uint32_t s = side / 2; s > 0; s /= 2)
+    {
+      const std::uint32_t rx = (x & s) ? 1 : 0;
+      const std::uint32_t ry = (y & s) ? 1 : 0;
+      key += static_cast<std::uint64_t>(s) * s * ((3 * rx) ^ ry);
+      if (ry == 0)
+      {
+        // Rotate the quadrant so the curve enters and leaves it at the right corners
+        if (rx == 1)
+        {
+          x = side - 1 - x;
+          y = side - 1 - y;
+        }
+        std::swap(x, y);
+      }
+    }
+    return key;
+  }
+
   // Clears the nodes and edges of the graph
   void Graph::clear() noexcept
   {
-    _nodes.clear();
-    _edges.clear();
-    _pickdropNodes.clear();
+    _ids.clear();
+    _xs.clear();
+    _ys.clear();
+    _props.clear();
+    for (auto &nodes : _property_nodes)
+    {
+      nodes.clear();
+    }
+    _property_slots.clear();
+    _pending_edges.clear();
+    _offsets.clear();
+    _neighbours.clear();
+    _weights.clear();
+    _lattice_links.clear();
+    _bitset_words = 0;
+    _adjacency_bits.clear();
+    _node_index.clear();
+    _id_index.clear();
+    _dropPrecomputed(); // Cached routes belong to the previous graph
+  }
+
+  // Resets every precomputed structure, the new epoch also retires the cached routes
+  void Graph::_dropPrecomputed() noexcept
+  {
+    _routing_table.reset();
+    _contraction_hierarchy.reset();
+    _landmarks.reset();
+    _hierarchy.reset();
+    {
+      std::lock_guard<std::mutex> lock(_distance_fields_mutex);
+      _distance_fields = {};
+    }
+    _epoch++;
   }
 
   // Checks if there is an edge between two nodes
   int Graph::isEdge(int i, int j) const noexcept
   {
-    return _edges[i][j];
+    if (i < 0 || j < 0 || i >= getNumNodes() || j >= getNumNodes())
+    {
+      return 0;
+    }
+
+    if (_hasBitsetRows())
+    {
+      if ((_adjacency_bits[static_cast<std::size_t>(i) * _bitset_words + (j >> 6)] >> (j & 63)) & 1)
+      {
+        return 1;
+      }
+    }
+    else
+    {
+      auto row = getNeighbours(i);
+      if (std::binary_search(row.begin(), row.end(), j))
+      {
+        return 1;
+      }
+    }
+
+    // Fall back to the edges that have not been frozen yet
+    return std::any_of(_pending_edges.cbegin(), _pending_edges.cend(),
+                       [i, j](const PendingEdge &edge)
+                       {
+                         return (edge.node_1 == i && edge.node_2 == j) || (edge.node_1 == j && edge.node_2 == i);
+                       })
+               ? 1
+               : 0;
   }
 
-  // Returns a constant reference to a node by index
-  const Node &Graph::getNode(int i) const noexcept
+  // The lattice links are only kept for uniform SCALE lattices
+  bool Graph::isLattice() const noexcept
   {
-    return *(_nodes[i]);
+    return !_lattice_links.empty();
   }
 
-  // Retrieves the node at the specified (x, y) coordinates
-  int Graph::getNodeAt(int x, int y) const noexcept
+  // Returns the neighbours of a node from the CSR store
+  std::span<const int> Graph::getNeighbours(int i) const noexcept
   {
-    auto it = std::find_if(_nodes.cbegin(), _nodes.cend(),
-                           [x, y](const std::unique_ptr<Node> &node)
-                           {
-                             return node->getX() == x && node->getY() == y;
-                           });
-    if (it != _nodes.cend())
+    if (i < 0 || static_cast<std::size_t>(i) + 1 >= _offsets.size())
     {
-      return std::distance(_nodes.cbegin(), it);
+      return {};
     }
-    return -1;
+    return std::span<const int>(_neighbours.data() + _offsets[i], _offsets[i + 1] - _offsets[i]);
   }
 
-  // Finds the shortest path between two nodes using BFS
-  std::vector<int> Graph::getShortestPath(int i, int j) const noexcept
+  // Returns the travel times of the edges of a node from the CSR store
+  std::span<const int> Graph::getEdgeWeights(int i) const noexcept
   {
-    std::vector<int> path;
-    std::vector<int> visited(_nodes.size(), 0);
-    std::vector<int> pred(_nodes.size(), -1);
-    std::queue<int> queue;
+    if (i < 0 || static_cast<std::size_t>(i) + 1 >= _offsets.size())
+    {
+      return {};
+    }
+    return std::span<const int>(_weights.data() + _offsets[i], _offsets[i + 1] - _offsets[i]);
+  }
 
-    queue.push(i);
-    visited[i] = 1;
+  // Returns the travel time of the edge between two nodes
+  int Graph::getEdgeWeight(int i, int j) const noexcept
+  {
+    auto row = getNeighbours(i);
+    auto it = std::lower_bound(row.begin(), row.end(), j);
+    if (it == row.end() || *it != j)
+    {
+      return -1;
+    }
+    return getEdgeWeights(i)[it - row.begin()];
+  }
 
-    // BFS to find the shortest path
-    while (!queue.empty())
+  // Sums the travel times along a path
+  int Graph::getPathCost(std::span<const int> path) const noexcept
+  {
+    int cost = 0;
+    for (std::size_t k = 1; k < path.size(); ++k)
     {
-      int node = queue.front();
-      queue.pop();
+      int weight = getEdgeWeight(path[k - 1], path[k]);
+      if (weight == -1)
+      {
+        return -1;
+      }
+      cost += weight;
+    }
+    return cost;
+  }
+
+  // Looks a node identifier up
+  int Graph::getNodeIndex(int id) const noexcept
+  {
+    return _id_index.find(static_cast<std::uint32_t>(id));
+  }
+
+  // Returns the number of nodes in the graph
+  int Graph::getNumNodes() const noexcept
+  {
+    return static_cast<int>(_ids.size());
+  }
+
+  // Returns the number of undirected edges in the CSR store
+  int Graph::getNumEdges() const noexcept
+  {
+    return static_cast<int>(_neighbours.size() / 2);
+  }
 
-      for (std::size_t k = 0; k < _edges[node].size(); ++k)
+  // Assembles a node view from the parallel arrays
+  Node Graph::getNode(int i) const noexcept
+  {
+    return Node(_ids[i], _xs[i], _ys[i], _props[i]);
+  }
+
+  // Returns the x coordinates of the nodes
+  std::span<const int> Graph::getXs() const noexcept
+  {
+    return _xs;
+  }
+
+  // Returns the y coordinates of the nodes
+  std::span<const int> Graph::getYs() const noexcept
+  {
+    return _ys;
+  }
+
+  // Returns the index list of a property
+  std::span<const int> Graph::getNodesWith(Property prop) const noexcept
+  {
+    return _property_nodes[static_cast<int>(prop)];
+  }
+
+  // Retrieves the node at the specified (x, y) coordinates
+  int Graph::getNodeAt(int x, int y) const noexcept
+  {
+    return _node_index.find(_coordinatesKey(x, y));
+  }
+
+  // Snaps a position to the closest node, searching lattice rings around it first
+  int Graph::getNearestNode(float x, float y) const noexcept
+  {
+    if (_ids.empty())
+    {
+      return -1;
+    }
+
+    auto squaredDistance = [this, x, y](int node)
+    {
+      float dx = _xs[node] - x;
+      float dy = _ys[node] - y;
+      return dx * dx + dy * dy;
+    };
+
+    const int center_x = static_cast<int>(std::lround(x / SCALE));
+    const int center_y = static_cast<int>(std::lround(y / SCALE));
+    int best = -1;
+    float best_distance = std::numeric_limits<float>::max();
+
+    for (int r = 0; r <= SNAP_MAX_RADIUS; ++r)
+    {
+      // Nodes on ring r are at least (r - 0.5) * SCALE away from the position
+      float ring_distance = std::max(0.0f, (r - 0.5f) * SCALE);
+      if (best != -1 && ring_distance * ring_distance > best_distance)
       {
-        if (_edges[node][k] == 1 && visited[k] == 0)
-        {
-          visited[k] = 1;
-          pred[k] = node;
-          queue.push(static_cast<int>(k));
+        return best;
+      }
 
-          // Stop if we reached the destination
-          if (static_cast<int>(k) == j)
+      for (int dy = -r; dy <= r; ++dy)
+      {
+        for (int dx = -r; dx <= r; ++dx)
+        {
+          if (std::max(std::abs(dx), std::abs(dy)) != r)
+          {
+            continue; // Only visit the border of the ring
+          }
+          int node = getNodeAt((center_x + dx) * SCALE, (center_y + dy) * SCALE);
+          if (node != -1 && squaredDistance(node) < best_distance)
           {
-            break;
+            best = node;
+            best_distance = squaredDistance(node);
           }
         }
       }
     }
 
-    // Trace the path back from the destination to the source
-    int node = j;
-    while (node != -1)
+    // The position is far from the lattice or from any node, scan every node
+    for (int i = 0; i < getNumNodes(); ++i)
+    {
+      if (squaredDistance(i) < best_distance)
+      {
+        best = i;
+        best_distance = squaredDistance(i);
+      }
+    }
+    return best;
+  }
+
+  // Builds the routing table unless the graph is too large for a quadratic table or has mixed weights
+  bool Graph::buildRoutingTable() noexcept
+  {
+    if (getNumNodes() > ROUTING_TABLE_MAX_NODES || !_uniform_weights)
+    {
+      _routing_table.reset();
+      return false;
+    }
+    _routing_table = std::make_shared<const RoutingTable>(*this);
+    return true;
+  }
+
+  // Returns the routing table if it has been built
+  const RoutingTable *Graph::getRoutingTable() const noexcept
+  {
+    return _routing_table.get();
+  }
+
+  // Contracts the graph, the hierarchy replaces the previous one
+  void Graph::buildContractionHierarchy() noexcept
+  {
+    _contraction_hierarchy = std::make_shared<const ContractionHierarchy>(*this);
+  }
+
+  // Returns the contraction hierarchy if it has been built
+  const ContractionHierarchy *Graph::getContractionHierarchy() const noexcept
+  {
+    return _contraction_hierarchy.get();
+  }
+
+  // Computes the landmark distances, they replace the previous ones
+  void Graph::buildLandmarks(int num_landmarks) noexcept
+  {
+    _landmarks = std::make_shared<const Landmarks>(*this, num_landmarks);
+  }
+
+  // Returns the landmarks if they have been built
+  const Landmarks *Graph::getLandmarks() const noexcept
+  {
+    return _landmarks.get();
+  }
+
+  // Cuts the graph into clusters, the cluster graph replaces the previous one
+  void Graph::buildHierarchy(int cluster_size) noexcept
+  {
+    _hierarchy = std::make_shared<const HierarchicalGraph>(*this, cluster_size);
+  }
+
+  // Returns the cluster graph if it has been built
+  std::shared_ptr<const HierarchicalGraph> Graph::getHierarchy() const noexcept
+  {
+    return _hierarchy;
+  }
+
+  // Builds the fields of all properties at once, one per thread
+  void Graph::buildDistanceFields() noexcept
+  {
+    std::array<std::shared_ptr<const DistanceField>, NUM_PROPERTIES> fields;
+    parallelFor(NUM_PROPERTIES, [&](int prop, int)
+                { fields[prop] = std::make_shared<const DistanceField>(*this, static_cast<Property>(prop)); });
+
+    std::lock_guard<std::mutex> lock(_distance_fields_mutex);
+    _distance_fields = std::move(fields);
+  }
+
+  // Hands out the field of a property, rebuilding it if it belongs to an older epoch
+  std::shared_ptr<const DistanceField> Graph::getDistanceField(Property prop) const noexcept
+  {
+    std::lock_guard<std::mutex> lock(_distance_fields_mutex);
+    auto &field = _distance_fields[static_cast<int>(prop)];
+    if (!field || field->getEpoch() != _epoch)
     {
-      path.push_back(node);
-      node = pred[node];
+      field = std::make_shared<const DistanceField>(*this, prop);
     }
+    return field;
+  }
+
+  // Looks the closest node of a property up in its distance field
+  int Graph::getNearestWith(int node, Property prop) const noexcept
+  {
+    return getDistanceField(prop)->getNearestSource(node);
+  }
 
-    std::reverse(path.begin(), path.end());
-    return path;
+  // Switches the adjacency storage, the bit rows are built from the current CSR store
+  bool Graph::setAdjacencyBackend(AdjacencyBackend backend) noexcept
+  {
+    const bool fits = backend == AdjacencyBackend::csr || getNumNodes() <= BITSET_MAX_NODES;
+    _backend = fits ? backend : AdjacencyBackend::csr;
+    _buildBitset();
+    return fits;
   }
 
-  // Returns a random pick-drop node index
-  int Graph::getRandomPickDrop() const noexcept
+  // Returns the adjacency storage in use
+  AdjacencyBackend Graph::getAdjacencyBackend() const noexcept
   {
-    if (_pickdropNodes.size() < 2)
+    return _backend;
+  }
+
+  // Returns the epoch of the graph
+  std::uint64_t Graph::getEpoch() const noexcept
+  {
+    return _epoch;
+  }
+
+  // Returns the route cache
+  PathCache &Graph::getPathCache() const noexcept
+  {
+    return *_path_cache;
+  }
+
+  // Returns a random pick-drop node index drawn from rng
+  int Graph::getRandomPickDrop(Rng &rng) const noexcept
+  {
+    const auto &pickdrop_nodes = _property_nodes[static_cast<int>(Property::pickdrop)];
+    if (pickdrop_nodes.size() < 2)
     {
       return -1; // Return -1 if there are less than 2 pick-drop nodes
     }
 
-    std::random_device rd;                                              // Random seed
-    std::mt19937 gen(rd());                                             // Mersenne Twister engine
-    std::uniform_int_distribution<> dist(0, _pickdropNodes.size() - 1); // Uniform distribution
+    return pickdrop_nodes[rng.below(static_cast<int>(pickdrop_nodes.size()))]; // Return a random pick-drop node index
+  }
 
-    return _pickdropNodes[dist(gen)]; // Return a random pick-drop node index
+  // Adds a node to the graph, its edges are stored once the graph is frozen
+  void Graph::_addNode(int id, int x, int y, const Property &prop, bool indexed) noexcept
+  {
+    const int index = getNumNodes();
+    _ids.push_back(id);
+    _xs.push_back(x);
+    _ys.push_back(y);
+    _props.push_back(prop);
+    if (indexed)
+    {
+      _node_index.insert(_coordinatesKey(x, y), index);
+      _id_index.insert(static_cast<std::uint32_t>(id), index);
+    }
+    _property_slots.push_back(static_cast<int>(_property_nodes[static_cast<int>(prop)].size()));
+    _property_nodes[static_cast<int>(prop)].push_back(index);
   }
 
-  // Adds a node to the graph and updates the adjacency matrix
-  void Graph::_addNode(int id, int x, int y, const Property &prop) noexcept
+  // Adds an edge between two nodes (bidirectional) to the bulk builder
+  void Graph::_addEdge(int i, int j, int weight) noexcept
   {
-    _nodes.emplace_back(std::make_unique<Node>(id, x, y, prop));
+    if (i == j)
+    {
+      return; // Self loops are never needed for path finding
+    }
+    if (weight < 0)
+    {
+      // Robots cover one pixel per time unit, so an edge takes its length to travel
+      weight = std::abs(_xs[i] - _xs[j]) + std::abs(_ys[i] - _ys[j]);
+    }
+    _pending_edges.push_back({i, j, std::max(weight, 1)});
+  }
+
+  // Constant time, the node leaves its old list through its slot and joins the end of the new one
+  void Graph::_setProperty(int i, const Property &prop) noexcept
+  {
+    _unlistProperty(i);
+    _props[i] = prop;
+    _property_slots[i] = static_cast<int>(_property_nodes[static_cast<int>(prop)].size());
+    _property_nodes[static_cast<int>(prop)].push_back(i);
+  }
+
+  // Swaps the node with the last one of its list, so the lists are not kept in index order
+  void Graph::_unlistProperty(int i) noexcept
+  {
+    auto &nodes = _property_nodes[static_cast<int>(_props[i])];
+    const int moved = nodes.back();
+    nodes[_property_slots[i]] = moved;
+    _property_slots[moved] = _property_slots[i];
+    nodes.pop_back();
+  }
 
-    if (prop == Property::pickdrop)
+  // Reserves builder capacity ahead of a bulk load
+  void Graph::_reserve(int num_nodes, int num_edges) noexcept
+  {
+    _ids.reserve(num_nodes);
+    _xs.reserve(num_nodes);
+    _ys.reserve(num_nodes);
+    _props.reserve(num_nodes);
+    _property_slots.reserve(num_nodes);
+    _pending_edges.reserve(num_edges);
+  }
+
+  // Both indexes are built in one pass each, keys[i] being the key of node i
+  void Graph::_indexNodes() noexcept
+  {
+    std::vector<std::uint64_t> keys(_ids.size());
+    for (std::size_t i = 0; i < keys.size(); ++i)
     {
-      _pickdropNodes.push_back(_nodes.size() - 1); // Add the index of the pickdrop node
+      keys[i] = _coordinatesKey(_xs[i], _ys[i]);
     }
+    _node_index.build(keys);
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+      keys[i] = static_cast<std::uint32_t>(_ids[i]);
+    }
+    _id_index.build(keys);
+  }
 
-    for (auto &edge : _edges)
+  // Packs the frozen rows and the pending edges into a new CSR store (counting sort, O(V + E))
+  void Graph::_freeze() noexcept
+  {
+    const std::size_t num_nodes = _ids.size();
+    std::vector<int> offsets(num_nodes + 1, 0);
+
+    // Count the degree of every node
+    for (std::size_t i = 0; i + 1 < _offsets.size(); ++i)
+    {
+      offsets[i + 1] = _offsets[i + 1] - _offsets[i];
+    }
+    for (const PendingEdge &edge : _pending_edges)
+    {
+      ++offsets[edge.node_1 + 1];
+      ++offsets[edge.node_2 + 1];
+    }
+    for (std::size_t i = 0; i < num_nodes; ++i)
+    {
+      offsets[i + 1] += offsets[i];
+    }
+
+    // Scatter the (neighbour, weight) entries into their rows
+    std::vector<std::pair<int, int>> entries(offsets[num_nodes]);
+    std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+    for (std::size_t i = 0; i + 1 < _offsets.size(); ++i)
+    {
+      for (int k = _offsets[i]; k < _offsets[i + 1]; ++k)
+      {
+        entries[cursor[i]++] = {_neighbours[k], _weights[k]};
+      }
+    }
+    for (const PendingEdge &edge : _pending_edges)
+    {
+      entries[cursor[edge.node_1]++] = {edge.node_2, edge.weight};
+      entries[cursor[edge.node_2]++] = {edge.node_1, edge.weight};
+    }
+
+    // Sort each row and drop duplicated edges (keeping the fastest), compacting the arrays
+    std::vector<int> neighbours;
+    std::vector<int> weights;
+    neighbours.reserve(entries.size());
+    weights.reserve(entries.size());
+    for (std::size_t i = 0; i < num_nodes; ++i)
+    {
+      auto row_begin = entries.begin() + offsets[i];
+      auto row_end = entries.begin() + offsets[i + 1];
+      std::sort(row_begin, row_end);
+
+      offsets[i] = static_cast<int>(neighbours.size());
+      for (auto it = row_begin; it != row_end; ++it)
+      {
+        if (neighbours.size() == static_cast<std::size_t>(offsets[i]) || neighbours.back() != it->first)
+        {
+          neighbours.push_back(it->first);
+          weights.push_back(it->second);
+        }
+      }
+    }
+    offsets[num_nodes] = static_cast<int>(neighbours.size());
+    neighbours.shrink_to_fit();
+    weights.shrink_to_fit();
+
+    // Track the cheapest travel time per pixel so the Manhattan heuristic stays admissible
+    _min_weight_per_length = std::numeric_limits<double>::max();
+    _uniform_weights = true;
+    for (std::size_t i = 0; i < num_nodes; ++i)
+    {
+      for (int k = offsets[i]; k < offsets[i + 1]; ++k)
+      {
+        const int j = neighbours[k];
+        int length = std::abs(_xs[i] - _xs[j]) + std::abs(_ys[i] - _ys[j]);
+        _min_weight_per_length = std::min(_min_weight_per_length, static_cast<double>(weights[k]) / std::max(length, 1));
+        _uniform_weights = _uniform_weights && weights[k] == weights.front();
+      }
+    }
+    if (neighbours.empty())
     {
-      edge.push_back(0);
+      _min_weight_per_length = 1.0;
     }
-    _edges.emplace_back(_nodes.size(), 0);
+
+    // Uniform lattices also get one link per direction for jump point search
+    bool lattice = _uniform_weights && num_nodes > 0;
+    std::vector<int> lattice_links(lattice ? num_nodes * 4 : 0, -1);
+    for (std::size_t i = 0; lattice && i < num_nodes; ++i)
+    {
+      for (int k = offsets[i]; lattice && k < offsets[i + 1]; ++k)
+      {
+        const int j = neighbours[k];
+        const int direction = _getLatticeDirection(_xs[j] - _xs[i], _ys[j] - _ys[i]);
+        lattice = direction != -1;
+        if (lattice)
+        {
+          lattice_links[i * 4 + direction] = j;
+        }
+      }
+    }
+    _lattice_links = lattice ? std::move(lattice_links) : std::vector<int>();
+
+    _offsets = std::move(offsets);
+    _neighbours = std::move(neighbours);
+    _weights = std::move(weights);
+    _pending_edges.clear();
+    _pending_edges.shrink_to_fit();
+    _dropPrecomputed(); // Routes may have changed
+
+    // The bit rows follow the CSR store, the backend falls back to CSR if the graph outgrew them
+    if (_backend == AdjacencyBackend::bitset && getNumNodes() > BITSET_MAX_NODES)
+    {
+      _backend = AdjacencyBackend::csr;
+    }
+    _buildBitset();
+  }
+
+  // Sorts the nodes by the Hilbert key of their lattice cell, ties keep their current order
+  void Graph::renumberNodes() noexcept
+  {
+    const int num_nodes = getNumNodes();
+    if (num_nodes == 0)
+    {
+      return;
+    }
+    if (!_pending_edges.empty() || _offsets.size() != static_cast<std::size_t>(num_nodes) + 1)
+    {
+      _freeze(); // The permutation works on frozen rows
+    }
+
+    const int min_x = *std::min_element(_xs.cbegin(), _xs.cend());
+    const int min_y = *std::min_element(_ys.cbegin(), _ys.cend());
+    const std::int64_t cells = std::max(static_cast<std::int64_t>(*std::max_element(_xs.cbegin(), _xs.cend())) - min_x,
+                                        static_cast<std::int64_t>(*std::max_element(_ys.cbegin(), _ys.cend())) - min_y) /
+                                   SCALE +
+                               1;
+    std::uint32_t side = 1;
+    while (side < cells)
+    {
+      side *= 2;
+    }
+
+    std::vector<std::pair<std::uint64_t, int>> keys(num_nodes);
+    for (int i = 0; i < num_nodes; ++i)
+    {
+      auto cell_x = static_cast<std::uint32_t>((static_cast<std::int64_t>(_xs[i]) - min_x) / SCALE);
+      auto cell_y = static_cast<std::uint32_t>((static_cast<std::int64_t>(_ys[i]) - min_y) / SCALE);
+      keys[i] = {_hilbertKey(cell_x, cell_y, side), i};
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<int> order(num_nodes);
+    for (int k = 0; k < num_nodes; ++k)
+    {
+      order[k] = keys[k].second;
+    }
+    _permuteNodes(order);
+  }
+
+  // Gathers every node array through the permutation and renames the neighbours in the CSR rows
+  void Graph::_permuteNodes(std::span<const int> order) noexcept
+  {
+    const int num_nodes = getNumNodes();
+    std::vector<int> index_of(num_nodes); // New index of each current one
+    for (int k = 0; k < num_nodes; ++k)
+    {
+      index_of[order[k]] = k;
+    }
+
+    auto gather = [&](auto &values)
+    {
+      std::remove_reference_t<decltype(values)> moved(values.size());
+      for (int k = 0; k < num_nodes; ++k)
+      {
+        moved[k] = values[order[k]];
+      }
+      values = std::move(moved);
+    };
+    gather(_ids);
+    gather(_xs);
+    gather(_ys);
+    gather(_props);
+
+    for (auto &nodes : _property_nodes)
+    {
+      nodes.clear();
+    }
+    _property_slots.resize(num_nodes);
+    for (int k = 0; k < num_nodes; ++k)
+    {
+      _property_slots[k] = static_cast<int>(_property_nodes[static_cast<int>(_props[k])].size());
+      _property_nodes[static_cast<int>(_props[k])].push_back(k);
+    }
+    _node_index.remap(index_of);
+    _id_index.remap(index_of);
+
+    // Rows follow their node, neighbours are renamed then sorted again with their travel times
+    std::vector<int> offsets(num_nodes + 1, 0);
+    std::vector<int> neighbours(_neighbours.size());
+    std::vector<int> weights(_weights.size());
+    std::vector<std::pair<int, int>> row;
+    for (int k = 0; k < num_nodes; ++k)
+    {
+      const int node = order[k];
+      row.clear();
+      for (int e = _offsets[node]; e < _offsets[node + 1]; ++e)
+      {
+        row.emplace_back(index_of[_neighbours[e]], _weights[e]);
+      }
+      std::sort(row.begin(), row.end());
+      offsets[k + 1] = offsets[k] + static_cast<int>(row.size());
+      for (std::size_t e = 0; e < row.size(); ++e)
+      {
+        neighbours[offsets[k] + e] = row[e].first;
+        weights[offsets[k] + e] = row[e].second;
+      }
+    }
+    _offsets = std::move(offsets);
+    _neighbours = std::move(neighbours);
+    _weights = std::move(weights);
+
+    if (!_lattice_links.empty())
+    {
+      std::vector<int> lattice_links(_lattice_links.size());
+      for (int k = 0; k < num_nodes; ++k)
+      {
+        for (int d = 0; d < 4; ++d)
+        {
+          const int link = _lattice_links[order[k] * 4 + d];
+          lattice_links[k * 4 + d] = link == -1 ? -1 : index_of[link];
+        }
+      }
+      _lattice_links = std::move(lattice_links);
+    }
+
+    _dropPrecomputed(); // Precomputed structures and cached routes are keyed by index
+    _buildBitset();
+  }
+
+  // Checks that the bit rows cover every node, nodes added since the last freeze have none
+  bool Graph::_hasBitsetRows() const noexcept
+  {
+    return _backend == AdjacencyBackend::bitset && getNumNodes() > 0 &&
+           _adjacency_bits.size() == static_cast<std::size_t>(getNumNodes()) * _bitset_words &&
+           _bitset_words == (getNumNodes() + 63) / 64;
   }
-  // Adds an edge between two nodes (bidirectional)
-  void Graph::_addEdge(int i, int j) noexcept
+
+  // Sets one bit per edge, rows are padded to whole words
+  void Graph::_buildBitset() noexcept
   {
-    _edges[i][j] = 1;
-    _edges[j][i] = 1;
+    _adjacency_bits.clear();
+    _bitset_words = 0;
+    if (_backend != AdjacencyBackend::bitset)
+    {
+      _adjacency_bits.shrink_to_fit();
+      return;
+    }
+
+    _bitset_words = (getNumNodes() + 63) / 64;
+    _adjacency_bits.assign(static_cast<std::size_t>(getNumNodes()) * _bitset_words, 0);
+    for (int i = 0; i < getNumNodes(); ++i)
+    {
+      std::uint64_t *row = _adjacency_bits.data() + static_cast<std::size_t>(i) * _bitset_words;
+      for (int j : getNeighbours(i))
+      {
+        row[j >> 6] |= std::uint64_t{1} << (j & 63);
+      }
+    }
   }
 
   // Converts the graph to a JSON string representation
@@ -131,10 +755,12 @@ namespace graph
 
     json << "{\n\"nodes\": [\n";
 
-    for (std::size_t i = 0; i < _nodes.size(); ++i)
+    // Written straight from the node arrays, same layout as Node::getToJson
+    for (int i = 0; i < getNumNodes(); ++i)
     {
-      json << _nodes[i]->getToJson();
-      if (i < _nodes.size() - 1) // Add a comma unless it's the last element
+      json << "{\n\"id\": " << _ids[i] << ",\n\"x\": " << _xs[i] << ",\n\"y\": " << _ys[i]
+           << ",\n\"p\": \"" << getPropertyName(_props[i]) << "\"\n}";
+      if (i < getNumNodes() - 1) // Add a comma unless it's the last element
       {
         json << ",";
       }
@@ -144,19 +770,16 @@ namespace graph
     json << "],\n\"edges\": [\n";
     bool first_edge = true;
 
-    for (std::size_t i = 0; i < _edges.size(); ++i)
+    for (int i = 0; i < getNumNodes(); ++i)
     {
-      for (std::size_t j = 0; j < _edges[i].size(); ++j)
+      for (int j : getNeighbours(i))
       {
-        if (_edges[i][j] == 1)
+        if (!first_edge)
         {
-          if (!first_edge)
-          {
-            json << ",";
-          }
-          first_edge = false;
-          json << "{\"n1\": " << i << ", \"n2\": " << j << "}\n";
+          json << ",";
         }
+        first_edge = false;
+        json << "{\"n1\": " << _ids[i] << ", \"n2\": " << _ids[j] << "}\n";
       }
     }
 
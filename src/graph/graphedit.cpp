@@ -0,0 +1,326 @@
+#include "graph.hpp"
+#include "contractionhierarchy.hpp"
+#include "distancefield.hpp"
+#include "routingtable.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace graph
+{
+  // Precomputed structures are shared with the snapshots they came from, so an edit repairs a copy
+  // of them and swaps it in, readers of the previous snapshot keep theirs untouched
+  template <typename T, typename Repair>
+  static void _repairCopy(std::shared_ptr<const T> &shared, Repair &&repair) noexcept
+  {
+    if (shared)
+    {
+      auto copy = std::make_shared<T>(*shared);
+      repair(*copy);
+      shared = std::move(copy);
+    }
+  }
+
+  // The cluster graph is copied so that it reads this graph, the other structures do not point back to theirs
+  Graph::Graph(const Graph &other) noexcept
+      : _ids(other._ids), _xs(other._xs), _ys(other._ys), _props(other._props), _property_nodes(other._property_nodes),
+        _property_slots(other._property_slots), _pending_edges(other._pending_edges), _offsets(other._offsets), _neighbours(other._neighbours),
+        _weights(other._weights), _lattice_links(other._lattice_links), _backend(other._backend),
+        _bitset_words(other._bitset_words), _adjacency_bits(other._adjacency_bits), _node_index(other._node_index),
+        _id_index(other._id_index), _min_weight_per_length(other._min_weight_per_length),
+        _uniform_weights(other._uniform_weights), _routing_table(other._routing_table),
+        _contraction_hierarchy(other._contraction_hierarchy), _landmarks(other._landmarks),
+        _hierarchy(other._hierarchy ? std::make_shared<const HierarchicalGraph>(*other._hierarchy, *this) : nullptr),
+        _epoch(other._epoch)
+  {
+    std::lock_guard<std::mutex> lock(other._distance_fields_mutex);
+    _distance_fields = other._distance_fields;
+  }
+
+  // The node gets an empty row, the structures sized by the number of nodes are extended or dropped
+  int Graph::addNode(int id, int x, int y, Property prop) noexcept
+  {
+    _ensureFrozen();
+    if (getNodeIndex(id) != -1 || getNodeAt(x, y) != -1)
+    {
+      return -1;
+    }
+    const int node = getNumNodes();
+    _addNode(id, x, y, prop);
+    _offsets.push_back(_offsets.back());
+    if (!_lattice_links.empty())
+    {
+      _lattice_links.resize(_lattice_links.size() + 4, -1);
+    }
+    if (_backend == AdjacencyBackend::bitset && getNumNodes() > BITSET_MAX_NODES)
+    {
+      _backend = AdjacencyBackend::csr;
+    }
+    _buildBitset(); // Rows widen with the number of nodes
+
+    const std::uint64_t epoch = _epoch++;
+    _routing_table.reset();         // Its matrices are sized by the number of nodes
+    _contraction_hierarchy.reset(); // Shortcuts cannot be patched
+    _hierarchy.reset();             // The node lies in no cluster yet
+    _repairCopy(_landmarks, [](Landmarks &landmarks)
+                { landmarks.repairAddedNode(); });
+    std::lock_guard<std::mutex> lock(_distance_fields_mutex);
+    for (auto &field : _distance_fields)
+    {
+      if (field && field->getEpoch() == epoch)
+      {
+        _repairCopy(field, [this](DistanceField &copy)
+                    { copy.repairAddedNode(*this); });
+      }
+    }
+    return node;
+  }
+
+  // The edges go one by one, then the last node moves into the freed index: its row moves in front of the
+  // rows after i and its neighbours rename it in theirs. The whole removal is one epoch, the distance fields
+  // are copied once and every edge, then the node, is repaired on the copies
+  bool Graph::removeNode(int i) noexcept
+  {
+    _ensureFrozen();
+    if (i < 0 || i >= getNumNodes())
+    {
+      return false;
+    }
+    _routing_table.reset(); // Sized by the number of nodes, built again on demand
+    _contraction_hierarchy.reset();
+    _hierarchy.reset();
+    const std::uint64_t epoch = _epoch++;
+    std::lock_guard<std::mutex> lock(_distance_fields_mutex);
+    std::array<std::shared_ptr<DistanceField>, NUM_PROPERTIES> fields;
+    for (int p = 0; p < NUM_PROPERTIES; ++p)
+    {
+      if (_distance_fields[p] && _distance_fields[p]->getEpoch() == epoch)
+      {
+        fields[p] = std::make_shared<DistanceField>(*_distance_fields[p]);
+      }
+    }
+    while (_offsets[i + 1] > _offsets[i])
+    {
+      const int j = _neighbours[_offsets[i]];
+      _detachEdge(i, j); // Removing an edge never repairs the landmarks, they are only patched for the node
+      for (auto &field : fields)
+      {
+        if (field)
+        {
+          field->repairEdge(*this, i, j);
+        }
+      }
+    }
+
+    const int last = getNumNodes() - 1;
+    _node_index.erase(_coordinatesKey(_xs[i], _ys[i]));
+    _id_index.erase(static_cast<std::uint32_t>(_ids[i]));
+    _unlistProperty(i);
+    if (i != last)
+    {
+      _node_index.erase(_coordinatesKey(_xs[last], _ys[last]));
+      _id_index.erase(static_cast<std::uint32_t>(_ids[last]));
+      _node_index.insert(_coordinatesKey(_xs[last], _ys[last]), i);
+      _id_index.insert(static_cast<std::uint32_t>(_ids[last]), i);
+      _property_nodes[static_cast<int>(_props[last])][_property_slots[last]] = i;
+      _property_slots[i] = _property_slots[last];
+      _ids[i] = _ids[last];
+      _xs[i] = _xs[last];
+      _ys[i] = _ys[last];
+      _props[i] = _props[last];
+
+      // The row of the last node ends the arrays, it is rotated into the empty row of i
+      const int degree = _offsets[last + 1] - _offsets[last];
+      std::rotate(_neighbours.begin() + _offsets[i], _neighbours.begin() + _offsets[last], _neighbours.end());
+      std::rotate(_weights.begin() + _offsets[i], _weights.begin() + _offsets[last], _weights.end());
+      for (int k = i + 1; k <= last; ++k)
+      {
+        _offsets[k] += degree;
+      }
+
+      // The last node sorts last in the rows of its neighbours, its new index moves back into place
+      for (int neighbour : getNeighbours(i))
+      {
+        auto begin = _neighbours.begin() + _offsets[neighbour];
+        auto end = _neighbours.begin() + _offsets[neighbour + 1];
+        *(end - 1) = i;
+        auto position = std::lower_bound(begin, end - 1, i);
+        std::rotate(position, end - 1, end);
+        std::rotate(_weights.begin() + (position - _neighbours.begin()), _weights.begin() + (end - 1 - _neighbours.begin()),
+                    _weights.begin() + (end - _neighbours.begin()));
+      }
+
+      if (!_lattice_links.empty())
+      {
+        for (int d = 0; d < 4; ++d)
+        {
+          const int link = _lattice_links[last * 4 + d];
+          _lattice_links[i * 4 + d] = link;
+          if (link != -1)
+          {
+            _lattice_links[link * 4 + (d + 2) % 4] = i;
+          }
+        }
+      }
+    }
+    _ids.pop_back();
+    _xs.pop_back();
+    _ys.pop_back();
+    _props.pop_back();
+    _property_slots.pop_back();
+    _offsets.pop_back();
+    if (!_lattice_links.empty())
+    {
+      _lattice_links.resize(_lattice_links.size() - 4);
+    }
+    _buildBitset();
+
+    _repairCopy(_landmarks, [i](Landmarks &landmarks)
+                { landmarks.repairRemovedNode(i); });
+    for (int p = 0; p < NUM_PROPERTIES; ++p)
+    {
+      if (fields[p])
+      {
+        fields[p]->repairRemovedNode(*this, i);
+        _distance_fields[p] = std::move(fields[p]);
+      }
+    }
+    return true;
+  }
+
+  // Both rows take the edge, the weight statistics of the A* heuristic follow it
+  bool Graph::addEdge(int i, int j, int weight) noexcept
+  {
+    _ensureFrozen();
+    if (i < 0 || j < 0 || i >= getNumNodes() || j >= getNumNodes() || i == j || getEdgeWeight(i, j) != -1)
+    {
+      return false;
+    }
+    const int length = std::abs(_xs[i] - _xs[j]) + std::abs(_ys[i] - _ys[j]);
+    weight = std::max(weight < 0 ? length : weight, 1);
+    const double weight_per_length = static_cast<double>(weight) / std::max(length, 1);
+    _min_weight_per_length = _neighbours.empty() ? weight_per_length : std::min(_min_weight_per_length, weight_per_length);
+    _uniform_weights = _neighbours.empty() || (_uniform_weights && weight == _weights.front());
+
+    _insertArc(i, j, weight);
+    _insertArc(j, i, weight);
+    _updateLatticeLinks(i, j, true);
+    if (_hasBitsetRows())
+    {
+      _adjacency_bits[static_cast<std::size_t>(i) * _bitset_words + (j >> 6)] |= std::uint64_t{1} << (j & 63);
+      _adjacency_bits[static_cast<std::size_t>(j) * _bitset_words + (i >> 6)] |= std::uint64_t{1} << (i & 63);
+    }
+    _repairEdge(i, j);
+    return true;
+  }
+
+  // The weight statistics are kept: the smallest travel time per pixel stays a lower bound without the edge
+  bool Graph::removeEdge(int i, int j) noexcept
+  {
+    _ensureFrozen();
+    if (getEdgeWeight(i, j) == -1)
+    {
+      return false;
+    }
+    _detachEdge(i, j);
+    _repairEdge(i, j);
+    return true;
+  }
+
+  // Both arcs, the lattice links and the bit rows lose the edge
+  void Graph::_detachEdge(int i, int j) noexcept
+  {
+    _eraseArc(i, j);
+    _eraseArc(j, i);
+    _updateLatticeLinks(i, j, false);
+    if (_hasBitsetRows())
+    {
+      _adjacency_bits[static_cast<std::size_t>(i) * _bitset_words + (j >> 6)] &= ~(std::uint64_t{1} << (j & 63));
+      _adjacency_bits[static_cast<std::size_t>(j) * _bitset_words + (i >> 6)] &= ~(std::uint64_t{1} << (i & 63));
+    }
+  }
+
+  // Freezes the graph unless its rows are up to date
+  void Graph::_ensureFrozen() noexcept
+  {
+    if (!_pending_edges.empty() || _offsets.size() != _ids.size() + 1)
+    {
+      _freeze();
+    }
+  }
+
+  // Shifts the arrays past the row by one entry, O(V + E) but without rebuilding anything
+  void Graph::_insertArc(int i, int j, int weight) noexcept
+  {
+    auto position = std::lower_bound(_neighbours.begin() + _offsets[i], _neighbours.begin() + _offsets[i + 1], j);
+    _weights.insert(_weights.begin() + (position - _neighbours.begin()), weight);
+    _neighbours.insert(position, j);
+    for (std::size_t k = i + 1; k < _offsets.size(); ++k)
+    {
+      _offsets[k]++;
+    }
+  }
+
+  // Shifts the arrays past the row back by one entry
+  void Graph::_eraseArc(int i, int j) noexcept
+  {
+    auto position = std::lower_bound(_neighbours.begin() + _offsets[i], _neighbours.begin() + _offsets[i + 1], j);
+    _weights.erase(_weights.begin() + (position - _neighbours.begin()));
+    _neighbours.erase(position);
+    for (std::size_t k = i + 1; k < _offsets.size(); ++k)
+    {
+      _offsets[k]--;
+    }
+  }
+
+  // Routing table columns, landmark distances, cluster links and distance fields are patched where the edge
+  // changes routes. The contraction hierarchy is dropped, the automatic engine falls back to ALT meanwhile
+  void Graph::_repairEdge(int i, int j) noexcept
+  {
+    const std::uint64_t epoch = _epoch++; // Cached routes belong to the previous epoch
+    if (_uniform_weights)
+    {
+      _repairCopy(_routing_table, [this, i, j](RoutingTable &table)
+                  { table.repairEdge(*this, i, j); });
+    }
+    else
+    {
+      _routing_table.reset(); // The table ranks routes by hops
+    }
+    _contraction_hierarchy.reset();
+    if (isEdge(i, j))
+    {
+      _repairCopy(_landmarks, [this, i, j](Landmarks &landmarks)
+                  { landmarks.repairEdge(*this, i, j); });
+    }
+    _repairCopy(_hierarchy, [i, j](HierarchicalGraph &hierarchy)
+                { hierarchy.repairEdge(i, j); });
+
+    std::lock_guard<std::mutex> lock(_distance_fields_mutex);
+    for (auto &field : _distance_fields)
+    {
+      if (field && field->getEpoch() == epoch)
+      {
+        _repairCopy(field, [this, i, j](DistanceField &copy)
+                    { copy.repairEdge(*this, i, j); });
+      }
+    }
+  }
+
+  // Lattice links only describe uniform lattices, an edge that breaks the pattern drops them
+  void Graph::_updateLatticeLinks(int i, int j, bool linked) noexcept
+  {
+    if (_lattice_links.empty())
+    {
+      return;
+    }
+    const int direction = _getLatticeDirection(_xs[j] - _xs[i], _ys[j] - _ys[i]);
+    if (direction == -1 || !_uniform_weights)
+    {
+      _lattice_links.clear();
+      _lattice_links.shrink_to_fit();
+      return;
+    }
+    _lattice_links[i * 4 + direction] = linked ? j : -1;
+    _lattice_links[j * 4 + (direction + 2) % 4] = linked ? i : -1;
+  }
+} // namespace graph
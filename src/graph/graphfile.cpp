@@ -0,0 +1,322 @@
+#include "graphfile.hpp"
+#include "contractionhierarchy.hpp"
+#include "graph.hpp"
+#include "landmarks.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace graph
+{
+    static_assert(sizeof(int) == sizeof(std::int32_t), "Graph files store the int arrays as they are");
+
+    // Opens the file and writes a blank header, filled in by finish()
+    GraphFileWriter::GraphFileWriter(const std::string &path) noexcept
+        : _out(path, std::ios::binary | std::ios::trunc)
+    {
+        _out.write(reinterpret_cast<const char *>(&_header), sizeof(_header));
+    }
+
+    // Pads up to the next aligned offset, then copies the values
+    void GraphFileWriter::write(GraphSection section, std::span<const std::int32_t> values) noexcept
+    {
+        const auto position = static_cast<std::uint64_t>(_out.tellp());
+        const std::uint64_t padding = (GRAPH_FILE_ALIGNMENT - position % GRAPH_FILE_ALIGNMENT) % GRAPH_FILE_ALIGNMENT;
+        static const char zeros[GRAPH_FILE_ALIGNMENT] = {};
+        _out.write(zeros, static_cast<std::streamsize>(padding));
+
+        _current = section;
+        _header.offsets[static_cast<int>(section)] = position + padding;
+        _header.sizes[static_cast<int>(section)] = values.size();
+        _out.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(values.size_bytes()));
+    }
+
+    // The values of the section written last follow each other without padding
+    void GraphFileWriter::append(GraphSection section, std::span<const std::int32_t> values) noexcept
+    {
+        if (section != _current)
+        {
+            write(section, values);
+            return;
+        }
+        _header.sizes[static_cast<int>(section)] += values.size();
+        _out.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(values.size_bytes()));
+    }
+
+    // Returns the header written by finish()
+    GraphFileHeader &GraphFileWriter::getHeader() noexcept
+    {
+        return _header;
+    }
+
+    // Rewrites the header now that every section has its place
+    bool GraphFileWriter::finish() noexcept
+    {
+        _out.seekp(0);
+        _out.write(reinterpret_cast<const char *>(&_header), sizeof(_header));
+        _out.close();
+        return !_out.fail();
+    }
+
+    // Maps the whole file read-only, pages are faulted in up front where the system allows it and populate is set
+    GraphFileReader::GraphFileReader(const std::string &path, bool populate) noexcept
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            return;
+        }
+        struct stat status;
+        if (::fstat(fd, &status) == 0 && static_cast<std::size_t>(status.st_size) >= sizeof(GraphFileHeader))
+        {
+            int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+            flags |= populate ? MAP_POPULATE : 0;
+#endif
+            void *data = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, flags, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                _data = static_cast<const std::byte *>(data);
+                _size = static_cast<std::size_t>(status.st_size);
+                if (!populate)
+                {
+                    ::madvise(data, _size, MADV_SEQUENTIAL); // Sections are scanned front to back, read ahead
+                }
+            }
+        }
+        ::close(fd); // The mapping stays valid without the descriptor
+        if (!_data)
+        {
+            return;
+        }
+
+        // Every section must lie inside the file and be aligned for 64-bit keys
+        const GraphFileHeader &header = getHeader();
+        _valid = header.magic == GRAPH_FILE_MAGIC && header.version == GRAPH_FILE_VERSION;
+        for (int s = 0; _valid && s < static_cast<int>(GraphSection::num_sections); ++s)
+        {
+            const std::uint64_t offset = header.offsets[s];
+            const std::uint64_t size = header.sizes[s];
+            _valid = offset % alignof(std::uint64_t) == 0 && offset <= _size && size <= (_size - offset) / sizeof(std::int32_t);
+        }
+    }
+
+    // Unmaps the file
+    GraphFileReader::~GraphFileReader()
+    {
+        if (_data)
+        {
+            ::munmap(const_cast<std::byte *>(_data), _size);
+        }
+    }
+
+    // Tells whether the file can be read
+    bool GraphFileReader::isValid() const noexcept
+    {
+        return _valid;
+    }
+
+    // The header sits at the start of the mapping
+    const GraphFileHeader &GraphFileReader::getHeader() const noexcept
+    {
+        return *reinterpret_cast<const GraphFileHeader *>(_data);
+    }
+
+    // Views a section in the mapping (empty if the file is invalid)
+    std::span<const std::int32_t> GraphFileReader::getSection(GraphSection section) const noexcept
+    {
+        if (!_valid)
+        {
+            return {};
+        }
+        const GraphFileHeader &header = getHeader();
+        return {reinterpret_cast<const std::int32_t *>(_data + header.offsets[static_cast<int>(section)]),
+                static_cast<std::size_t>(header.sizes[static_cast<int>(section)])};
+    }
+
+    // Writes the node arrays, the CSR store and the property lists, then the optional indexes
+    bool Graph::saveToFile(const std::string &path) const noexcept
+    {
+        if (!_pending_edges.empty() || _offsets.size() != _ids.size() + 1)
+        {
+            return false; // Only frozen graphs are written
+        }
+
+        GraphFileWriter writer(path);
+        writer.getHeader().flags = _uniform_weights ? GRAPH_FILE_UNIFORM_WEIGHTS : 0;
+        writer.getHeader().min_weight_per_length = _min_weight_per_length;
+
+        std::vector<int> props(_props.size());
+        for (std::size_t i = 0; i < _props.size(); ++i)
+        {
+            props[i] = static_cast<int>(_props[i]);
+        }
+        std::vector<int> property_offsets(NUM_PROPERTIES + 1, 0);
+        std::vector<int> property_nodes;
+        property_nodes.reserve(_ids.size());
+        for (int p = 0; p < NUM_PROPERTIES; ++p)
+        {
+            property_nodes.insert(property_nodes.end(), _property_nodes[p].begin(), _property_nodes[p].end());
+            property_offsets[p + 1] = static_cast<int>(property_nodes.size());
+        }
+
+        writer.write(GraphSection::ids, _ids);
+        writer.write(GraphSection::xs, _xs);
+        writer.write(GraphSection::ys, _ys);
+        writer.write(GraphSection::props, props);
+        writer.write(GraphSection::offsets, _offsets);
+        writer.write(GraphSection::neighbours, _neighbours);
+        writer.write(GraphSection::weights, _weights);
+        writer.write(GraphSection::lattice_links, _lattice_links);
+        writer.write(GraphSection::property_offsets, property_offsets);
+        writer.write(GraphSection::property_nodes, property_nodes);
+        auto writeIndex = [&writer](GraphSection keys, GraphSection values, const FlatIndex &index)
+        {
+            writer.write(keys, {reinterpret_cast<const std::int32_t *>(index.getKeys().data()), index.getKeys().size() * 2});
+            writer.write(values, index.getValues());
+        };
+        writeIndex(GraphSection::spatial_keys, GraphSection::spatial_values, _node_index);
+        writeIndex(GraphSection::id_keys, GraphSection::id_values, _id_index);
+        if (_contraction_hierarchy)
+        {
+            _contraction_hierarchy->saveToFile(writer);
+        }
+        if (_landmarks)
+        {
+            _landmarks->saveToFile(writer);
+        }
+        return writer.finish();
+    }
+
+    // The sections are checked against each other, then copied in bulk into the node and CSR arrays
+    bool Graph::loadFromFile(const std::string &path) noexcept
+    {
+        clear();
+        GraphFileReader reader(path);
+        if (!reader.isValid())
+        {
+            return false;
+        }
+
+        auto ids = reader.getSection(GraphSection::ids);
+        auto xs = reader.getSection(GraphSection::xs);
+        auto ys = reader.getSection(GraphSection::ys);
+        auto props = reader.getSection(GraphSection::props);
+        auto offsets = reader.getSection(GraphSection::offsets);
+        auto neighbours = reader.getSection(GraphSection::neighbours);
+        auto weights = reader.getSection(GraphSection::weights);
+        auto lattice_links = reader.getSection(GraphSection::lattice_links);
+        auto property_offsets = reader.getSection(GraphSection::property_offsets);
+        auto property_nodes = reader.getSection(GraphSection::property_nodes);
+
+        // A corrupted file must never lead to an access outside the arrays
+        const std::size_t num_nodes = ids.size();
+        bool valid = num_nodes < static_cast<std::size_t>(std::numeric_limits<int>::max()) && xs.size() == num_nodes &&
+                     ys.size() == num_nodes && props.size() == num_nodes && offsets.size() == num_nodes + 1 &&
+                     offsets[0] == 0 && static_cast<std::size_t>(offsets[num_nodes]) == neighbours.size() &&
+                     weights.size() == neighbours.size() && (lattice_links.empty() || lattice_links.size() == num_nodes * 4) &&
+                     property_offsets.size() == NUM_PROPERTIES + 1 && property_nodes.size() == num_nodes &&
+                     property_offsets[0] == 0 && static_cast<std::size_t>(property_offsets[NUM_PROPERTIES]) == num_nodes;
+        const int n = static_cast<int>(num_nodes);
+        for (std::size_t i = 0; valid && i < num_nodes; ++i)
+        {
+            valid = offsets[i] <= offsets[i + 1] && props[i] >= 0 && props[i] < NUM_PROPERTIES;
+        }
+        // Rows are sorted without duplicates or self loops and every arc has its reverse with the same travel time:
+        // isEdge binary-searches the rows and the edits patch both directions in place
+        for (int i = 0; valid && i < n; ++i)
+        {
+            for (int k = offsets[i]; valid && k < offsets[i + 1]; ++k)
+            {
+                valid = neighbours[k] >= 0 && neighbours[k] < n && neighbours[k] != i && weights[k] > 0 &&
+                        (k == offsets[i] || neighbours[k - 1] < neighbours[k]);
+            }
+        }
+        for (int i = 0; valid && i < n; ++i)
+        {
+            for (int k = offsets[i]; valid && k < offsets[i + 1]; ++k)
+            {
+                const int j = neighbours[k];
+                auto reverse = std::lower_bound(neighbours.begin() + offsets[j], neighbours.begin() + offsets[j + 1], i);
+                valid = reverse != neighbours.begin() + offsets[j + 1] && *reverse == i &&
+                        weights[reverse - neighbours.begin()] == weights[k];
+            }
+        }
+        for (std::size_t k = 0; valid && k < lattice_links.size(); ++k)
+        {
+            valid = lattice_links[k] >= -1 && lattice_links[k] < n;
+        }
+        std::vector<char> listed(num_nodes, 0); // Each node in exactly one property list
+        for (int p = 0; valid && p < NUM_PROPERTIES; ++p)
+        {
+            valid = property_offsets[p] <= property_offsets[p + 1];
+            for (int k = property_offsets[p]; valid && k < property_offsets[p + 1]; ++k)
+            {
+                valid = property_nodes[k] >= 0 && property_nodes[k] < n && props[property_nodes[k]] == p &&
+                        !listed[property_nodes[k]]++;
+            }
+        }
+        if (!valid)
+        {
+            return false;
+        }
+
+        _ids.assign(ids.begin(), ids.end());
+        _xs.assign(xs.begin(), xs.end());
+        _ys.assign(ys.begin(), ys.end());
+        _props.resize(num_nodes);
+        for (std::size_t i = 0; i < num_nodes; ++i)
+        {
+            _props[i] = static_cast<Property>(props[i]);
+        }
+        _property_slots.resize(num_nodes);
+        for (int p = 0; p < NUM_PROPERTIES; ++p)
+        {
+            _property_nodes[p].assign(property_nodes.begin() + property_offsets[p], property_nodes.begin() + property_offsets[p + 1]);
+            for (std::size_t slot = 0; slot < _property_nodes[p].size(); ++slot)
+            {
+                _property_slots[_property_nodes[p][slot]] = static_cast<int>(slot);
+            }
+        }
+        _offsets.assign(offsets.begin(), offsets.end());
+        _neighbours.assign(neighbours.begin(), neighbours.end());
+        _weights.assign(weights.begin(), weights.end());
+        _lattice_links.assign(lattice_links.begin(), lattice_links.end());
+        _uniform_weights = reader.getHeader().flags & GRAPH_FILE_UNIFORM_WEIGHTS;
+        _min_weight_per_length = reader.getHeader().min_weight_per_length;
+
+        // The lookup tables are copied slot by slot, their hashes only depend on the number of slots. Streamed
+        // files leave them out, they are then built from the node arrays
+        auto readIndex = [&reader, n](GraphSection keys, GraphSection values, FlatIndex &index)
+        {
+            auto key_values = reader.getSection(keys);
+            return key_values.size() % 2 == 0 &&
+                   index.assign({reinterpret_cast<const std::uint64_t *>(key_values.data()), key_values.size() / 2},
+                                reader.getSection(values), n) &&
+                   index.size() == static_cast<std::size_t>(n);
+        };
+        const bool indexed = !reader.getSection(GraphSection::spatial_values).empty() ||
+                             !reader.getSection(GraphSection::id_values).empty() || num_nodes == 0;
+        if (!indexed)
+        {
+            _indexNodes();
+        }
+        if (indexed ? !readIndex(GraphSection::spatial_keys, GraphSection::spatial_values, _node_index) ||
+                          !readIndex(GraphSection::id_keys, GraphSection::id_values, _id_index)
+                    : _node_index.size() != num_nodes || _id_index.size() != num_nodes) // Duplicated cells or identifiers
+        {
+            clear();
+            return false;
+        }
+
+        _dropPrecomputed();
+        setAdjacencyBackend(_backend); // Builds the bit rows, or falls back to CSR if the graph is too large
+        _contraction_hierarchy = ContractionHierarchy::loadFromFile(reader, n);
+        _landmarks = Landmarks::loadFromFile(reader, n);
+        return true;
+    }
+} // namespace graph
@@ -0,0 +1,29 @@
+#include "graphstore.hpp"
+
+namespace graph
+{
+    // Publishes an empty graph
+    GraphStore::GraphStore() noexcept
+        : _current(std::make_shared<const Graph>())
+    {
+    }
+
+    // Loads the current snapshot, the shared pointer keeps it alive
+    std::shared_ptr<const Graph> GraphStore::load() const noexcept
+    {
+        return _current.load(std::memory_order_acquire);
+    }
+
+    // Swaps the snapshot in, the previous one goes away with its last reader
+    void GraphStore::publish(std::shared_ptr<const Graph> graph) noexcept
+    {
+        _current.store(std::move(graph), std::memory_order_release);
+        _version.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    // Returns the number of snapshots published
+    std::uint64_t GraphStore::getVersion() const noexcept
+    {
+        return _version.load(std::memory_order_acquire);
+    }
+} // namespace graph
@@ -0,0 +1,440 @@
+#include "hierarchicalgraph.hpp"
+#include "graph.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+
+namespace graph
+{
+    // Clusters are cut from the node coordinates, entrances are linked within each cluster by a
+    // restricted Dijkstra from each of them, and across clusters by the edges of the graph
+    HierarchicalGraph::HierarchicalGraph(const Graph &graph, int cluster_size) noexcept
+        : _graph(&graph)
+    {
+        auto start = std::chrono::steady_clock::now();
+        const int num_nodes = graph.getNumNodes();
+        const int side = std::max(cluster_size, 1) * SCALE;
+
+        // Number the clusters in order of appearance
+        _cluster.resize(num_nodes);
+        std::unordered_map<std::uint64_t, int> cluster_index;
+        for (int v = 0; v < num_nodes; ++v)
+        {
+            auto cx = static_cast<std::int32_t>(std::floor(static_cast<double>(graph.getXs()[v]) / side));
+            auto cy = static_cast<std::int32_t>(std::floor(static_cast<double>(graph.getYs()[v]) / side));
+            std::uint64_t key = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(cx)) << 32) | static_cast<std::uint32_t>(cy);
+            _cluster[v] = cluster_index.try_emplace(key, static_cast<int>(cluster_index.size())).first->second;
+        }
+        const int num_clusters = static_cast<int>(cluster_index.size());
+
+        // Entrances are the nodes with an edge to another cluster, grouped by cluster
+        _entrance_of.assign(num_nodes, -1);
+        for (int v = 0; v < num_nodes; ++v)
+        {
+            for (int u : graph.getNeighbours(v))
+            {
+                if (_cluster[u] != _cluster[v])
+                {
+                    _entrance_of[v] = static_cast<int>(_entrances.size());
+                    _entrances.push_back(v);
+                    break;
+                }
+            }
+        }
+        _cluster_offsets.assign(num_clusters + 1, 0);
+        _groupEntrances();
+
+        // Each entrance gets its inter-cluster edges, then its travel times to the other entrances of its cluster
+        std::vector<std::vector<Link>> links(_entrances.size());
+        std::vector<SearchWorkspace> workspaces(parallelWorkers(num_clusters));
+        parallelFor(num_clusters, [&](int c, int worker)
+                    {
+            for (int k = _cluster_offsets[c]; k < _cluster_offsets[c + 1]; ++k)
+            {
+                _linkEntrance(_cluster_entrances[k], workspaces[worker], links[_cluster_entrances[k]]);
+            } });
+        _packLinks(links);
+
+        _build_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Same arrays, bound to the copy
+    HierarchicalGraph::HierarchicalGraph(const HierarchicalGraph &other, const Graph &graph) noexcept
+        : HierarchicalGraph(other)
+    {
+        _graph = &graph;
+    }
+
+    // The entrances are numbered in node order, so the ones gained or lost at both ends of the edge shift the
+    // numbers of the others: links kept from the untouched clusters are renamed, those of the two clusters are rebuilt
+    void HierarchicalGraph::repairEdge(int node_1, int node_2) noexcept
+    {
+        const std::vector<int> old_entrances = std::move(_entrances);
+        std::vector<std::vector<Link>> links(old_entrances.size());
+        for (std::size_t e = 0; e < old_entrances.size(); ++e)
+        {
+            links[e].assign(_links.begin() + _link_offsets[e], _links.begin() + _link_offsets[e + 1]);
+        }
+
+        // Entrance status of both ends, the other nodes keep theirs
+        std::vector<int> changed;
+        for (int node : {node_1, node_2})
+        {
+            const auto neighbours = _graph->getNeighbours(node);
+            const bool entrance = std::any_of(neighbours.begin(), neighbours.end(), [&](int u)
+                                              { return _cluster[u] != _cluster[node]; });
+            if (entrance != (_entrance_of[node] != -1))
+            {
+                changed.push_back(node);
+            }
+        }
+        std::vector<int> renamed(old_entrances.size(), -1); // New number of each old entrance
+        _entrances.clear();
+        _entrances.reserve(old_entrances.size() + changed.size());
+        std::size_t next_old = 0;
+        auto addEntrance = [&](int node)
+        {
+            _entrance_of[node] = static_cast<int>(_entrances.size());
+            _entrances.push_back(node);
+        };
+        std::sort(changed.begin(), changed.end());
+        for (int node : changed)
+        {
+            for (; next_old < old_entrances.size() && old_entrances[next_old] < node; ++next_old)
+            {
+                renamed[next_old] = static_cast<int>(_entrances.size());
+                addEntrance(old_entrances[next_old]);
+            }
+            if (_entrance_of[node] == -1)
+            {
+                addEntrance(node); // Gained
+            }
+            else
+            {
+                _entrance_of[node] = -1; // Lost
+                ++next_old;
+            }
+        }
+        for (; next_old < old_entrances.size(); ++next_old)
+        {
+            renamed[next_old] = static_cast<int>(_entrances.size());
+            addEntrance(old_entrances[next_old]);
+        }
+        std::fill(_cluster_offsets.begin(), _cluster_offsets.end(), 0);
+        _groupEntrances();
+
+        std::vector<std::vector<Link>> new_links(_entrances.size());
+        for (std::size_t e = 0; e < old_entrances.size(); ++e)
+        {
+            const int cluster = _cluster[old_entrances[e]];
+            if (renamed[e] != -1 && cluster != _cluster[node_1] && cluster != _cluster[node_2])
+            {
+                for (Link link : links[e])
+                {
+                    new_links[renamed[e]].push_back({renamed[link.target], link.weight});
+                }
+            }
+        }
+        thread_local SearchWorkspace workspace;
+        for (int cluster : {_cluster[node_1], _cluster[node_2]})
+        {
+            for (int k = _cluster_offsets[cluster]; k < _cluster_offsets[cluster + 1]; ++k)
+            {
+                const int e = _cluster_entrances[k];
+                new_links[e].clear(); // Both ends may share their cluster
+                _linkEntrance(e, workspace, new_links[e]);
+            }
+        }
+        _packLinks(new_links);
+    }
+
+    // The source and the target are joined to the entrances of their clusters by restricted searches,
+    // then Dijkstra runs over the entrances, the source (index E) and the target (index E + 1)
+    bool HierarchicalGraph::getAbstractPath(int i, int j, std::vector<int> &waypoints) const noexcept
+    {
+        waypoints.clear();
+        const int num_nodes = static_cast<int>(_cluster.size());
+        if (i < 0 || j < 0 || i >= num_nodes || j >= num_nodes)
+        {
+            return false;
+        }
+        if (i == j)
+        {
+            waypoints.push_back(i);
+            return true;
+        }
+
+        const int num_entrances = static_cast<int>(_entrances.size());
+        const int source = num_entrances;
+        const int target = num_entrances + 1;
+
+        // Travel times from the source to the entrances of its cluster, and to the target if it shares it
+        thread_local SearchWorkspace local;
+        thread_local std::vector<Link> source_links;
+        thread_local std::vector<Link> target_links; // Entrances linked to the target, with their travel time to it
+        source_links.clear();
+        target_links.clear();
+        _searchCluster(i, -1, local);
+        for (int k = _cluster_offsets[_cluster[i]]; k < _cluster_offsets[_cluster[i] + 1]; ++k)
+        {
+            const int e = _cluster_entrances[k];
+            if (local.isVisited(_entrances[e]))
+            {
+                source_links.push_back({e, local.getCost(_entrances[e])});
+            }
+        }
+        if (_cluster[i] == _cluster[j] && local.isVisited(j))
+        {
+            source_links.push_back({target, local.getCost(j)});
+        }
+        _searchCluster(j, -1, local);
+        for (int k = _cluster_offsets[_cluster[j]]; k < _cluster_offsets[_cluster[j] + 1]; ++k)
+        {
+            const int e = _cluster_entrances[k];
+            if (local.isVisited(_entrances[e]))
+            {
+                target_links.push_back({e, local.getCost(_entrances[e])});
+            }
+        }
+
+        // Dijkstra over the abstract graph
+        thread_local SearchWorkspace workspace;
+        workspace.begin(num_entrances + 2);
+        IndexedHeap &heap = workspace.getHeap();
+        workspace.visit(source, -1);
+        workspace.setCost(source, 0);
+        heap.push(source, 0);
+
+        auto relax = [&](int from, int to, int weight)
+        {
+            const int cost = workspace.getCost(from) + weight;
+            if (!workspace.isVisited(to) || cost < workspace.getCost(to))
+            {
+                workspace.visit(to, from);
+                workspace.setCost(to, cost);
+                heap.push(to, static_cast<std::uint64_t>(cost));
+            }
+        };
+
+        while (!heap.empty())
+        {
+            const int node = heap.pop();
+            workspace.countExpanded();
+            if (node == target)
+            {
+                break;
+            }
+            if (node == source)
+            {
+                for (const Link &link : source_links)
+                {
+                    relax(node, link.target, link.weight);
+                }
+                continue;
+            }
+            for (int k = _link_offsets[node]; k < _link_offsets[node + 1]; ++k)
+            {
+                relax(node, _links[k].target, _links[k].weight);
+            }
+            if (_cluster[_entrances[node]] == _cluster[j])
+            {
+                for (const Link &link : target_links)
+                {
+                    if (link.target == node)
+                    {
+                        relax(node, target, link.weight);
+                    }
+                }
+            }
+        }
+
+        if (!workspace.isVisited(target))
+        {
+            return false;
+        }
+        for (int node = target; node != -1; node = workspace.getPred(node))
+        {
+            waypoints.push_back(node == source ? i : node == target ? j : _entrances[node]);
+        }
+        std::reverse(waypoints.begin(), waypoints.end());
+        return true;
+    }
+
+    // Consecutive waypoints are either joined by an edge between clusters or lie in the same cluster
+    bool HierarchicalGraph::refineSegment(int from, int to, std::vector<int> &path) const noexcept
+    {
+        if (from == to)
+        {
+            return true;
+        }
+        if (_cluster[from] != _cluster[to])
+        {
+            if (_graph->isEdge(from, to) != 1)
+            {
+                return false;
+            }
+            path.push_back(to);
+            return true;
+        }
+
+        thread_local SearchWorkspace workspace;
+        _searchCluster(from, to, workspace);
+        if (!workspace.isVisited(to))
+        {
+            return false;
+        }
+        const std::size_t begin = path.size();
+        for (int node = to; node != from; node = workspace.getPred(node))
+        {
+            path.push_back(node);
+        }
+        std::reverse(path.begin() + begin, path.end());
+        return true;
+    }
+
+    // Refines every segment of the abstract route
+    bool HierarchicalGraph::getPath(int i, int j, std::vector<int> &path) const noexcept
+    {
+        thread_local std::vector<int> waypoints;
+        path.clear();
+        if (!getAbstractPath(i, j, waypoints))
+        {
+            return false;
+        }
+        path.push_back(i);
+        for (std::size_t k = 1; k < waypoints.size(); ++k)
+        {
+            if (!refineSegment(waypoints[k - 1], waypoints[k], path))
+            {
+                path.clear();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Edges leaving the cluster link to the entrance at their other end, searches within the cluster to the others
+    void HierarchicalGraph::_linkEntrance(int e, SearchWorkspace &workspace, std::vector<Link> &links) const noexcept
+    {
+        const int v = _entrances[e];
+        const int c = _cluster[v];
+        auto neighbours = _graph->getNeighbours(v);
+        auto weights = _graph->getEdgeWeights(v);
+        for (std::size_t n = 0; n < neighbours.size(); ++n)
+        {
+            if (_cluster[neighbours[n]] != c)
+            {
+                links.push_back({_entrance_of[neighbours[n]], weights[n]});
+            }
+        }
+
+        _searchCluster(v, -1, workspace);
+        for (int other = _cluster_offsets[c]; other < _cluster_offsets[c + 1]; ++other)
+        {
+            const int f = _cluster_entrances[other];
+            if (f != e && workspace.isVisited(_entrances[f]))
+            {
+                links.push_back({f, workspace.getCost(_entrances[f])});
+            }
+        }
+    }
+
+    // Concatenates the rows
+    void HierarchicalGraph::_packLinks(const std::vector<std::vector<Link>> &links) noexcept
+    {
+        _link_offsets.assign(_entrances.size() + 1, 0);
+        for (std::size_t e = 0; e < _entrances.size(); ++e)
+        {
+            _link_offsets[e + 1] = _link_offsets[e] + static_cast<int>(links[e].size());
+        }
+        _links.clear();
+        _links.reserve(_link_offsets.back());
+        for (const auto &row : links)
+        {
+            _links.insert(_links.end(), row.begin(), row.end());
+        }
+    }
+
+    // Counting sort of the entrances by cluster, _cluster_offsets comes in zeroed
+    void HierarchicalGraph::_groupEntrances() noexcept
+    {
+        const int num_clusters = static_cast<int>(_cluster_offsets.size()) - 1;
+        for (int v : _entrances)
+        {
+            _cluster_offsets[_cluster[v] + 1]++;
+        }
+        for (int c = 0; c < num_clusters; ++c)
+        {
+            _cluster_offsets[c + 1] += _cluster_offsets[c];
+        }
+        _cluster_entrances.resize(_entrances.size());
+        std::vector<int> cursor(_cluster_offsets.begin(), _cluster_offsets.end() - 1);
+        for (std::size_t e = 0; e < _entrances.size(); ++e)
+        {
+            _cluster_entrances[cursor[_cluster[_entrances[e]]]++] = static_cast<int>(e);
+        }
+    }
+
+    // Returns the cluster of a node
+    int HierarchicalGraph::getCluster(int node) const noexcept
+    {
+        return _cluster[node];
+    }
+
+    // Getters for the preprocessing statistics
+    int HierarchicalGraph::getNumClusters() const noexcept { return static_cast<int>(_cluster_offsets.size()) - 1; }
+    int HierarchicalGraph::getNumEntrances() const noexcept { return static_cast<int>(_entrances.size()); }
+    double HierarchicalGraph::getBuildTime() const noexcept { return _build_time; }
+
+    // Sums the capacity of the arrays
+    std::size_t HierarchicalGraph::getMemoryUsage() const noexcept
+    {
+        return (_cluster.capacity() + _entrance_of.capacity() + _entrances.capacity() + _cluster_offsets.capacity() +
+                _cluster_entrances.capacity() + _link_offsets.capacity()) *
+                   sizeof(int) +
+               _links.capacity() * sizeof(Link);
+    }
+
+    // Dijkstra on the radix heap, neighbours in other clusters are skipped
+    void HierarchicalGraph::_searchCluster(int source, int target, SearchWorkspace &workspace) const noexcept
+    {
+        workspace.begin(static_cast<int>(_cluster.size()));
+        RadixHeap &heap = workspace.getRadixHeap();
+        const int cluster = _cluster[source];
+        workspace.visit(source, -1);
+        workspace.setCost(source, 0);
+        heap.push(source, 0);
+
+        while (!heap.empty())
+        {
+            std::uint32_t key;
+            int node = heap.pop(key);
+            if (static_cast<int>(key) > workspace.getCost(node))
+            {
+                continue; // Stale entry
+            }
+            if (node == target)
+            {
+                return;
+            }
+
+            auto neighbours = _graph->getNeighbours(node);
+            auto weights = _graph->getEdgeWeights(node);
+            for (std::size_t k = 0; k < neighbours.size(); ++k)
+            {
+                const int next = neighbours[k];
+                const int cost = static_cast<int>(key) + weights[k];
+                if (_cluster[next] == cluster && (!workspace.isVisited(next) || cost < workspace.getCost(next)))
+                {
+                    workspace.visit(next, node);
+                    workspace.setCost(next, cost);
+                    heap.push(next, static_cast<std::uint32_t>(cost));
+                }
+            }
+        }
+    }
+} // namespace graph
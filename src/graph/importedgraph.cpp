@@ -0,0 +1,208 @@
+#include "importedgraph.hpp"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+namespace graph
+{
+    // Splits the next comma separated field off line
+    static std::string_view _nextField(std::string_view &line) noexcept
+    {
+        const std::size_t comma = line.find(',');
+        std::string_view field = line.substr(0, comma);
+        line.remove_prefix(comma == std::string_view::npos ? line.size() : comma + 1);
+        return field;
+    }
+
+    // Parses a whole field as an integer
+    static bool _parseInt(std::string_view field, int &value) noexcept
+    {
+        auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value);
+        return error == std::errc() && end == field.data() + field.size();
+    }
+
+    // Streams the file, grid maps get room reserved from the file size
+    bool ImportedGraph::importFile(const std::string &path) noexcept
+    {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+        {
+            clear();
+            _error_line = -1;
+            return false;
+        }
+        const auto bytes = static_cast<std::size_t>(in.tellg());
+        in.seekg(0);
+        if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0)
+        {
+            return importCsv(in);
+        }
+        return importGrid(in, bytes);
+    }
+
+    // Each cell is linked to the cell on its left and to the cell above, kept from the previous row
+    bool ImportedGraph::importGrid(std::istream &in, std::size_t expected_cells) noexcept
+    {
+        clear();
+        _error_line = 0;
+        if (expected_cells > 0)
+        {
+            const auto cells = static_cast<int>(std::min<std::size_t>(expected_cells, std::numeric_limits<int>::max() / 2));
+            _reserve(cells, cells * 2);
+        }
+
+        std::string line;
+        std::vector<int> row_above; // Node index of each cell of the previous row, -1 for walls
+        int y = 0;
+        for (; std::getline(in, line); ++y)
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (row_above.size() < line.size())
+            {
+                row_above.resize(line.size(), -1);
+            }
+
+            int left = -1;
+            for (std::size_t x = 0; x < row_above.size(); ++x)
+            {
+                const char cell = x < line.size() ? line[x] : MAP_CELL_WALL;
+                Property prop;
+                switch (cell)
+                {
+                case MAP_CELL_NODE:
+                    prop = Property::node;
+                    break;
+                case MAP_CELL_PICKDROP:
+                    prop = Property::pickdrop;
+                    break;
+                case MAP_CELL_WAITING:
+                    prop = Property::waiting;
+                    break;
+                case MAP_CELL_CHARGING:
+                    prop = Property::charging;
+                    break;
+                case MAP_CELL_WALL:
+                case ' ':
+                    left = -1;
+                    row_above[x] = -1;
+                    continue;
+                default:
+                    return _fail(y + 1);
+                }
+
+                const int node = getNumNodes();
+                _addNode(node, static_cast<int>(x) * SCALE, y * SCALE, prop, false);
+                if (left != -1)
+                {
+                    _addEdge(left, node);
+                }
+                if (row_above[x] != -1)
+                {
+                    _addEdge(row_above[x], node);
+                }
+                left = node;
+                row_above[x] = node;
+            }
+        }
+        if (in.bad())
+        {
+            return _fail(y + 1);
+        }
+
+        _finish();
+        return true;
+    }
+
+    // Nodes are looked up by identifier when their edges come
+    bool ImportedGraph::importCsv(std::istream &in) noexcept
+    {
+        clear();
+        _error_line = 0;
+
+        std::string buffer;
+        int line_number = 0;
+        while (std::getline(in, buffer))
+        {
+            ++line_number;
+            std::string_view line(buffer);
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
+            if (line.empty() || line.front() == '#')
+            {
+                continue;
+            }
+
+            std::string_view kind = _nextField(line);
+            if (kind == "node")
+            {
+                int id, x, y;
+                Property prop;
+                if (!_parseInt(_nextField(line), id) || !_parseInt(_nextField(line), x) || !_parseInt(_nextField(line), y) ||
+                    !getPropertyFromName(_nextField(line), prop) || !line.empty() || getNodeIndex(id) != -1 ||
+                    getNodeAt(x, y) != -1) // A second node on a cell could never be found by its coordinates
+                {
+                    return _fail(line_number);
+                }
+                _addNode(id, x, y, prop);
+            }
+            else if (kind == "edge")
+            {
+                int id_1, id_2;
+                int weight = -1;
+                if (!_parseInt(_nextField(line), id_1) || !_parseInt(_nextField(line), id_2) ||
+                    (!line.empty() && (!_parseInt(_nextField(line), weight) || weight <= 0 || !line.empty())))
+                {
+                    return _fail(line_number);
+                }
+                const int node_1 = getNodeIndex(id_1);
+                const int node_2 = getNodeIndex(id_2);
+                if (node_1 == -1 || node_2 == -1)
+                {
+                    return _fail(line_number);
+                }
+                _addEdge(node_1, node_2, weight);
+            }
+            else
+            {
+                return _fail(line_number);
+            }
+        }
+        if (in.bad())
+        {
+            return _fail(line_number + 1);
+        }
+
+        _finish();
+        return true;
+    }
+
+    // Returns the line of the last failure
+    int ImportedGraph::getErrorLine() const noexcept
+    {
+        return _error_line;
+    }
+
+    // Distance fields are left to be built on their first use, they would double the import time of large maps
+    void ImportedGraph::_finish() noexcept
+    {
+        _freeze();       // Pack the imported edges into the CSR store
+        renumberNodes(); // Rows of a wide map are far apart, lay the nodes out along a Hilbert curve
+        _indexNodes();   // Grid cells are added unindexed, CSV nodes are indexed again in their new order
+    }
+
+    // Drops what was imported so far
+    bool ImportedGraph::_fail(int line) noexcept
+    {
+        clear();
+        _error_line = line;
+        return false;
+    }
+} // namespace graph
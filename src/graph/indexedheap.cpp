@@ -0,0 +1,103 @@
+#include "indexedheap.hpp"
+
+namespace graph
+{
+    // Grows the position array, new nodes are not queued
+    void IndexedHeap::reserve(int num_items) noexcept
+    {
+        if (_positions.size() < static_cast<std::size_t>(num_items))
+        {
+            _positions.resize(num_items, -1);
+        }
+    }
+
+    // Resets the positions of the queued nodes and empties the heap
+    void IndexedHeap::clear() noexcept
+    {
+        for (const Entry &entry : _heap)
+        {
+            _positions[entry.item] = -1;
+        }
+        _heap.clear();
+    }
+
+    // Inserts a node or decreases its key
+    void IndexedHeap::push(int item, std::uint64_t key) noexcept
+    {
+        int slot = _positions[item];
+        if (slot == -1)
+        {
+            _heap.push_back({key, item});
+            _positions[item] = static_cast<int>(_heap.size() - 1);
+            _siftUp(_heap.size() - 1);
+        }
+        else if (key < _heap[slot].key)
+        {
+            _heap[slot].key = key;
+            _siftUp(slot);
+        }
+    }
+
+    // Pops the node with the smallest key
+    int IndexedHeap::pop() noexcept
+    {
+        int item = _heap.front().item;
+        _positions[item] = -1;
+
+        _heap.front() = _heap.back();
+        _heap.pop_back();
+        if (!_heap.empty())
+        {
+            _positions[_heap.front().item] = 0;
+            _siftDown(0);
+        }
+        return item;
+    }
+
+    // Moves an entry up until its parent has a smaller key
+    void IndexedHeap::_siftUp(std::size_t slot) noexcept
+    {
+        Entry entry = _heap[slot];
+        while (slot > 0)
+        {
+            std::size_t parent = (slot - 1) / 2;
+            if (_heap[parent].key <= entry.key)
+            {
+                break;
+            }
+            _heap[slot] = _heap[parent];
+            _positions[_heap[slot].item] = static_cast<int>(slot);
+            slot = parent;
+        }
+        _heap[slot] = entry;
+        _positions[entry.item] = static_cast<int>(slot);
+    }
+
+    // Moves an entry down until both children have larger keys
+    void IndexedHeap::_siftDown(std::size_t slot) noexcept
+    {
+        Entry entry = _heap[slot];
+        const std::size_t size = _heap.size();
+        while (true)
+        {
+            std::size_t child = 2 * slot + 1;
+            if (child >= size)
+            {
+                break;
+            }
+            if (child + 1 < size && _heap[child + 1].key < _heap[child].key)
+            {
+                ++child;
+            }
+            if (entry.key <= _heap[child].key)
+            {
+                break;
+            }
+            _heap[slot] = _heap[child];
+            _positions[_heap[slot].item] = static_cast<int>(slot);
+            slot = child;
+        }
+        _heap[slot] = entry;
+        _positions[entry.item] = static_cast<int>(slot);
+    }
+} // namespace graph
@@ -0,0 +1,214 @@
+#include "landmarks.hpp"
+#include "graph.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace graph
+{
+    // Landmarks far out in every direction bound routes best, so the map is split into angular
+    // sectors around its centre and the node farthest from the centre is taken in each one
+    Landmarks::Landmarks(const Graph &graph, int num_landmarks) noexcept
+        : _num_landmarks(0)
+    {
+        const int num_nodes = graph.getNumNodes();
+        if (num_nodes == 0 || num_landmarks <= 0)
+        {
+            return;
+        }
+
+        auto xs = graph.getXs();
+        auto ys = graph.getYs();
+        double center_x = 0.0;
+        double center_y = 0.0;
+        for (int v = 0; v < num_nodes; ++v)
+        {
+            center_x += xs[v];
+            center_y += ys[v];
+        }
+        center_x /= num_nodes;
+        center_y /= num_nodes;
+
+        std::vector<int> farthest(num_landmarks, -1);
+        std::vector<double> farthest_distance(num_landmarks, -1.0);
+        for (int v = 0; v < num_nodes; ++v)
+        {
+            double dx = xs[v] - center_x;
+            double dy = ys[v] - center_y;
+            double angle = std::atan2(dy, dx) + M_PI; // [0, 2 pi]
+            int sector = std::min(num_landmarks - 1, static_cast<int>(angle / (2.0 * M_PI) * num_landmarks));
+            double distance = dx * dx + dy * dy;
+            if (distance > farthest_distance[sector])
+            {
+                farthest[sector] = v;
+                farthest_distance[sector] = distance;
+            }
+        }
+        for (int v : farthest)
+        {
+            if (v != -1)
+            {
+                _landmarks.push_back(v);
+            }
+        }
+        _num_landmarks = static_cast<int>(_landmarks.size());
+
+        // One Dijkstra per landmark, each writes its own column of the node-major matrix
+        _distances.assign(static_cast<std::size_t>(num_nodes) * _num_landmarks, -1);
+        std::vector<SearchWorkspace> workspaces(parallelWorkers(_num_landmarks));
+        parallelFor(_num_landmarks, [&](int l, int worker)
+                    {
+            SearchWorkspace &workspace = workspaces[worker];
+            RadixHeap &heap = workspace.getRadixHeap();
+            workspace.begin(num_nodes);
+            workspace.visit(_landmarks[l], -1);
+            workspace.setCost(_landmarks[l], 0);
+            heap.push(_landmarks[l], 0);
+
+            while (!heap.empty())
+            {
+                std::uint32_t key;
+                int node = heap.pop(key);
+                if (static_cast<int>(key) > workspace.getCost(node))
+                {
+                    continue; // Stale entry
+                }
+                _distances[static_cast<std::size_t>(node) * _num_landmarks + l] = static_cast<int>(key);
+
+                auto neighbours = graph.getNeighbours(node);
+                auto weights = graph.getEdgeWeights(node);
+                for (std::size_t k = 0; k < neighbours.size(); ++k)
+                {
+                    int cost = static_cast<int>(key) + weights[k];
+                    if (!workspace.isVisited(neighbours[k]) || cost < workspace.getCost(neighbours[k]))
+                    {
+                        workspace.visit(neighbours[k], node);
+                        workspace.setCost(neighbours[k], cost);
+                        heap.push(neighbours[k], static_cast<std::uint32_t>(cost));
+                    }
+                }
+            } });
+    }
+
+    // Dijkstra from the far end of the edge over the nodes it brings closer, one landmark after the other
+    void Landmarks::repairEdge(const Graph &graph, int node_1, int node_2) noexcept
+    {
+        const int weight = graph.getEdgeWeight(node_1, node_2);
+        if (weight < 0)
+        {
+            return;
+        }
+        thread_local SearchWorkspace workspace;
+        for (int l = 0; l < _num_landmarks; ++l)
+        {
+            auto distance = [&](int node) -> int &
+            { return _distances[static_cast<std::size_t>(node) * _num_landmarks + l]; };
+
+            RadixHeap &heap = workspace.getRadixHeap();
+            heap.clear();
+            for (auto [from, to] : {std::pair{node_1, node_2}, std::pair{node_2, node_1}})
+            {
+                if (distance(from) != -1 && (distance(to) == -1 || distance(from) + weight < distance(to)))
+                {
+                    distance(to) = distance(from) + weight;
+                    heap.push(to, static_cast<std::uint32_t>(distance(to)));
+                }
+            }
+            while (!heap.empty())
+            {
+                std::uint32_t key;
+                int node = heap.pop(key);
+                if (static_cast<int>(key) > distance(node))
+                {
+                    continue; // Stale entry
+                }
+                auto neighbours = graph.getNeighbours(node);
+                auto weights = graph.getEdgeWeights(node);
+                for (std::size_t k = 0; k < neighbours.size(); ++k)
+                {
+                    const int cost = static_cast<int>(key) + weights[k];
+                    if (distance(neighbours[k]) == -1 || cost < distance(neighbours[k]))
+                    {
+                        distance(neighbours[k]) = cost;
+                        heap.push(neighbours[k], static_cast<std::uint32_t>(cost));
+                    }
+                }
+            }
+        }
+    }
+
+    // A new row of unreachable markers
+    void Landmarks::repairAddedNode() noexcept
+    {
+        _distances.resize(_distances.size() + _num_landmarks, -1);
+    }
+
+    // Copies the last row over the removed one and renames the landmarks
+    void Landmarks::repairRemovedNode(int node) noexcept
+    {
+        const int last = static_cast<int>(_distances.size() / std::max(_num_landmarks, 1)) - 1;
+        std::copy_n(_distances.begin() + static_cast<std::size_t>(last) * _num_landmarks, _num_landmarks,
+                    _distances.begin() + static_cast<std::size_t>(node) * _num_landmarks);
+        _distances.resize(static_cast<std::size_t>(last) * _num_landmarks);
+        for (int &landmark : _landmarks)
+        {
+            landmark = landmark == node ? -1 : landmark == last ? node : landmark;
+        }
+    }
+
+    // Returns the landmark nodes
+    const std::vector<int> &Landmarks::getLandmarks() const noexcept
+    {
+        return _landmarks;
+    }
+
+    // Reads a distance of the matrix
+    int Landmarks::getDistance(int landmark, int node) const noexcept
+    {
+        if (landmark < 0 || landmark >= _num_landmarks || node < 0 ||
+            static_cast<std::size_t>(node) * _num_landmarks >= _distances.size())
+        {
+            return -1;
+        }
+        return _distances[static_cast<std::size_t>(node) * _num_landmarks + landmark];
+    }
+
+    // Returns the size of the distance matrix
+    std::size_t Landmarks::getMemoryUsage() const noexcept
+    {
+        return (_landmarks.capacity() + _distances.capacity()) * sizeof(int);
+    }
+
+    // Writes the landmarks and their node-major distances
+    void Landmarks::saveToFile(GraphFileWriter &writer) const noexcept
+    {
+        writer.write(GraphSection::landmark_nodes, _landmarks);
+        writer.write(GraphSection::landmark_distances, _distances);
+    }
+
+    // The distances are used as they were stored, only their shape is checked
+    std::shared_ptr<const Landmarks> Landmarks::loadFromFile(const GraphFileReader &reader, int num_nodes) noexcept
+    {
+        auto landmarks = reader.getSection(GraphSection::landmark_nodes);
+        auto distances = reader.getSection(GraphSection::landmark_distances);
+        if (landmarks.empty() || distances.size() != landmarks.size() * static_cast<std::size_t>(num_nodes))
+        {
+            return nullptr;
+        }
+        for (int node : landmarks)
+        {
+            if (node < -1 || node >= num_nodes)
+            {
+                return nullptr;
+            }
+        }
+
+        std::shared_ptr<Landmarks> loaded(new Landmarks());
+        loaded->_num_landmarks = static_cast<int>(landmarks.size());
+        loaded->_landmarks.assign(landmarks.begin(), landmarks.end());
+        loaded->_distances.assign(distances.begin(), distances.end());
+        return loaded;
+    }
+} // namespace graph
@@ -3,6 +3,38 @@
 
 namespace graph
 {
+    // Converts enum Property to its corresponding string representation
+    const char *getPropertyName(Property prop) noexcept
+    {
+        switch (prop)
+        {
+        case Property::node:
+            return "node";
+        case Property::pickdrop:
+            return "pickdrop";
+        case Property::waiting:
+            return "waiting";
+        case Property::charging:
+            return "charging";
+        default:
+            return "unknown"; // This should never happen, added for safety
+        }
+    }
+
+    // Looks the name up among the property names
+    bool getPropertyFromName(std::string_view name, Property &prop) noexcept
+    {
+        for (int p = 0; p < NUM_PROPERTIES; ++p)
+        {
+            if (name == getPropertyName(static_cast<Property>(p)))
+            {
+                prop = static_cast<Property>(p);
+                return true;
+            }
+        }
+        return false;
+    }
+
     // Constructor initializing all member variables
     Node::Node(int id, int x, int y, const Property &prop) noexcept
         : _id(id), _x(x), _y(y), _prop(prop)
@@ -44,26 +76,7 @@ namespace graph
         json << "\"y\": " << _y << ",\n";
         json << "\"p\": ";
 
-        // Convert enum Property to its corresponding string representation
-        switch (_prop)
-        {
-        case Property::node:
-            json << "\"node\"";
-            break;
-        case Property::pickdrop:
-            json << "\"pickdrop\"";
-            break;
-        case Property::waiting:
-            json << "\"waiting\"";
-            break;
-        case Property::charging:
-            json << "\"charging\"";
-            break;
-        default:
-            json << "\"unknown\""; // This should never happen, added for safety
-            break;
-        }
-
+        json << "\"" << getPropertyName(_prop) << "\"";
         json << "\n}";
         return json.str();
     }
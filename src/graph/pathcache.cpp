@@ -0,0 +1,154 @@
+#include "pathcache.hpp"
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
+namespace graph
+{
+    // Constructor splitting the capacity between the shards
+    PathCache::PathCache(std::size_t capacity) noexcept
+        : _shard_capacity(std::max<std::size_t>(1, capacity / PATH_CACHE_SHARDS))
+    {
+    }
+
+    // Looks a route up and marks it as the most recently used of its shard
+    bool PathCache::find(std::uint64_t epoch, int i, int j, int engine, std::vector<int> &path) noexcept
+    {
+        std::uint64_t key;
+        if (!_makeKey(i, j, engine, key))
+        {
+            return false;
+        }
+
+        Shard &shard = _getShard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        _syncEpoch(shard, epoch);
+
+        auto it = shard.index.find(key);
+        if (it == shard.index.end() || shard.epoch != epoch)
+        {
+            _misses++;
+            return false;
+        }
+
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        path.assign(it->second->path.begin(), it->second->path.end());
+        _hits++;
+        return true;
+    }
+
+    // Stores a route, evicting the least recently used one when the shard is full
+    void PathCache::insert(std::uint64_t epoch, int i, int j, int engine, const std::vector<int> &path) noexcept
+    {
+        std::uint64_t key;
+        if (!_makeKey(i, j, engine, key))
+        {
+            return;
+        }
+
+        Shard &shard = _getShard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        _syncEpoch(shard, epoch);
+        if (shard.epoch != epoch)
+        {
+            return; // Computed on a graph that has been replaced since
+        }
+
+        auto it = shard.index.find(key);
+        if (it != shard.index.end())
+        {
+            it->second->path = path;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return;
+        }
+
+        if (shard.lru.size() >= _shard_capacity)
+        {
+            // A full shard recycles its least recently used entry, the list node, the path buffer and the index node
+            // are reused so that a miss does not allocate under the shard mutex
+            auto node = shard.index.extract(shard.lru.back().key);
+            shard.lru.splice(shard.lru.begin(), shard.lru, std::prev(shard.lru.end()));
+            Entry &entry = shard.lru.front();
+            entry.key = key;
+            entry.path.assign(path.begin(), path.end());
+            node.key() = key;
+            shard.index.insert(std::move(node));
+            _evictions++;
+            return;
+        }
+        shard.lru.push_front({key, path});
+        shard.index.emplace(key, shard.lru.begin());
+    }
+
+    // Drops every route of every shard
+    void PathCache::clear() noexcept
+    {
+        for (Shard &shard : _shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.lru.clear();
+            shard.index.clear();
+        }
+    }
+
+    // Getters for the cache statistics
+    std::uint64_t PathCache::getHits() const noexcept { return _hits.load(); }
+    std::uint64_t PathCache::getMisses() const noexcept { return _misses.load(); }
+    std::uint64_t PathCache::getEvictions() const noexcept { return _evictions.load(); }
+    std::size_t PathCache::getCapacity() const noexcept { return _shard_capacity * PATH_CACHE_SHARDS; }
+
+    // Counts the routes held by all shards
+    std::size_t PathCache::getSize() noexcept
+    {
+        std::size_t size = 0;
+        for (Shard &shard : _shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size += shard.lru.size();
+        }
+        return size;
+    }
+
+    // Returns a JSON string with the cache statistics
+    std::string PathCache::getToJson() noexcept
+    {
+        std::ostringstream json;
+        json << "{\n";
+        json << "\"hits\": " << getHits() << ",\n";
+        json << "\"misses\": " << getMisses() << ",\n";
+        json << "\"evictions\": " << getEvictions() << ",\n";
+        json << "\"size\": " << getSize() << ",\n";
+        json << "\"capacity\": " << getCapacity() << "\n";
+        json << "}";
+        return json.str();
+    }
+
+    // Packs 28-bit node indices and an 8-bit engine identifier
+    bool PathCache::_makeKey(int i, int j, int engine, std::uint64_t &key) noexcept
+    {
+        constexpr int max_node = 1 << 28;
+        if (i < 0 || j < 0 || i >= max_node || j >= max_node)
+        {
+            return false;
+        }
+        key = (static_cast<std::uint64_t>(i) << 36) | (static_cast<std::uint64_t>(j) << 8) | static_cast<std::uint8_t>(engine);
+        return true;
+    }
+
+    // Fibonacci hashing spreads neighbouring queries over the shards
+    PathCache::Shard &PathCache::_getShard(std::uint64_t key) noexcept
+    {
+        return _shards[((key * 0x9E3779B97F4A7C15ull) >> 32) % PATH_CACHE_SHARDS];
+    }
+
+    // Drops the routes of an older epoch
+    void PathCache::_syncEpoch(Shard &shard, std::uint64_t epoch) noexcept
+    {
+        if (epoch > shard.epoch)
+        {
+            shard.lru.clear();
+            shard.index.clear();
+            shard.epoch = epoch;
+        }
+    }
+} // namespace graph
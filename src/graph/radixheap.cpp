@@ -0,0 +1,60 @@
+#include "radixheap.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace graph
+{
+    // Empties every bucket, keeping their capacity
+    void RadixHeap::clear() noexcept
+    {
+        for (auto &bucket : _buckets)
+        {
+            bucket.clear();
+        }
+        _last = 0;
+        _size = 0;
+    }
+
+    // Inserts an entry in the bucket of its key
+    void RadixHeap::push(int item, std::uint32_t key) noexcept
+    {
+        _buckets[_getBucket(key)].push_back({key, item});
+        ++_size;
+    }
+
+    // Pops from bucket 0, refilling it from the first non-empty bucket when needed
+    int RadixHeap::pop(std::uint32_t &key) noexcept
+    {
+        if (_buckets[0].empty())
+        {
+            std::size_t b = 1;
+            while (_buckets[b].empty())
+            {
+                ++b;
+            }
+
+            // The smallest key of the bucket becomes the new reference, every entry moves to a lower bucket
+            auto &bucket = _buckets[b];
+            _last = std::min_element(bucket.begin(), bucket.end(), [](const Entry &a, const Entry &c)
+                                     { return a.key < c.key; })
+                        ->key;
+            for (const Entry &entry : bucket)
+            {
+                _buckets[_getBucket(entry.key)].push_back(entry);
+            }
+            bucket.clear();
+        }
+
+        Entry entry = _buckets[0].back();
+        _buckets[0].pop_back();
+        --_size;
+        key = entry.key;
+        return entry.item;
+    }
+
+    // Position of the highest bit differing from the last popped key
+    int RadixHeap::_getBucket(std::uint32_t key) const noexcept
+    {
+        return key == _last ? 0 : 32 - std::countl_zero(key ^ _last);
+    }
+} // namespace graph
@@ -1,27 +1,40 @@
 #include "randomgraph.hpp"
-#include <random>
+#include <bit>
 #include <algorithm>
 #include <iterator>
 
 namespace graph
 {
-    // Constructor: Initializes random seed and clears the graph
-    RandomGraph::RandomGraph() noexcept
-        : Graph()
+    // Constructor: Takes the engine and clears the graph
+    RandomGraph::RandomGraph(Rng rng) noexcept
+        : Graph(), _rng(rng)
     {
-        std::random_device rd;    // Random seed
-        std::mt19937 gen(rd());   // Mersenne Twister engine
-        _id_node = 0;             // Initialize node identifier
-        _current_node = 0;        // Initialize current node
-        _from_direction = -1;     // Initialize direction
-        _clearTestedDirections(); // Clear tested directions
-        clear();                  // Clear the graph
+        _id_node = 0; // Initialize node identifier
+        clear();      // Clear the graph
     }
 
-    // Resets the array that tracks tested directions
-    inline void RandomGraph::_clearTestedDirections() noexcept
+    // Looks the cell up in the occupancy map, the graph indexes are still empty while generating
+    int RandomGraph::_getNodeAt(int x, int y) const noexcept
     {
-        std::fill(_tested_directions.begin(), _tested_directions.end(), false);
+        return _occupancy.find(_coordinatesKey(x, y));
+    }
+
+    // Adds a node to the graph, the occupancy map, the link and tested masks and the leaf candidates
+    void RandomGraph::_createNode(int x, int y, const Property &prop) noexcept
+    {
+        (prop == Property::node ? _normal_leaves : _open_leaves).push_back(_id_node);
+        _occupancy.insert(_coordinatesKey(x, y), _id_node);
+        _addNode(_id_node++, x, y, prop, false);
+        _links.push_back(0);
+        _tested.push_back(0);
+    }
+
+    // Adds the edge to the graph and records it in both link masks
+    void RandomGraph::_connect(int node_1, int node_2, int direction) noexcept
+    {
+        _addEdge(node_1, node_2);
+        _links[node_1] |= 1 << direction;
+        _links[node_2] |= 1 << ((direction + 2) % 4);
     }
 
     // Computes new coordinates based on the current position and direction
@@ -47,134 +60,269 @@ namespace graph
         return {x, y};
     }
 
-    // Generates a random graph with specified node quantities
-    void RandomGraph::genRandomGraph(int num_node, int num_waiting, int num_charging, int num_pickdrop) noexcept
+    // A cell is next to a normal node if one of its four neighbours holds one
+    int RandomGraph::_getPerimeterGain(int x, int y) const noexcept
+    {
+        int gain = 0;
+        for (int d = 0; d < 4; ++d)
+        {
+            auto [cell_x, cell_y] = _getNewCoordinates(x, y, static_cast<Direction>(d));
+            if (_getNodeAt(cell_x, cell_y) != -1)
+            {
+                continue;
+            }
+            bool touched = false;
+            for (int e = 0; e < 4 && !touched; ++e)
+            {
+                auto [next_x, next_y] = _getNewCoordinates(cell_x, cell_y, static_cast<Direction>(e));
+                const int next = _getNodeAt(next_x, next_y);
+                touched = next != -1 && getNode(next).getProperty() == Property::node;
+            }
+            gain += !touched;
+        }
+        return gain;
+    }
+
+    // The directions are scanned from a random one, so that ties are broken at random
+    int RandomGraph::_getWidestDirection(int node, int &gain) noexcept
+    {
+        const int first = _rng.below(4);
+        int widest = -1;
+        gain = -1;
+        for (int k = 0; k < 4; ++k)
+        {
+            const int d = (first + k) % 4;
+            if (_tested[node] & (1 << d))
+            {
+                continue;
+            }
+            auto [x, y] = _getNewCoordinates(getNode(node).getX(), getNode(node).getY(), static_cast<Direction>(d));
+            if (_getNodeAt(x, y) != -1)
+            {
+                continue;
+            }
+            const int cell_gain = _getPerimeterGain(x, y);
+            if (cell_gain > gain)
+            {
+                widest = d;
+                gain = cell_gain;
+            }
+        }
+        return widest;
+    }
+
+    // Candidates are checked when they are taken: a node only gains links and may have changed kind since
+    int RandomGraph::_popNormalLeaf() noexcept
+    {
+        while (!_normal_leaves.empty())
+        {
+            const int leaf = _normal_leaves.back();
+            _normal_leaves.pop_back();
+            if (getNode(leaf).getProperty() != Property::node || std::popcount(static_cast<unsigned>(_links[leaf])) != 1)
+            {
+                continue;
+            }
+            auto [x, y] = _getNewCoordinates(getNode(leaf).getX(), getNode(leaf).getY(),
+                                             static_cast<Direction>(std::countr_zero(static_cast<unsigned>(_links[leaf]))));
+            if (getNode(_getNodeAt(x, y)).getProperty() == Property::node) // A special leaf must hang from a normal node
+            {
+                return leaf;
+            }
+        }
+        return -1;
+    }
+
+    // Special leaves can fence the walk in, the walk is then reopened from one of them until every node is placed.
+    // The walk only empties once every normal node has all four directions tested, so no empty cell touches a
+    // normal node: the leaves fenced in now stay fenced in for good and the swapped normal leaf frees no cell
+    bool RandomGraph::_reopenWalk() noexcept
+    {
+        while (!_open_leaves.empty())
+        {
+            const int node = _open_leaves.back();
+            _open_leaves.pop_back();
+            const Property prop = getNode(node).getProperty();
+            const int gain = prop == Property::node ? 0 : _getPerimeterGain(getNode(node).getX(), getNode(node).getY());
+            if (gain == 0)
+            {
+                continue;
+            }
+
+            if (_num_node > 0)
+            {
+                _num_node--; // The leaf becomes one of the normal nodes, its kind goes back to the remaining counts
+                _getRemaining(prop)++;
+            }
+            else
+            {
+                // Every normal node is placed: a normal leaf takes the kind of the special leaf in exchange
+                const int leaf = _popNormalLeaf();
+                if (leaf == -1)
+                {
+                    return false;
+                }
+                _setProperty(leaf, prop);
+            }
+            _setProperty(node, Property::node);
+            _perimeter += gain;
+            _tested[node] = _links[node]; // Its way back to its parent is already linked
+            _normal_leaves.push_back(node);
+            _walk.push_back(node);
+            return true;
+        }
+        return false;
+    }
+
+    // Returns the remaining count of a property
+    int &RandomGraph::_getRemaining(Property prop) noexcept
+    {
+        switch (prop)
+        {
+        case Property::waiting:
+            return _num_waiting;
+        case Property::charging:
+            return _num_charging;
+        case Property::pickdrop:
+            return _num_pickdrop;
+        default:
+            return _num_node;
+        }
+    }
+
+    // Depth-first walk over the lattice: the last normal node of the walk is extended in a random untested
+    // direction and dropped once all four are tested, so every cell is tried a bounded number of times.
+    // Every node is linked to the node it was reached from, so the graph is a single component.
+    // Special nodes are leaves on the empty cells next to normal nodes. N normal nodes have at most 2N + 2 such
+    // cells (a straight line), a compact walk far fewer. While the special nodes left outnumber those cells, the
+    // walk only places normal nodes where they add at least two cells and adds no cycle, so every count that
+    // fits in the room of a tree is reached
+    bool RandomGraph::genRandomGraph(int num_node, int num_waiting, int num_charging, int num_pickdrop, AdjacencyBackend backend) noexcept
     {
         _num_node = num_node;
         _num_waiting = num_waiting;
         _num_charging = num_charging;
         _num_pickdrop = num_pickdrop;
-        clear();                  // Clear the graph
-        _id_node = 0;             // Initialize node identifier
-        _current_node = 0;        // Initialize current node
-        _from_direction = -1;     // Initialize direction
-        _clearTestedDirections(); // Clear tested directions
-
-        // Initialize the first pickdrop node
-        _addNode(_id_node++, 0, 0, Property::pickdrop);
-        _num_pickdrop--;
-
-        // Initialize the first normal node and edge
-        _addNode(_id_node++, 0, SCALE, Property::node);
-        _num_node--;
-        _addEdge(0, 1);
+        clear();         // Clear the graph
+        _links.clear();  // Clear the link masks
+        _tested.clear(); // Clear the tested masks
+        _walk.clear();   // Clear the walk
+        _open_leaves.clear();
+        _normal_leaves.clear();
+        _perimeter = 0;
+        _occupancy.clear();
+        _id_node = 0; // Initialize node identifier
+        if (num_node < 1 || num_waiting < 0 || num_charging < 0 || num_pickdrop < 0)
+        {
+            return false; // Special nodes are leaves, they need a normal node to hang from
+        }
+
+        // Every array is sized once, the walk adds about one edge per node plus the extra links
+        const int total = num_node + num_waiting + num_charging + num_pickdrop;
+        _reserve(total, total * 2);
+        _links.reserve(total);
+        _tested.reserve(total);
+        _occupancy.reserve(total);
 
-        _current_node = 1;                                            // Set the current node to the first normal node
-        _tested_directions[static_cast<int>(Direction::down)] = true; // Mark the direction down as tested
-        _from_direction = -1;
+        // The walk starts from a first normal node
+        _perimeter = 4;
+        _createNode(0, 0, Property::node);
+        _num_node--;
+        _walk.push_back(0);
 
         // Generate the rest of the graph
-        while (_num_node > 0 && (_num_charging > 0 || _num_waiting > 0 || _num_pickdrop > 0)) // While there are nodes to create
+        while (_num_node + _num_charging + _num_waiting + _num_pickdrop > 0) // While there are nodes to create
         {
-            // If all directions have been tested, backtrack or stop
-            if (std::all_of(_tested_directions.begin(), _tested_directions.end(), [](bool tested)
-                            { return tested; }))
+            // Every normal node is surrounded, go on from a special leaf or stop
+            if (_walk.empty() && !_reopenWalk())
             {
-                if (_from_direction == -1)
-                {
-                    break; // No way to backtrack, so break
-                }
-                else
-                {
-                    // Backtrack to the previous node
-                    auto [prev_x, prev_y] = _getNewCoordinates(getNode(_current_node).getX(), getNode(_current_node).getY(), static_cast<Direction>(_from_direction));
-                    _clearTestedDirections();
-                    _tested_directions[(_from_direction + 2) % 4] = true; // Mark the opposite direction as tested
-                    _current_node = getNodeAt(prev_x, prev_y);
-                    _from_direction = -1;
-                    continue;
-                }
+                break;
+            }
+            const int current = _walk.back();
+
+            // If all directions have been tested, backtrack
+            if (_tested[current] == 0xF)
+            {
+                _walk.pop_back();
+                continue;
             }
 
+            // Short of room for the special nodes, the walk heads for the cell opening the most new ones
+            const int num_special = _num_charging + _num_waiting + _num_pickdrop;
+            const bool short_of_room = _num_node > 0 && num_special > _perimeter;
+            int gain = -1;
+            int new_direction = short_of_room ? _getWidestDirection(current, gain) : -1;
+
             // Select a random untested direction
-            int new_direction;
-            while (true)
+            while (new_direction == -1)
             {
-                new_direction = std::rand() % 4;
-                if (!_tested_directions[new_direction])
+                new_direction = _rng.below(4);
+                if (_tested[current] & (1 << new_direction))
                 {
-                    break;
+                    new_direction = -1;
                 }
             }
 
-            _tested_directions[new_direction] = true;
-            auto [new_x, new_y] = _getNewCoordinates(getNode(_current_node).getX(), getNode(_current_node).getY(), static_cast<Direction>(new_direction));
+            _tested[current] |= 1 << new_direction;
+            auto [new_x, new_y] = _getNewCoordinates(getNode(current).getX(), getNode(current).getY(), static_cast<Direction>(new_direction));
 
-            int node = getNodeAt(new_x, new_y);
+            int node = _getNodeAt(new_x, new_y);
 
             if (node == -1) // No node exists at new coordinates, create one
             {
-                int r = std::rand() % (_num_node + _num_charging + _num_waiting + _num_pickdrop);
+                // Short of room, a normal node that does not widen the perimeter would take a cell from a special one
+                int r = !short_of_room ? _rng.below(_num_node + num_special)
+                        : gain >= 2    ? _rng.below(_num_node)
+                                       : _num_node + _rng.below(num_special);
+                _perimeter--; // The cell is next to the current node
 
-                if (r < _num_node) // Create a normal node
+                if (r < _num_node) // Create a normal node and extend the walk from it
                 {
-                    if (_num_node == 1) // Last normal node, create a pickdrop node
-                    {
-                        _addNode(_id_node++, new_x, new_y, Property::pickdrop);
-                        _num_node--;
-                        _addEdge(_current_node, _id_node - 1);
-                        break; // No more nodes to create
-                    }
-                    else // Create a normal node
-                    {
-                        _addNode(_id_node++, new_x, new_y, Property::node);
-                        _num_node--;
-                        _addEdge(_current_node, _id_node - 1);
-                        _current_node = _id_node - 1;
-                        _from_direction = (new_direction + 2) % 4;
-                        _clearTestedDirections();
-                        _tested_directions[_from_direction] = true;
-                    }
+                    _perimeter += gain == -1 ? _getPerimeterGain(new_x, new_y) : gain;
+                    _createNode(new_x, new_y, Property::node);
+                    _num_node--;
+                    _connect(current, _id_node - 1, new_direction);
+                    _tested[_id_node - 1] = 1 << ((new_direction + 2) % 4);
+                    _walk.push_back(_id_node - 1);
                 }
                 else if (r < _num_node + _num_charging) // Create a charging node
                 {
-                    _addNode(_id_node++, new_x, new_y, Property::charging);
+                    _createNode(new_x, new_y, Property::charging);
                     _num_charging--;
-                    _addEdge(_current_node, _id_node - 1);
+                    _connect(current, _id_node - 1, new_direction);
                 }
                 else if (r < _num_node + _num_charging + _num_waiting) // Create a waiting node
                 {
-                    _addNode(_id_node++, new_x, new_y, Property::waiting);
+                    _createNode(new_x, new_y, Property::waiting);
                     _num_waiting--;
-                    _addEdge(_current_node, _id_node - 1);
+                    _connect(current, _id_node - 1, new_direction);
                 }
                 else // Create a pickdrop node
                 {
-                    _addNode(_id_node++, new_x, new_y, Property::pickdrop);
+                    _createNode(new_x, new_y, Property::pickdrop);
                     _num_pickdrop--;
-                    _addEdge(_current_node, _id_node - 1);
+                    _connect(current, _id_node - 1, new_direction);
                 }
             }
-            else // Node exists at new coordinates
+            else if (getNode(node).getProperty() == Property::node && !(_links[current] & (1 << new_direction)))
             {
-                if (getNode(node).getProperty() == Property::node && isEdge(_current_node, node) == 1) // Node is a normal node and is connected
-                {
-                    _current_node = node;
-                    _clearTestedDirections();
-                    _tested_directions[(new_direction + 2) % 4] = true;
-                    _from_direction = -1;
-                }
-                else if (getNode(node).getProperty() == Property::node && isEdge(_current_node, node) == 0) // Node is a normal node but is not connected
-                {
-                    if (!(std::rand() % CONNECTIVITY))
-                        _addEdge(_current_node, node);
-                    _tested_directions[new_direction] = true;
-                }
-                else // Node is not a normal node
-                {
-                    _tested_directions[new_direction] = true;
-                }
+                // Normal node reached from an untested side, linked now and then to add cycles
+                if (!short_of_room && !_rng.below(CONNECTIVITY))
+                    _connect(current, node, new_direction);
+                _tested[node] |= 1 << ((new_direction + 2) % 4);
             }
+            // Otherwise the node is already linked to this one, or is a special node that stays a leaf
         }
+
+        _freeze();                    // Pack the generated edges into the CSR store
+        renumberNodes();              // Random walk order scatters neighbours, lay them out along a Hilbert curve
+        _indexNodes();                // Fill the coordinate and identifier indexes in one pass, in Hilbert order
+        _links.clear();               // The masks, the candidates and the occupancy map are indexed in generation order
+        _tested.clear();
+        _open_leaves.clear();
+        _normal_leaves.clear();
+        _occupancy.clear();
+        setAdjacencyBackend(backend); // Bit rows are built from the CSR store
+        buildDistanceFields();        // Nearest charging, waiting and pickdrop nodes become lookups
+        return _num_node + _num_charging + _num_waiting + _num_pickdrop == 0;
     }
-} // namespace graph
\ No newline at end of file
+} // namespace graph
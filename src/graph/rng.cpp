@@ -0,0 +1,23 @@
+#include "rng.hpp"
+
+namespace graph
+{
+    // Seeds the engine
+    Rng::Rng(std::uint64_t seed) noexcept
+    {
+        this->seed(seed);
+    }
+
+    // splitmix64 spreads any seed, even 0, over a state that is never all zeros
+    void Rng::seed(std::uint64_t seed) noexcept
+    {
+        for (auto &word : _state)
+        {
+            seed += 0x9E3779B97F4A7C15ull;
+            std::uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+} // namespace graph
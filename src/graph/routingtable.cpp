@@ -0,0 +1,178 @@
+#include "routingtable.hpp"
+#include "graph.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+namespace graph
+{
+    // Runs a BFS from every target, the BFS tree parent of a node is its next hop towards the target
+    RoutingTable::RoutingTable(const Graph &graph) noexcept
+        : _num_nodes(graph.getNumNodes()), _compact(graph.getNumNodes() < std::numeric_limits<std::uint16_t>::max())
+    {
+        const std::size_t num_entries = static_cast<std::size_t>(_num_nodes) * _num_nodes;
+        if (_compact)
+        {
+            _next_hop_16.assign(num_entries, std::numeric_limits<std::uint16_t>::max());
+            _distance_16.assign(num_entries, std::numeric_limits<std::uint16_t>::max());
+        }
+        else
+        {
+            _next_hop_32.assign(num_entries, std::numeric_limits<std::uint32_t>::max());
+            _distance_32.assign(num_entries, std::numeric_limits<std::uint32_t>::max());
+        }
+
+        std::vector<SearchWorkspace> workspaces(parallelWorkers(_num_nodes));
+        parallelFor(_num_nodes, [&](int target, int worker)
+                    { _fillColumn(graph, target, workspaces[worker]); });
+    }
+
+    // A target needs a new column if the added edge shortcuts its routes (its ends are two hops or more
+    // apart towards it) or if the removed edge was the next hop of one of its ends
+    void RoutingTable::repairEdge(const Graph &graph, int node_1, int node_2) noexcept
+    {
+        const bool added = graph.isEdge(node_1, node_2);
+        std::vector<int> targets;
+        for (int target = 0; target < _num_nodes; ++target)
+        {
+            const std::size_t column = static_cast<std::size_t>(target) * _num_nodes;
+            bool affected;
+            if (added)
+            {
+                const int distance_1 = _getDistanceEntry(column + node_1);
+                const int distance_2 = _getDistanceEntry(column + node_2);
+                affected = (distance_1 == -1) != (distance_2 == -1) || std::abs(distance_1 - distance_2) > 1;
+            }
+            else
+            {
+                affected = _getNextHopEntry(column + node_1) == node_2 || _getNextHopEntry(column + node_2) == node_1;
+            }
+            if (affected)
+            {
+                targets.push_back(target);
+            }
+        }
+
+        std::vector<SearchWorkspace> workspaces(parallelWorkers(static_cast<int>(targets.size())));
+        parallelFor(static_cast<int>(targets.size()), [&](int k, int worker)
+                    { _fillColumn(graph, targets[k], workspaces[worker]); });
+    }
+
+    // Unreached nodes get the unreachable marker, the BFS tree parent of a node is its next hop towards the target
+    void RoutingTable::_fillColumn(const Graph &graph, int target, SearchWorkspace &workspace) noexcept
+    {
+        const std::size_t column = static_cast<std::size_t>(target) * _num_nodes;
+        if (_compact)
+        {
+            std::fill_n(_next_hop_16.begin() + column, _num_nodes, std::numeric_limits<std::uint16_t>::max());
+            std::fill_n(_distance_16.begin() + column, _num_nodes, std::numeric_limits<std::uint16_t>::max());
+        }
+        else
+        {
+            std::fill_n(_next_hop_32.begin() + column, _num_nodes, std::numeric_limits<std::uint32_t>::max());
+            std::fill_n(_distance_32.begin() + column, _num_nodes, std::numeric_limits<std::uint32_t>::max());
+        }
+
+        workspace.begin(_num_nodes);
+        workspace.visit(target, target);
+        workspace.setCost(target, 0);
+        workspace.push(target);
+
+        while (!workspace.empty())
+        {
+            int node = workspace.pop();
+            int distance = workspace.getCost(node);
+            if (_compact)
+            {
+                _next_hop_16[column + node] = static_cast<std::uint16_t>(workspace.getPred(node));
+                _distance_16[column + node] = static_cast<std::uint16_t>(distance);
+            }
+            else
+            {
+                _next_hop_32[column + node] = static_cast<std::uint32_t>(workspace.getPred(node));
+                _distance_32[column + node] = static_cast<std::uint32_t>(distance);
+            }
+
+            for (int next : graph.getNeighbours(node))
+            {
+                if (!workspace.isVisited(next))
+                {
+                    workspace.visit(next, node);
+                    workspace.setCost(next, distance + 1);
+                    workspace.push(next);
+                }
+            }
+        }
+    }
+
+    // Reads the next hop from i towards j
+    int RoutingTable::getNextHop(int i, int j) const noexcept
+    {
+        if (i < 0 || j < 0 || i >= _num_nodes || j >= _num_nodes)
+        {
+            return -1;
+        }
+        return _getNextHopEntry(static_cast<std::size_t>(j) * _num_nodes + i);
+    }
+
+    // Reads the hop count between i and j
+    int RoutingTable::getDistance(int i, int j) const noexcept
+    {
+        if (i < 0 || j < 0 || i >= _num_nodes || j >= _num_nodes)
+        {
+            return -1;
+        }
+        return _getDistanceEntry(static_cast<std::size_t>(j) * _num_nodes + i);
+    }
+
+    // Follows the next hops from i until j is reached
+    bool RoutingTable::getPath(int i, int j, std::vector<int> &path) const noexcept
+    {
+        path.clear();
+        if (getDistance(i, j) == -1)
+        {
+            return false;
+        }
+
+        const std::size_t column = static_cast<std::size_t>(j) * _num_nodes;
+        path.push_back(i);
+        for (int node = i; node != j;)
+        {
+            node = _getNextHopEntry(column + node);
+            path.push_back(node);
+        }
+        return true;
+    }
+
+    // Sums the capacity of the matrices
+    std::size_t RoutingTable::getMemoryUsage() const noexcept
+    {
+        return (_next_hop_16.capacity() + _distance_16.capacity()) * sizeof(std::uint16_t) +
+               (_next_hop_32.capacity() + _distance_32.capacity()) * sizeof(std::uint32_t);
+    }
+
+    // Reads a next hop entry
+    int RoutingTable::_getNextHopEntry(std::size_t entry) const noexcept
+    {
+        if (_compact)
+        {
+            std::uint16_t value = _next_hop_16[entry];
+            return value == std::numeric_limits<std::uint16_t>::max() ? -1 : value;
+        }
+        std::uint32_t value = _next_hop_32[entry];
+        return value == std::numeric_limits<std::uint32_t>::max() ? -1 : static_cast<int>(value);
+    }
+
+    // Reads a distance entry
+    int RoutingTable::_getDistanceEntry(std::size_t entry) const noexcept
+    {
+        if (_compact)
+        {
+            std::uint16_t value = _distance_16[entry];
+            return value == std::numeric_limits<std::uint16_t>::max() ? -1 : value;
+        }
+        std::uint32_t value = _distance_32[entry];
+        return value == std::numeric_limits<std::uint32_t>::max() ? -1 : static_cast<int>(value);
+    }
+} // namespace graph
@@ -0,0 +1,660 @@
+#include "graph.hpp"
+#include "contractionhierarchy.hpp"
+#include "parallel.hpp"
+#include "routingtable.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <limits>
+
+namespace graph
+{
+  // Finds the shortest path between two nodes with a per-thread workspace
+  std::vector<int> Graph::getShortestPath(int i, int j, SearchAlgorithm algorithm) const noexcept
+  {
+    thread_local SearchWorkspace workspace;
+    std::vector<int> path;
+    getShortestPath(i, j, workspace, path, algorithm);
+    return path;
+  }
+
+  // Finds the shortest path between two nodes, without allocating once the buffers are warm
+  bool Graph::getShortestPath(int i, int j, SearchWorkspace &workspace, std::vector<int> &path, SearchAlgorithm algorithm,
+                              bool use_cache) const noexcept
+  {
+    path.clear();
+    if (i < 0 || j < 0 || i >= getNumNodes() || j >= getNumNodes())
+    {
+      return false;
+    }
+
+    if (algorithm == SearchAlgorithm::automatic)
+    {
+      algorithm = _routing_table           ? SearchAlgorithm::routing_table
+                  : _contraction_hierarchy ? SearchAlgorithm::contraction_hierarchy
+                  : _landmarks             ? SearchAlgorithm::alt
+                  : isLattice()            ? SearchAlgorithm::jump_point
+                                           : SearchAlgorithm::astar;
+    }
+
+    // Routing table walks are as cheap as a cache lookup
+    PathCache *cache = use_cache && !(algorithm == SearchAlgorithm::routing_table && _routing_table) ? _path_cache.get() : nullptr;
+    if (cache && cache->find(_epoch, i, j, static_cast<int>(algorithm), path))
+    {
+      return !path.empty();
+    }
+
+    bool found = false;
+    switch (algorithm)
+    {
+    case SearchAlgorithm::routing_table:
+      if (_routing_table)
+      {
+        return _routing_table->getPath(i, j, path);
+      }
+      [[fallthrough]];
+    case SearchAlgorithm::astar:
+      found = _findPathAStar(i, j, workspace);
+      break;
+    case SearchAlgorithm::alt:
+      found = _findPathAStar(i, j, workspace, _landmarks.get());
+      break;
+    case SearchAlgorithm::jump_point:
+      if (isLattice())
+      {
+        found = _findPathJumpPoint(i, j, workspace, path);
+        if (cache)
+        {
+          cache->insert(_epoch, i, j, static_cast<int>(algorithm), path);
+        }
+        return found;
+      }
+      found = _findPathAStar(i, j, workspace);
+      break;
+    case SearchAlgorithm::hierarchical:
+      if (_hierarchy)
+      {
+        found = _hierarchy->getPath(i, j, path);
+        if (cache)
+        {
+          cache->insert(_epoch, i, j, static_cast<int>(algorithm), path);
+        }
+        return found;
+      }
+      found = _findPathDijkstra(i, j, workspace);
+      break;
+    case SearchAlgorithm::contraction_hierarchy:
+      if (_contraction_hierarchy)
+      {
+        thread_local SearchWorkspace backward;
+        found = _contraction_hierarchy->getPath(i, j, workspace, backward, path);
+        if (cache)
+        {
+          cache->insert(_epoch, i, j, static_cast<int>(algorithm), path);
+        }
+        return found;
+      }
+      [[fallthrough]];
+    case SearchAlgorithm::dijkstra:
+      found = _findPathDijkstra(i, j, workspace);
+      break;
+    case SearchAlgorithm::bfs:
+    default:
+      found = _findPathBfs(i, j, workspace);
+      break;
+    }
+
+    // Trace the path back from the destination to the source
+    if (found)
+    {
+      for (int node = j; node != -1; node = workspace.getPred(node))
+      {
+        path.push_back(node);
+      }
+      std::reverse(path.begin(), path.end());
+    }
+
+    // Unreachable targets are cached too, as an empty path
+    if (cache)
+    {
+      cache->insert(_epoch, i, j, static_cast<int>(algorithm), path);
+    }
+    return found;
+  }
+
+  // Groups the queries by source, then grows one Dijkstra tree per source until all its targets are settled
+  void Graph::getShortestPaths(std::span<const std::pair<int, int>> queries, std::span<int> costs, BatchPaths *paths) const noexcept
+  {
+    const int num_queries = static_cast<int>(std::min(queries.size(), costs.size()));
+    const int num_nodes = getNumNodes();
+
+    // Sort the query indices by source, each run of equal sources is a group
+    std::vector<int> order(num_queries);
+    for (int k = 0; k < num_queries; ++k)
+    {
+      order[k] = k;
+    }
+    std::sort(order.begin(), order.end(), [&queries](int a, int b)
+              { return queries[a].first < queries[b].first; });
+    std::vector<int> groups;
+    for (int k = 0; k < num_queries; ++k)
+    {
+      if (k == 0 || queries[order[k]].first != queries[order[k - 1]].first)
+      {
+        groups.push_back(k);
+      }
+    }
+    const int num_groups = static_cast<int>(groups.size());
+    groups.push_back(num_queries);
+
+    std::vector<std::vector<int>> routes(paths ? num_queries : 0);
+    std::vector<SearchWorkspace> workspaces(parallelWorkers(num_groups));
+    parallelFor(num_groups, [&](int group, int worker)
+                {
+      SearchWorkspace &workspace = workspaces[worker];
+      const int source = queries[order[groups[group]]].first;
+      if (source < 0 || source >= num_nodes)
+      {
+        for (int k = groups[group]; k < groups[group + 1]; ++k)
+        {
+          costs[order[k]] = -1;
+        }
+        return;
+      }
+
+      // Distinct targets of the group, the search stops once all of them are settled
+      thread_local std::vector<int> targets;
+      targets.clear();
+      for (int k = groups[group]; k < groups[group + 1]; ++k)
+      {
+        int target = queries[order[k]].second;
+        if (target >= 0 && target < num_nodes)
+        {
+          targets.push_back(target);
+        }
+      }
+      std::sort(targets.begin(), targets.end());
+      targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+      int targets_left = static_cast<int>(targets.size());
+
+      workspace.begin(num_nodes);
+      RadixHeap &heap = workspace.getRadixHeap();
+      workspace.visit(source, -1);
+      workspace.setCost(source, 0);
+      heap.push(source, 0);
+      while (!heap.empty() && targets_left > 0)
+      {
+        std::uint32_t key;
+        int node = heap.pop(key);
+        if (static_cast<int>(key) > workspace.getCost(node))
+        {
+          continue; // Stale entry, the node was settled through a cheaper route
+        }
+        if (std::binary_search(targets.begin(), targets.end(), node))
+        {
+          targets_left--;
+        }
+
+        auto neighbours = getNeighbours(node);
+        auto weights = getEdgeWeights(node);
+        for (std::size_t n = 0; n < neighbours.size(); ++n)
+        {
+          int next = neighbours[n];
+          int cost = static_cast<int>(key) + weights[n];
+          if (!workspace.isVisited(next) || cost < workspace.getCost(next))
+          {
+            workspace.visit(next, node);
+            workspace.setCost(next, cost);
+            heap.push(next, static_cast<std::uint32_t>(cost));
+          }
+        }
+      }
+
+      // Read every query of the group off the tree
+      for (int k = groups[group]; k < groups[group + 1]; ++k)
+      {
+        const int query = order[k];
+        const int target = queries[query].second;
+        const bool reached = target >= 0 && target < num_nodes && workspace.isVisited(target);
+        costs[query] = reached ? workspace.getCost(target) : -1;
+        if (paths && reached)
+        {
+          for (int node = target; node != -1; node = workspace.getPred(node))
+          {
+            routes[query].push_back(node);
+          }
+          std::reverse(routes[query].begin(), routes[query].end());
+        }
+      } });
+
+    // Pack the routes in query order
+    if (paths)
+    {
+      paths->offsets.assign(num_queries + 1, 0);
+      for (int k = 0; k < num_queries; ++k)
+      {
+        paths->offsets[k + 1] = paths->offsets[k] + static_cast<int>(routes[k].size());
+      }
+      paths->nodes.clear();
+      paths->nodes.reserve(paths->offsets.back());
+      for (const auto &route : routes)
+      {
+        paths->nodes.insert(paths->nodes.end(), route.begin(), route.end());
+      }
+    }
+  }
+
+  // Reads the distance from the routing table, or runs a BFS: the other engines rank routes by travel time,
+  // which can take more hops on weighted graphs
+  int Graph::getDistance(int i, int j) const noexcept
+  {
+    if (_routing_table)
+    {
+      return _routing_table->getDistance(i, j);
+    }
+    thread_local SearchWorkspace workspace;
+    thread_local std::vector<int> path;
+    return getShortestPath(i, j, workspace, path, SearchAlgorithm::bfs) ? static_cast<int>(path.size()) - 1 : -1;
+  }
+
+  // Breadth-first search, each node and edge is visited at most once
+  bool Graph::_findPathBfs(int i, int j, SearchWorkspace &workspace) const noexcept
+  {
+    if (_hasBitsetRows())
+    {
+      return _findPathBfsBitset(i, j, workspace);
+    }
+
+    workspace.begin(getNumNodes());
+    workspace.visit(i, -1);
+    workspace.push(i);
+
+    while (!workspace.empty() && !workspace.isVisited(j))
+    {
+      int node = workspace.pop();
+      workspace.countExpanded();
+
+      for (int next : getNeighbours(node))
+      {
+        if (!workspace.isVisited(next))
+        {
+          workspace.visit(next, node);
+          workspace.push(next);
+        }
+      }
+    }
+
+    return workspace.isVisited(j);
+  }
+
+  // Direction-optimizing BFS: small levels push along the CSR rows of the frontier (top-down),
+  // large levels let every unvisited node AND its bit row with the frontier (bottom-up)
+  bool Graph::_findPathBfsBitset(int i, int j, SearchWorkspace &workspace) const noexcept
+  {
+    const int num_nodes = getNumNodes();
+    const int words = _bitset_words;
+    workspace.begin(num_nodes);
+    auto &frontier = workspace.getFrontierBits();
+    auto &next = workspace.getNextBits();
+    auto &visited = workspace.getVisitedBits();
+    frontier.assign(words, 0);
+    next.assign(words, 0);
+    visited.assign(words, 0);
+
+    auto bit = [](int node)
+    {
+      return std::uint64_t{1} << (node & 63);
+    };
+    auto degree = [this](int node)
+    {
+      return static_cast<long>(_offsets[node + 1] - _offsets[node]);
+    };
+
+    workspace.visit(i, -1);
+    frontier[i >> 6] |= bit(i);
+    visited[i >> 6] |= bit(i);
+    const std::uint64_t tail_mask = (num_nodes & 63) ? bit(num_nodes) - 1 : ~std::uint64_t{0};
+
+    long frontier_size = 1;
+    long frontier_edges = degree(i);
+    long unexplored_edges = static_cast<long>(_neighbours.size()) - frontier_edges;
+    bool bottom_up = false;
+
+    while (frontier_size > 0 && !workspace.isVisited(j))
+    {
+      if (!bottom_up && frontier_edges > unexplored_edges / BFS_ALPHA)
+      {
+        bottom_up = true;
+      }
+      else if (bottom_up && frontier_size < num_nodes / BFS_BETA)
+      {
+        bottom_up = false;
+      }
+
+      std::fill(next.begin(), next.end(), 0);
+      long next_size = 0;
+      long next_edges = 0;
+
+      if (bottom_up)
+      {
+        // The target only needs a parent in the frontier, the rest of the level is skipped when it has one
+        const std::uint64_t *target_row = _adjacency_bits.data() + static_cast<std::size_t>(j) * words;
+        for (int k = 0; k < words; ++k)
+        {
+          const std::uint64_t parents = target_row[k] & frontier[k];
+          if (parents)
+          {
+            workspace.visit(j, (k << 6) + std::countr_zero(parents));
+            return true;
+          }
+        }
+
+        // Each unvisited node looks for a parent in the frontier, one word of its row at a time
+        for (int w = 0; w < words; ++w)
+        {
+          std::uint64_t unvisited = ~visited[w] & (w == words - 1 ? tail_mask : ~std::uint64_t{0});
+          while (unvisited)
+          {
+            const int node = (w << 6) + std::countr_zero(unvisited);
+            unvisited &= unvisited - 1;
+            workspace.countExpanded();
+
+            const std::uint64_t *row = _adjacency_bits.data() + static_cast<std::size_t>(node) * words;
+            for (int k = 0; k < words; ++k)
+            {
+              const std::uint64_t parents = row[k] & frontier[k];
+              if (parents)
+              {
+                workspace.visit(node, (k << 6) + std::countr_zero(parents));
+                next[w] |= bit(node);
+                next_size++;
+                next_edges += degree(node);
+                break;
+              }
+            }
+          }
+        }
+        for (int w = 0; w < words; ++w)
+        {
+          visited[w] |= next[w];
+        }
+      }
+      else
+      {
+        // Each frontier node pushes to its unvisited neighbours
+        for (int w = 0; w < words; ++w)
+        {
+          std::uint64_t members = frontier[w];
+          while (members)
+          {
+            const int node = (w << 6) + std::countr_zero(members);
+            members &= members - 1;
+            workspace.countExpanded();
+
+            for (int neighbour : getNeighbours(node))
+            {
+              if (!(visited[neighbour >> 6] & bit(neighbour)))
+              {
+                visited[neighbour >> 6] |= bit(neighbour);
+                next[neighbour >> 6] |= bit(neighbour);
+                workspace.visit(neighbour, node);
+                if (neighbour == j)
+                {
+                  return true;
+                }
+                next_size++;
+                next_edges += degree(neighbour);
+              }
+            }
+          }
+        }
+      }
+
+      frontier.swap(next);
+      frontier_size = next_size;
+      frontier_edges = next_edges;
+      unexplored_edges -= next_edges;
+    }
+
+    return workspace.isVisited(j);
+  }
+
+  // A* search, nodes are ordered by travel time so far plus a lower bound of the remaining time
+  bool Graph::_findPathAStar(int i, int j, SearchWorkspace &workspace, const Landmarks *landmarks) const noexcept
+  {
+    workspace.begin(getNumNodes());
+    IndexedHeap &heap = workspace.getHeap();
+
+    // Ties on the estimate are broken towards the deepest node, which is closest to the target
+    auto key = [](int cost, int estimate) -> std::uint64_t
+    {
+      return (static_cast<std::uint64_t>(cost + estimate) << 32) | static_cast<std::uint32_t>(std::numeric_limits<int>::max() - cost);
+    };
+
+    workspace.visit(i, -1);
+    workspace.setCost(i, 0);
+    heap.push(i, key(0, _getHeuristic(i, j, landmarks)));
+
+    while (!heap.empty())
+    {
+      int node = heap.pop();
+      workspace.countExpanded();
+      if (node == j)
+      {
+        return true;
+      }
+
+      // A node reached again through a cheaper route is queued again
+      auto neighbours = getNeighbours(node);
+      auto weights = getEdgeWeights(node);
+      for (std::size_t k = 0; k < neighbours.size(); ++k)
+      {
+        int next = neighbours[k];
+        int cost = workspace.getCost(node) + weights[k];
+        if (!workspace.isVisited(next) || cost < workspace.getCost(next))
+        {
+          workspace.visit(next, node);
+          workspace.setCost(next, cost);
+          heap.push(next, key(cost, _getHeuristic(next, j, landmarks)));
+        }
+      }
+    }
+
+    return false;
+  }
+
+  // Canonical routes only turn from a vertical run into a horizontal one where a missing link forces it,
+  // so vertical runs are jumped until such a turn (or the target) and horizontal runs until a vertical jump
+  // from one of their nodes succeeds. Only those jump points enter the open list, keyed by (node, direction).
+  bool Graph::_findPathJumpPoint(int i, int j, SearchWorkspace &workspace, std::vector<int> &path) const noexcept
+  {
+    const int weight = _weights.empty() ? 1 : _weights.front();
+    workspace.begin(getNumNodes() * 4);
+    IndexedHeap &heap = workspace.getHeap();
+
+    auto step = [this](int node, int direction)
+    {
+      return _lattice_links[node * 4 + direction];
+    };
+    auto horizontal = [](int direction)
+    {
+      return direction % 2 == 1;
+    };
+
+    // Entering side from node is forced when the horizontal-first detour through prev is missing
+    auto forced = [&](int prev, int node, int vertical, int side_direction)
+    {
+      int side = step(node, side_direction);
+      if (side == -1)
+      {
+        return false;
+      }
+      int detour = step(prev, side_direction);
+      return detour == -1 || step(detour, vertical) != side;
+    };
+    auto jumpVertical = [&](int node, int direction)
+    {
+      for (int prev = node, next = step(node, direction); next != -1; prev = next, next = step(next, direction))
+      {
+        if (next == j || forced(prev, next, direction, 1) || forced(prev, next, direction, 3))
+        {
+          return next;
+        }
+      }
+      return -1;
+    };
+    auto jumpHorizontal = [&](int node, int direction)
+    {
+      for (int next = step(node, direction); next != -1; next = step(next, direction))
+      {
+        if (next == j || jumpVertical(next, 0) != -1 || jumpVertical(next, 2) != -1)
+        {
+          return next;
+        }
+      }
+      return -1;
+    };
+
+    auto key = [](int cost, int estimate) -> std::uint64_t
+    {
+      return (static_cast<std::uint64_t>(cost + estimate) << 32) | static_cast<std::uint32_t>(std::numeric_limits<int>::max() - cost);
+    };
+
+    // The start state has no direction, it is stored as direction 0 without a predecessor
+    workspace.visit(i * 4, -1);
+    workspace.setCost(i * 4, 0);
+    heap.push(i * 4, key(0, _getHeuristic(i, j)));
+
+    while (!heap.empty())
+    {
+      const int state = heap.pop();
+      const int node = state / 4;
+      const int direction = state % 4;
+      workspace.countExpanded();
+
+      if (node == j)
+      {
+        // Walk the jump points back to the source, then fill the runs in between
+        thread_local std::vector<int> states;
+        states.clear();
+        for (int s = state; s != -1; s = workspace.getPred(s))
+        {
+          states.push_back(s);
+        }
+        std::reverse(states.begin(), states.end());
+        path.assign(1, states.front() / 4);
+        for (std::size_t k = 1; k < states.size(); ++k)
+        {
+          for (int next = states[k - 1] / 4; next != states[k] / 4;)
+          {
+            next = step(next, states[k] % 4);
+            path.push_back(next);
+          }
+        }
+        return true;
+      }
+
+      // Directions allowed after the move that entered the node
+      std::array<int, 4> directions;
+      int num_directions = 0;
+      if (workspace.getPred(state) == -1)
+      {
+        directions = {0, 1, 2, 3};
+        num_directions = 4;
+      }
+      else if (horizontal(direction))
+      {
+        directions = {direction, 0, 2, 0};
+        num_directions = 3;
+      }
+      else
+      {
+        directions[num_directions++] = direction;
+        const int prev = step(node, (direction + 2) % 4);
+        for (int side_direction : {1, 3})
+        {
+          if (forced(prev, node, direction, side_direction))
+          {
+            directions[num_directions++] = side_direction;
+          }
+        }
+      }
+
+      const int cost = workspace.getCost(state);
+      for (int k = 0; k < num_directions; ++k)
+      {
+        const int d = directions[k];
+        const int jump = horizontal(d) ? jumpHorizontal(node, d) : jumpVertical(node, d);
+        if (jump == -1)
+        {
+          continue;
+        }
+        const int next = jump * 4 + d;
+        const int next_cost = cost + (std::abs(_xs[jump] - _xs[node]) + std::abs(_ys[jump] - _ys[node])) / SCALE * weight;
+        if (!workspace.isVisited(next) || next_cost < workspace.getCost(next))
+        {
+          workspace.visit(next, state);
+          workspace.setCost(next, next_cost);
+          heap.push(next, key(next_cost, _getHeuristic(jump, j)));
+        }
+      }
+    }
+
+    return false;
+  }
+
+  // Dijkstra search, edge weights are small integers so the monotone radix heap fits
+  bool Graph::_findPathDijkstra(int i, int j, SearchWorkspace &workspace) const noexcept
+  {
+    workspace.begin(getNumNodes());
+    RadixHeap &heap = workspace.getRadixHeap();
+
+    workspace.visit(i, -1);
+    workspace.setCost(i, 0);
+    heap.push(i, 0);
+
+    while (!heap.empty())
+    {
+      std::uint32_t key;
+      int node = heap.pop(key);
+      if (static_cast<int>(key) > workspace.getCost(node))
+      {
+        continue; // Stale entry, the node was settled through a cheaper route
+      }
+      workspace.countExpanded();
+      if (node == j)
+      {
+        return true;
+      }
+
+      auto neighbours = getNeighbours(node);
+      auto weights = getEdgeWeights(node);
+      for (std::size_t k = 0; k < neighbours.size(); ++k)
+      {
+        int next = neighbours[k];
+        int cost = static_cast<int>(key) + weights[k];
+        if (!workspace.isVisited(next) || cost < workspace.getCost(next))
+        {
+          workspace.visit(next, node);
+          workspace.setCost(next, cost);
+          heap.push(next, static_cast<std::uint32_t>(cost));
+        }
+      }
+    }
+
+    return false;
+  }
+
+  // No edge is faster than _min_weight_per_length per pixel of Manhattan distance, and
+  // both bounds are consistent so their maximum is too
+  int Graph::_getHeuristic(int i, int j, const Landmarks *landmarks) const noexcept
+  {
+    int bound = static_cast<int>((std::abs(_xs[i] - _xs[j]) + std::abs(_ys[i] - _ys[j])) * _min_weight_per_length);
+    if (landmarks)
+    {
+      bound = std::max(bound, landmarks->getLowerBound(i, j));
+    }
+    return bound;
+  }
+} // namespace graph
@@ -0,0 +1,36 @@
+#include "searchworkspace.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace graph
+{
+    // Grows the arrays if needed and moves to the next generation
+    void SearchWorkspace::begin(int num_nodes) noexcept
+    {
+        const std::size_t size = static_cast<std::size_t>(std::max(num_nodes, 1));
+        if (_stamps.size() < size)
+        {
+            _stamps.resize(size, 0);
+            _pred.resize(size, -1);
+            _cost.resize(size, 0);
+            _heap.reserve(static_cast<int>(size));
+        }
+        if (_frontier.size() < size)
+        {
+            _frontier.resize(std::bit_ceil(size));
+            _mask = _frontier.size() - 1;
+        }
+
+        // Stamps only need clearing once every 2^32 searches
+        if (++_generation == 0)
+        {
+            std::fill(_stamps.begin(), _stamps.end(), 0);
+            _generation = 1;
+        }
+        _head = 0;
+        _tail = 0;
+        _heap.clear();
+        _radix_heap.clear();
+        _expanded = 0;
+    }
+} // namespace graph
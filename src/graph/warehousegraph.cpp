@@ -0,0 +1,365 @@
+#include "warehousegraph.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+namespace graph
+{
+    // Rows of the floor: the dock row, the front cross-aisle, the aisle rows and the back cross-aisle
+    static int _getNumRows(const WarehouseLayout &layout) noexcept
+    {
+        return layout.aisle_length + 3;
+    }
+
+    // Columns of one tile: the aisle with a rack on each side
+    static int _getPitch(const WarehouseLayout &layout) noexcept
+    {
+        return 2 * layout.rack_depth + 1;
+    }
+
+    // Tells whether a row runs across the whole floor
+    static bool _isCrossAisle(const WarehouseLayout &layout, int y) noexcept
+    {
+        const int k = y - 1; // Position along the aisles, 0 for the front cross-aisle
+        return k == 0 || y == _getNumRows(layout) - 1 ||
+               (layout.cross_aisle_spacing > 0 && k % (layout.cross_aisle_spacing + 1) == 0);
+    }
+
+    // Tiles are built in parallel into their own arrays, then appended in aisle order so that the
+    // node identifiers do not depend on the scheduling
+    bool WarehouseGraph::genWarehouseGraph(const WarehouseLayout &layout, AdjacencyBackend backend) noexcept
+    {
+        clear();
+        if (!_isValid(layout))
+        {
+            return false;
+        }
+        const int height = _getNumRows(layout);
+
+        std::vector<Tile> tiles(layout.num_aisles);
+        parallelFor(layout.num_aisles, [&](int aisle, int)
+                    { _buildTile(layout, aisle, tiles[aisle]); });
+
+        std::vector<int> first(layout.num_aisles + 1, 0); // Index of the first node of each tile
+        std::size_t num_edges = 0;
+        for (int t = 0; t < layout.num_aisles; ++t)
+        {
+            first[t + 1] = first[t] + static_cast<int>(tiles[t].xs.size());
+            num_edges += tiles[t].edges.size() + height;
+        }
+        _reserve(first.back(), static_cast<int>(num_edges));
+
+        for (int t = 0; t < layout.num_aisles; ++t)
+        {
+            Tile &tile = tiles[t];
+            for (std::size_t k = 0; k < tile.xs.size(); ++k)
+            {
+                _addNode(first[t] + static_cast<int>(k), tile.xs[k] * SCALE, tile.ys[k] * SCALE, tile.props[k], false);
+            }
+            for (auto [node_1, node_2] : tile.edges)
+            {
+                _addEdge(first[t] + node_1, first[t] + node_2);
+            }
+            // Stitch the cross-aisles to the previous tile, whose nodes are all in the graph now
+            if (t > 0)
+            {
+                for (int y = 0; y < height; ++y)
+                {
+                    if (tiles[t - 1].east[y] != -1 && tile.west[y] != -1 && _isCrossAisle(layout, y))
+                    {
+                        _addEdge(first[t - 1] + tiles[t - 1].east[y], first[t] + tile.west[y]);
+                    }
+                }
+                tiles[t - 1] = Tile();
+            }
+        }
+
+        _freeze();                    // Pack the tile edges into the CSR store
+        renumberNodes();              // Tiles are long columns, lay the nodes out along a Hilbert curve
+        _indexNodes();                // Fill the coordinate and identifier indexes in one pass
+        setAdjacencyBackend(backend); // Bit rows are built from the CSR store
+        return true;
+    }
+
+    // Every section is written by its own pass over the tiles, the layout gives the same tiles each time.
+    // A pass keeps the tiles on both sides of the current one for the stitches
+    bool WarehouseGraph::genWarehouseFile(const WarehouseLayout &layout, const std::string &path) noexcept
+    {
+        if (!_isValid(layout))
+        {
+            return false;
+        }
+
+        // Counting pass: nodes, arcs and nodes of each property
+        std::int64_t num_nodes = 0;
+        std::int64_t num_arcs = 0;
+        std::vector<int> property_offsets(NUM_PROPERTIES + 1, 0);
+        _visitTiles(layout, [&](const Tile &tile, const TileRows &rows, int)
+                    {
+            num_nodes += static_cast<std::int64_t>(tile.xs.size());
+            num_arcs += static_cast<std::int64_t>(rows.neighbours.size());
+            for (Property prop : tile.props)
+                property_offsets[static_cast<int>(prop) + 1]++; });
+        if (num_arcs > std::numeric_limits<int>::max())
+        {
+            return false;
+        }
+        for (int p = 0; p < NUM_PROPERTIES; ++p)
+        {
+            property_offsets[p + 1] += property_offsets[p];
+        }
+
+        GraphFileWriter writer(path);
+        writer.getHeader().flags = GRAPH_FILE_UNIFORM_WEIGHTS; // Every edge joins two cells SCALE pixels apart
+        writer.getHeader().min_weight_per_length = 1.0;
+        std::vector<int> chunk;
+        chunk.reserve(WAREHOUSE_STREAM_CHUNK);
+        auto push = [&](GraphSection section, int value)
+        {
+            chunk.push_back(value);
+            if (chunk.size() == WAREHOUSE_STREAM_CHUNK)
+            {
+                writer.append(section, chunk);
+                chunk.clear();
+            }
+        };
+        auto flush = [&](GraphSection section)
+        {
+            writer.append(section, chunk);
+            chunk.clear();
+        };
+        // Writes a section from the nodes of every tile
+        auto stream = [&](GraphSection section, auto &&values)
+        {
+            _visitTiles(layout, [&](const Tile &tile, const TileRows &rows, int first)
+                        { values(tile, rows, first, [&](int value)
+                                 { push(section, value); }); });
+            flush(section);
+        };
+
+        for (std::int64_t i = 0; i < num_nodes; ++i)
+        {
+            push(GraphSection::ids, static_cast<int>(i)); // Identifiers are the indices of the generated nodes
+        }
+        flush(GraphSection::ids);
+        stream(GraphSection::xs, [](const Tile &tile, const TileRows &, int, auto &&out)
+               { for (int x : tile.xs) out(x * SCALE); });
+        stream(GraphSection::ys, [](const Tile &tile, const TileRows &, int, auto &&out)
+               { for (int y : tile.ys) out(y * SCALE); });
+        stream(GraphSection::props, [](const Tile &tile, const TileRows &, int, auto &&out)
+               { for (Property prop : tile.props) out(static_cast<int>(prop)); });
+        int offset = 0;
+        push(GraphSection::offsets, 0);
+        stream(GraphSection::offsets, [&offset](const Tile &tile, const TileRows &rows, int, auto &&out)
+               {
+            for (std::size_t k = 0; k < tile.xs.size(); ++k)
+                out(offset += rows.offsets[k + 1] - rows.offsets[k]); });
+        stream(GraphSection::neighbours, [](const Tile &, const TileRows &rows, int, auto &&out)
+               { for (int neighbour : rows.neighbours) out(neighbour); });
+        for (std::int64_t k = 0; k < num_arcs; ++k)
+        {
+            push(GraphSection::weights, SCALE);
+        }
+        flush(GraphSection::weights);
+        stream(GraphSection::lattice_links, [](const Tile &, const TileRows &rows, int, auto &&out)
+               { for (int link : rows.links) out(link); });
+        writer.write(GraphSection::property_offsets, property_offsets);
+        for (int p = 0; p < NUM_PROPERTIES; ++p)
+        {
+            stream(GraphSection::property_nodes, [p](const Tile &tile, const TileRows &, int first, auto &&out)
+                   {
+                for (std::size_t k = 0; k < tile.props.size(); ++k)
+                    if (static_cast<int>(tile.props[k]) == p)
+                        out(first + static_cast<int>(k)); });
+        }
+        return writer.finish();
+    }
+
+    // Checks the parameters and the size of the floor
+    bool WarehouseGraph::_isValid(const WarehouseLayout &layout) noexcept
+    {
+        if (layout.num_aisles < 1 || layout.aisle_length < 1 || layout.rack_depth < 1 || layout.cross_aisle_spacing < 0 ||
+            layout.pickdrop_spacing < 1 || layout.charging_spacing < 0 || layout.waiting_spacing < 0)
+        {
+            return false;
+        }
+        const std::int64_t width = static_cast<std::int64_t>(layout.num_aisles) * _getPitch(layout);
+        const std::int64_t height = static_cast<std::int64_t>(layout.aisle_length) + 3;
+        return width * height <= WAREHOUSE_MAX_CELLS && width * SCALE <= WAREHOUSE_MAX_CELLS && height * SCALE <= WAREHOUSE_MAX_CELLS;
+    }
+
+    // Corridor cells are linked to their corridor neighbours, stations only to the corridor cell they serve
+    void WarehouseGraph::_buildTile(const WarehouseLayout &layout, int aisle, Tile &tile) noexcept
+    {
+        const int pitch = _getPitch(layout);
+        const int height = _getNumRows(layout);
+        const int x0 = aisle * pitch;
+        std::vector<int> row(pitch, -1);       // Node of each column of the current row
+        std::vector<int> row_above(pitch, -1); // Same for the row above
+        tile.west.assign(height, -1);
+        tile.east.assign(height, -1);
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int lx = 0; lx < pitch; ++lx)
+            {
+                const int prop = _getCell(layout, x0 + lx, y);
+                row[lx] = -1;
+                if (prop == -1)
+                {
+                    continue;
+                }
+                const int node = static_cast<int>(tile.xs.size());
+                row[lx] = node;
+                tile.xs.push_back(x0 + lx);
+                tile.ys.push_back(y);
+                tile.props.push_back(static_cast<Property>(prop));
+
+                if (static_cast<Property>(prop) != Property::node)
+                {
+                    continue; // Stations are linked from the corridor cell they face
+                }
+                if (lx > 0 && row[lx - 1] != -1)
+                {
+                    // Left neighbour: a corridor cell, or a station of the rack facing this aisle cell
+                    const bool corridor = tile.props[row[lx - 1]] == Property::node;
+                    if (corridor || lx == layout.rack_depth)
+                    {
+                        tile.edges.emplace_back(row[lx - 1], node);
+                    }
+                }
+                if (row_above[lx] != -1 && (tile.props[row_above[lx]] == Property::node || y == 1))
+                {
+                    // Upper neighbour: a corridor cell, or a dock spot in front of the front cross-aisle
+                    tile.edges.emplace_back(row_above[lx], node);
+                }
+            }
+            // Right station of the aisle cell, facing it from the other rack
+            const int aisle_cell = row[layout.rack_depth];
+            const int right = row[layout.rack_depth + 1];
+            if (aisle_cell != -1 && right != -1 && tile.props[right] != Property::node)
+            {
+                tile.edges.emplace_back(aisle_cell, right);
+            }
+            tile.west[y] = row.front();
+            tile.east[y] = row.back();
+            std::swap(row, row_above);
+        }
+    }
+
+    // Cross-aisles cover whole rows, the other rows only hold the aisle cells and the stations facing them
+    int WarehouseGraph::_getCell(const WarehouseLayout &layout, int x, int y) noexcept
+    {
+        if (y == 0)
+        {
+            if (layout.charging_spacing > 0 && x % layout.charging_spacing == 0)
+            {
+                return static_cast<int>(Property::charging);
+            }
+            if (layout.waiting_spacing > 0 && x % layout.waiting_spacing == 0)
+            {
+                return static_cast<int>(Property::waiting);
+            }
+            return -1;
+        }
+        if (_isCrossAisle(layout, y))
+        {
+            return static_cast<int>(Property::node);
+        }
+        const int lx = x % _getPitch(layout);
+        if (lx == layout.rack_depth)
+        {
+            return static_cast<int>(Property::node);
+        }
+        if ((lx == layout.rack_depth - 1 || lx == layout.rack_depth + 1) && (y - 1) % layout.pickdrop_spacing == 0)
+        {
+            return static_cast<int>(Property::pickdrop);
+        }
+        return -1;
+    }
+
+    // Counting sort of the tile edges and the stitches into rows, the lattice links follow the relative cells
+    void WarehouseGraph::_linkTile(const WarehouseLayout &layout, const Tile &previous, const Tile &tile, const Tile &next,
+                                   int first, TileRows &rows) noexcept
+    {
+        const int num_nodes = static_cast<int>(tile.xs.size());
+        const int first_tile = first + static_cast<int>(previous.xs.size());
+        const int first_next = first_tile + num_nodes;
+        std::vector<std::pair<int, int>> arcs; // (local node, global neighbour)
+        arcs.reserve(tile.edges.size() * 2 + tile.west.size() * 2);
+        for (auto [node_1, node_2] : tile.edges)
+        {
+            arcs.emplace_back(node_1, first_tile + node_2);
+            arcs.emplace_back(node_2, first_tile + node_1);
+        }
+        rows.links.assign(static_cast<std::size_t>(num_nodes) * 4, -1);
+        for (auto [node, neighbour] : arcs)
+        {
+            const int local = neighbour - first_tile;
+            const int dx = tile.xs[local] - tile.xs[node];
+            const int dy = tile.ys[local] - tile.ys[node];
+            rows.links[node * 4 + (dy < 0 ? 0 : dx > 0 ? 1 : dy > 0 ? 2 : 3)] = neighbour;
+        }
+        for (std::size_t y = 0; y < tile.west.size(); ++y)
+        {
+            if (!_isCrossAisle(layout, static_cast<int>(y)))
+            {
+                continue;
+            }
+            if (!previous.east.empty() && previous.east[y] != -1 && tile.west[y] != -1)
+            {
+                arcs.emplace_back(tile.west[y], first + previous.east[y]);
+                rows.links[tile.west[y] * 4 + 3] = first + previous.east[y];
+            }
+            if (!next.west.empty() && next.west[y] != -1 && tile.east[y] != -1)
+            {
+                arcs.emplace_back(tile.east[y], first_next + next.west[y]);
+                rows.links[tile.east[y] * 4 + 1] = first_next + next.west[y];
+            }
+        }
+
+        rows.offsets.assign(num_nodes + 1, 0);
+        for (auto [node, neighbour] : arcs)
+        {
+            rows.offsets[node + 1]++;
+        }
+        for (int k = 0; k < num_nodes; ++k)
+        {
+            rows.offsets[k + 1] += rows.offsets[k];
+        }
+        rows.neighbours.resize(arcs.size());
+        std::vector<int> fill(rows.offsets.begin(), rows.offsets.end() - 1);
+        for (auto [node, neighbour] : arcs)
+        {
+            rows.neighbours[fill[node]++] = neighbour;
+        }
+        for (int k = 0; k < num_nodes; ++k)
+        {
+            std::sort(rows.neighbours.begin() + rows.offsets[k], rows.neighbours.begin() + rows.offsets[k + 1]);
+        }
+    }
+
+    // The tile after the current one is built ahead, the one before it is kept, older tiles are dropped
+    template <typename Visit>
+    void WarehouseGraph::_visitTiles(const WarehouseLayout &layout, Visit &&visit) noexcept
+    {
+        Tile previous, tile, next;
+        TileRows rows;
+        _buildTile(layout, 0, tile);
+        int first = 0; // First node of the previous tile
+        for (int aisle = 0; aisle < layout.num_aisles; ++aisle)
+        {
+            next = Tile();
+            if (aisle + 1 < layout.num_aisles)
+            {
+                _buildTile(layout, aisle + 1, next);
+            }
+            _linkTile(layout, previous, tile, next, first, rows);
+            visit(tile, rows, first + static_cast<int>(previous.xs.size()));
+            first += static_cast<int>(previous.xs.size());
+            previous = std::move(tile);
+            tile = std::move(next);
+        }
+    }
+} // namespace graph
@@ -1,19 +1,20 @@
-#include "randomgraph.hpp"
+#include "graphstore.hpp"
 #include "server.hpp"
 #include "robotsmanager.hpp"
 #include "tasksmanager.hpp"
 
 #include <future>
+#include <random>
 
 int main()
 {
-    std::shared_ptr<graph::RandomGraph> graph = std::make_shared<graph::RandomGraph>();
+    std::shared_ptr<graph::GraphStore> graphs = std::make_shared<graph::GraphStore>();
 
-    std::shared_ptr<task::TasksManager> tasksManager = std::make_shared<task::TasksManager>(graph);
+    std::shared_ptr<task::TasksManager> tasksManager = std::make_shared<task::TasksManager>(graphs, graph::Rng(std::random_device()()));
 
-    std::shared_ptr<robot::RobotsManager> robotsManager = std::make_shared<robot::RobotsManager>(graph, tasksManager);
+    std::shared_ptr<robot::RobotsManager> robotsManager = std::make_shared<robot::RobotsManager>(graphs, tasksManager);
 
-    web::Server server{8080, graph, robotsManager, tasksManager};
+    web::Server server{8080, graphs, robotsManager, tasksManager};
 
     auto serverFuture = std::async(std::launch::async, [&server]
                                    { server.start(); });
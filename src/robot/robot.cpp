@@ -1,4 +1,5 @@
 #include "robot.hpp"
+#include <algorithm>
 #include <cmath>
 #include <sstream>
 namespace robot
@@ -34,13 +35,21 @@ namespace robot
     float Robot::getAngle() const noexcept { return _angle.load(); }
 
     // Adds a movement task to the queue
-    void Robot::move(int x, int y) noexcept
+    void Robot::move(int x, int y, int travel_time) noexcept
     {
-        _addTask([this, x, y]()
+        _addTask([this, x, y, travel_time]()
                  {
             int dx = (x > _x) ? 1 : (x < _x) ? -1 : 0;
             int dy = (y > _y) ? 1 : (y < _y) ? -1 : 0;
 
+            // Spread the travel time over the pixel steps of the move
+            int steps = std::max(std::abs(x - _x), std::abs(y - _y));
+            auto step_time = std::chrono::microseconds(SPEED * 1000);
+            if (travel_time >= 0 && steps > 0)
+            {
+                step_time = std::chrono::microseconds(static_cast<long long>(travel_time) * SPEED * 1000 / steps);
+            }
+
             while (_x != x || _y != y)
             {
                 if (_x != x)
@@ -53,7 +62,7 @@ namespace robot
                 }
                 _angle = std::atan2(dy, dx) * 180.0 / M_PI; // Update the angle
                 _battery -= MOVE_BATTERY_CONSUMPTION; // Consume battery
-                std::this_thread::sleep_for(std::chrono::milliseconds(SPEED));
+                std::this_thread::sleep_for(step_time);
             } });
     }
 
@@ -64,6 +73,12 @@ namespace robot
                  { task->setStatus(task::TaskStatus::done); });
     }
 
+    // Queues a callback behind the pending moves
+    void Robot::schedule(const std::function<void()> &callback) noexcept
+    {
+        _addTask(callback);
+    }
+
     // Adds a task to the queue
     void Robot::_addTask(const std::function<void()> &task) noexcept
     {
@@ -90,6 +105,7 @@ namespace robot
 
                 task = _robot_task_queue.front();
                 _robot_task_queue.pop();
+                _executing = true;
             }
 
             if (task)
@@ -100,13 +116,18 @@ namespace robot
             {
                 std::this_thread::sleep_for(std::chrono::milliseconds(NO_TASK_WAIT_TIME)); // Sleep for 100 milliseconds
             }
+
+            {
+                std::lock_guard<std::mutex> lock(_queue_mutex);
+                _executing = false;
+            }
         }
     }
 
     bool Robot::isAvailable() noexcept
     {
         std::lock_guard<std::mutex> lock(_queue_mutex);
-        return _robot_task_queue.empty() && _running;
+        return _robot_task_queue.empty() && !_executing && _running; // A running task may still queue more moves
     }
 
     // Worker thread function
@@ -4,15 +4,22 @@
 
 namespace robot
 {
-    // Constructor with parameters to initialize the RobotsManager with a graph and a task manager
-    RobotsManager::RobotsManager(std::shared_ptr<graph::Graph> graph, std::shared_ptr<task::TasksManager> tasks_manager) noexcept
-        : _graph(graph), _tasks_manager(tasks_manager), _running(true)
+    // Constructor with parameters to initialize the RobotsManager with the graph snapshots and a task manager
+    RobotsManager::RobotsManager(std::shared_ptr<graph::GraphStore> graphs, std::shared_ptr<task::TasksManager> tasks_manager) noexcept
+        : _graphs(graphs), _tasks_manager(tasks_manager), _running(true)
     {
     }
 
-    // Adds a new robot to the manager
+    // Adds a new robot to the manager, snapped onto the closest node of the graph
     void RobotsManager::addRobot(float x, float y) noexcept
     {
+        auto graph = _graphs->load();
+        int node = graph->getNearestNode(x, y);
+        if (node != -1)
+        {
+            x = graph->getNode(node).getX();
+            y = graph->getNode(node).getY();
+        }
         _robots.emplace_back(std::make_shared<Robot>(_id_robot++, x, y));
     }
 
@@ -31,60 +38,223 @@ namespace robot
         _running = true; // Ensure the loop can run
         while (_running)
         {
-            task::Task *pending_task = nullptr;
-
-            // Search for a pending task
+            // Collect the pending tasks and the available robots
+            std::vector<task::Task *> pending_tasks;
             for (auto &t : _tasks_manager->getTasks())
             {
                 if (t.getStatus() == task::TaskStatus::pending)
                 {
-                    pending_task = &t; // A pending task found, remove const to modify task status
-                    break;
+                    pending_tasks.push_back(&t);
+                }
+            }
+            std::vector<std::shared_ptr<Robot>> available_robots;
+            for (auto &robot : _robots)
+            {
+                if (robot->isAvailable())
+                {
+                    available_robots.push_back(robot);
                 }
             }
 
-            if (pending_task == nullptr)
+            if (pending_tasks.empty() || available_robots.empty())
             {
-                // No pending task found, wait before checking again
+                // Nothing to assign, wait before checking again
                 std::this_thread::sleep_for(std::chrono::milliseconds(100));
                 continue;
             }
 
-            // Find an available robot
-            for (auto &robot : _robots)
+            // Every route of this round is planned on the same snapshot, even if a new graph is published meanwhile.
+            // The version is read first, a publish in between only costs a needless replan
+            const std::uint64_t version = _graphs->getVersion();
+            auto graph = _graphs->load();
+
+            // Robot x task matrix of travel times to the pick-up points, answered as one batch
+            const std::size_t num_robots = available_robots.size();
+            const std::size_t num_tasks = pending_tasks.size();
+            std::vector<std::pair<int, int>> queries;
+            queries.reserve(num_robots * num_tasks);
+            for (const auto &robot : available_robots)
             {
-                if (robot->isAvailable())
+                int start_node = graph->getNodeAt(robot->getX(), robot->getY());
+                for (const auto *pending_task : pending_tasks)
                 {
-                    // Update the task status and assign it to the robot
-                    pending_task->setStatus(task::TaskStatus::in_progress);
-                    pending_task->setAssignedRobotId(robot->getId());
-
-                    int start_node = _graph->getNodeAt(robot->getX(), robot->getY());
-                    int pick_node = pending_task->getNodeIdPick();
-                    int dropNode = pending_task->getNodeIdDrop();
-
-                    // Move towards the pick-up point
-                    auto path_to_pick = _graph->getShortestPath(start_node, pick_node);
-                    for (int node : path_to_pick)
-                    {
-                        const auto &node_position = _graph->getNode(node);
-                        robot->move(node_position.getX(), node_position.getY());
-                    }
-
-                    // Move towards the drop-off point
-                    auto path_to_drop = _graph->getShortestPath(pick_node, dropNode);
-                    for (int node : path_to_drop)
-                    {
-                        const auto &node_position = _graph->getNode(node);
-                        robot->move(node_position.getX(), node_position.getY());
-                    }
-
-                    // Instruct the robot to mark the task as completed
-                    robot->markTaskDone(pending_task);
-
-                    break; // Exit the loop after assigning the task
+                    queries.emplace_back(start_node, graph->getNodeIndex(pending_task->getNodeIdPick()));
                 }
             }
+            std::vector<int> costs(queries.size());
+            graph->getShortestPaths(queries, costs);
+
+            // Greedily hand out the cheapest (robot, task) pairs, unreachable pick-up points are skipped
+            std::vector<std::size_t> order;
+            for (std::size_t k = 0; k < costs.size(); ++k)
+            {
+                if (costs[k] >= 0)
+                {
+                    order.push_back(k);
+                }
+            }
+            std::stable_sort(order.begin(), order.end(), [&costs](std::size_t a, std::size_t b)
+                             { return costs[a] < costs[b]; });
+            std::vector<char> robot_busy(num_robots, 0);
+            std::vector<char> task_taken(num_tasks, 0);
+            bool assigned = false;
+            for (std::size_t k : order)
+            {
+                std::size_t r = k / num_tasks;
+                std::size_t t = k % num_tasks;
+                if (!robot_busy[r] && !task_taken[t])
+                {
+                    robot_busy[r] = 1;
+                    task_taken[t] = 1;
+                    _assignTask(graph, version, available_robots[r], pending_tasks[t], queries[k].first);
+                    assigned = true;
+                }
+            }
+
+            if (!assigned)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+    }
+
+    // Plans the route of a task and queues it on the robot
+    void RobotsManager::_assignTask(const std::shared_ptr<const graph::Graph> &graph, std::uint64_t version,
+                                    const std::shared_ptr<Robot> &robot, task::Task *pending_task, int start_node) noexcept
+    {
+        // Update the task status and assign it to the robot
+        pending_task->setStatus(task::TaskStatus::in_progress);
+        pending_task->setAssignedRobotId(robot->getId());
+
+        // Only the route is planned now, it is queued segment by segment so that a graph edit reaches the robot
+        auto route = std::make_shared<LazyRoute>();
+        route->graph = graph;
+        route->hierarchy = graph->getHierarchy();
+        route->version = version;
+        route->task = pending_task;
+        if (!_planRoute(*route, start_node, false, _path))
+        {
+            robot->markTaskDone(pending_task); // Unreachable drop-off point, nothing to move
+            return;
+        }
+
+        // The first segment is awaited on the robot's worker thread, the dispatcher goes on with the next task
+        _refineNextSegment(*route);
+        robot->schedule([this, robot, route]()
+                        { _followRoute(robot, route); });
+    }
+
+    // The legs are joined at the pick-up node, a route of a single node is padded so that it has a segment.
+    // The waypoints are those of the cluster graph, or every node of the route when the snapshot has none
+    bool RobotsManager::_planRoute(LazyRoute &route, int start_node, bool picked, std::vector<int> &leg) noexcept
+    {
+        thread_local graph::SearchWorkspace workspace;
+        auto plan = [&route](int from, int to, std::vector<int> &waypoints)
+        {
+            return route.hierarchy ? route.hierarchy->getAbstractPath(from, to, waypoints)
+                                   : route.graph->getShortestPath(from, to, workspace, waypoints, graph::SearchAlgorithm::automatic);
+        };
+
+        int pick_node = route.graph->getNodeIndex(route.task->getNodeIdPick());
+        int drop_node = route.graph->getNodeIndex(route.task->getNodeIdDrop());
+        if (!plan(picked ? start_node : pick_node, drop_node, leg))
+        {
+            return false;
+        }
+        route.waypoints.clear();
+        if (!picked && !plan(start_node, pick_node, route.waypoints))
+        {
+            return false;
+        }
+        route.pick = route.waypoints.empty() ? 0 : route.waypoints.size() - 1;
+        route.waypoints.insert(route.waypoints.end(), leg.begin() + (route.waypoints.empty() ? 0 : 1), leg.end());
+        if (route.waypoints.size() == 1)
+        {
+            route.waypoints.push_back(route.waypoints.front());
+        }
+        route.next = 1;
+        return true;
+    }
+
+    // The robot stands on node, found again by its identifier (or by its position if it was removed)
+    void RobotsManager::_replanRoute(const std::shared_ptr<Robot> &robot, std::shared_ptr<LazyRoute> route, int node) noexcept
+    {
+        const bool picked = route->next > route->pick;
+        const graph::Node position = route->graph->getNode(node);
+        route->version = _graphs->getVersion();
+        route->graph = _graphs->load();
+        route->hierarchy = route->graph->getHierarchy();
+        int start_node = route->graph->getNodeIndex(position.getId());
+        if (start_node == -1)
+        {
+            start_node = route->graph->getNearestNode(static_cast<float>(position.getX()), static_cast<float>(position.getY()));
+        }
+
+        std::vector<int> leg;
+        if (!_planRoute(*route, start_node, picked, leg))
+        {
+            robot->markTaskDone(route->task); // The edit cut the robot off, the task is dropped where it stands
+            return;
+        }
+        _refineNextSegment(*route);
+        robot->schedule([this, robot, route]()
+                        { _followRoute(robot, route); });
+    }
+
+    // Queues the moves of a path, each hop paced by the travel time of its edge
+    void RobotsManager::_moveAlongPath(Robot &robot, const graph::Graph &graph, const std::vector<int> &path) noexcept
+    {
+        for (std::size_t k = 0; k < path.size(); ++k)
+        {
+            const auto &node_position = graph.getNode(path[k]);
+            int travel_time = k == 0 ? -1 : graph.getEdgeWeight(path[k - 1], path[k]);
+            robot.move(node_position.getX(), node_position.getY(), travel_time);
+        }
+    }
+
+    // Refines the segment ending at route.next on another thread, the segment starts with its first waypoint.
+    // Without a cluster graph the waypoints are neighbours, the segment is the hop itself
+    void RobotsManager::_refineNextSegment(LazyRoute &route) noexcept
+    {
+        int from = route.waypoints[route.next - 1];
+        int to = route.waypoints[route.next];
+        if (!route.hierarchy)
+        {
+            route.pending = std::async(std::launch::deferred, [from, to]()
+                                       { return from == to ? std::vector<int>{from} : std::vector<int>{from, to}; });
+            return;
+        }
+        route.pending = std::async(std::launch::async, [hierarchy = route.hierarchy, from, to]()
+                                   {
+            std::vector<int> segment{from};
+            if (!hierarchy->refineSegment(from, to, segment))
+            {
+                segment.resize(1); // Unreachable, the robot stays where it is
+            }
+            return segment; });
+    }
+
+    // Waits for the segment refined while the robot was moving, queues it and starts on the next one.
+    // A segment refined on a snapshot that has been replaced since is dropped and the route is replanned
+    void RobotsManager::_followRoute(std::shared_ptr<Robot> robot, std::shared_ptr<LazyRoute> route) noexcept
+    {
+        std::vector<int> segment = route->pending.get();
+        if (route->version != _graphs->getVersion())
+        {
+            _replanRoute(robot, route, segment.front());
+            return;
+        }
+        _moveAlongPath(*robot, *route->graph, segment);
+
+        if (++route->next < route->waypoints.size())
+        {
+            _refineNextSegment(*route);
+            robot->schedule([this, robot, route]()
+                            { _followRoute(robot, route); });
+        }
+        else
+        {
+            robot->markTaskDone(route->task);
         }
     }
 
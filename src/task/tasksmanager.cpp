@@ -3,29 +3,37 @@
 
 namespace task
 {
-    // Constructor with a shared pointer to a Graph object
-    TasksManager::TasksManager(std::shared_ptr<graph::Graph> graph) noexcept
-        : _graph(graph)
+    // Constructor with the store publishing the graph snapshots and the engine drawing the tasks
+    TasksManager::TasksManager(std::shared_ptr<graph::GraphStore> graphs, graph::Rng rng) noexcept
+        : _graphs(graphs), _rng(rng)
     {
     }
 
     // Adds random tasks to the task vector based on the number of tasks specified
     void TasksManager::addRandomTasks(int n) noexcept
     {
+        auto graph = _graphs->load(); // Every task of the batch comes from the same snapshot
         for (int i = 0; i < n; ++i)
         {
             int node_id_pick, node_id_drop;
 
             do
             {
-                node_id_pick = _graph->getRandomPickDrop(); // Get a random pick node
-                node_id_drop = _graph->getRandomPickDrop(); // Get a random drop node
+                node_id_pick = graph->getRandomPickDrop(_rng); // Get a random pick node
+                node_id_drop = graph->getRandomPickDrop(_rng); // Get a random drop node
             } while (node_id_pick == node_id_drop || node_id_pick == -1 || node_id_drop == -1); // Ensure pick and drop nodes are different and not 0
 
-            _tasks.emplace_back(_task_id++, node_id_pick, node_id_drop);
+            // Tasks hold node identifiers, which outlive the indices of an edited graph
+            _tasks.emplace_back(_task_id++, graph->getNode(node_id_pick).getId(), graph->getNode(node_id_drop).getId());
         }
     }
 
+    // Reseeds the engine, the task identifiers keep counting
+    void TasksManager::seed(std::uint64_t seed) noexcept
+    {
+        _rng.seed(seed);
+    }
+
     // Returns a reference to the tasks vector
     std::vector<Task> &TasksManager::getTasks() noexcept
     {
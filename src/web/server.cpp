@@ -1,11 +1,21 @@
 #include "server.hpp"
+#include "contractionhierarchy.hpp"
+#include "importedgraph.hpp"
+#include "randomgraph.hpp"
+#include "warehousegraph.hpp"
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <sstream>
 
 namespace web
 {
 
-  Server::Server(int port, std::shared_ptr<graph::RandomGraph> graph, std::shared_ptr<robot::RobotsManager> robots_manager, std::shared_ptr<task::TasksManager> tasks_manager) noexcept
-      : _port(port), _graph(graph), _robots_manager(robots_manager), _tasks_manager(tasks_manager)
+  Server::Server(int port, std::shared_ptr<graph::GraphStore> graphs, std::shared_ptr<robot::RobotsManager> robots_manager, std::shared_ptr<task::TasksManager> tasks_manager) noexcept
+      : _port(port), _graphs(graphs), _robots_manager(robots_manager), _tasks_manager(tasks_manager)
   {
+    std::error_code error;
+    std::filesystem::create_directories(MAPS_DIRECTORY, error); // A missing directory only fails the map requests
     setHTTPServer();
   }
 
@@ -45,14 +55,188 @@ namespace web
         auto num_waiting = std::stoi(req.get_param_value("num_waiting"));
         auto num_charging = std::stoi(req.get_param_value("num_charging"));
         auto num_pickdrop = std::stoi(req.get_param_value("num_pickdrop"));
+        // Optional adjacency storage, "bitset" suits dense layouts
+        auto backend = req.get_param_value("backend") == "bitset" ? graph::AdjacencyBackend::bitset : graph::AdjacencyBackend::csr;
 
-        _graph->genRandomGraph(num_node, num_waiting, num_charging, num_pickdrop);
+        // Optional seed, the same seed and counts always give the same graph
+        auto seed = req.has_param("seed") ? std::stoull(req.get_param_value("seed")) : std::random_device()();
+
+        // The new graph is built and precomputed off to the side, readers keep the current one meanwhile
+        auto graph = std::make_shared<graph::RandomGraph>(graph::Rng(seed));
+        bool complete = graph->genRandomGraph(num_node, num_waiting, num_charging, num_pickdrop, backend);
+
+        // The counts actually placed, short of the request only if the special nodes found no room
+        std::ostringstream counts;
+        counts << "{\"complete\": " << (complete ? "true" : "false");
+        for (auto prop : {graph::Property::node, graph::Property::waiting, graph::Property::charging, graph::Property::pickdrop})
+        {
+            counts << ", \"" << graph::getPropertyName(prop) << "\": " << graph->getNodesWith(prop).size();
+        }
+        counts << "}";
+        std::cout << "Random graph: " << counts.str() << std::endl;
+        prepareGraph(*graph);
+        std::lock_guard<std::mutex> lock(_publish_mutex);
+        _graphs->publish(std::move(graph));
+        res.set_content(counts.str(), "application/json");
         res.status = 200;
     } catch (const std::exception &e) {
         res.status = 400;
         res.set_content("Invalid parameters", "text/plain");
     } });
 
+    _svr.Post("/gen_warehouse", [&](const httplib::Request &req, httplib::Response &res)
+              {
+    try {
+        // Warehouse template, the station spacings are optional
+        graph::WarehouseLayout layout;
+        layout.num_aisles = std::stoi(req.get_param_value("num_aisles"));
+        layout.aisle_length = std::stoi(req.get_param_value("aisle_length"));
+        layout.rack_depth = std::stoi(req.get_param_value("rack_depth"));
+        layout.cross_aisle_spacing = std::stoi(req.get_param_value("cross_aisle_spacing"));
+        if (req.has_param("pickdrop_spacing"))
+            layout.pickdrop_spacing = std::stoi(req.get_param_value("pickdrop_spacing"));
+        if (req.has_param("charging_spacing"))
+            layout.charging_spacing = std::stoi(req.get_param_value("charging_spacing"));
+        if (req.has_param("waiting_spacing"))
+            layout.waiting_spacing = std::stoi(req.get_param_value("waiting_spacing"));
+        auto backend = req.get_param_value("backend") == "bitset" ? graph::AdjacencyBackend::bitset : graph::AdjacencyBackend::csr;
+
+        auto start = std::chrono::steady_clock::now();
+        if (req.has_param("path"))
+        {
+            // Streamed straight into a graph file for /load_graph, maps larger than the memory never get built here.
+            // The file is truncated first, so the path must stay inside the maps directory
+            std::string path;
+            if (!resolveMapPath(req, path) || !graph::WarehouseGraph::genWarehouseFile(layout, path))
+            {
+                throw std::invalid_argument("path");
+            }
+            std::cout << "Warehouse file written in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+            res.status = 200;
+            return;
+        }
+        auto graph = std::make_shared<graph::WarehouseGraph>();
+        if (!graph->genWarehouseGraph(layout, backend))
+        {
+            throw std::invalid_argument("layout");
+        }
+        std::cout << "Warehouse: " << graph->getNumNodes() << " nodes generated in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+        prepareGraph(*graph);
+        std::lock_guard<std::mutex> lock(_publish_mutex);
+        _graphs->publish(std::move(graph));
+        res.status = 200;
+    } catch (const std::exception &e) {
+        res.status = 400;
+        res.set_content("Invalid parameters", "text/plain");
+    } });
+
+    _svr.Post("/load_graph", [&](const httplib::Request &req, httplib::Response &res)
+              {
+    // Maps a graph file written by /save_graph or /gen_warehouse, its stored indexes are used as they are
+    auto start = std::chrono::steady_clock::now();
+    auto graph = std::make_shared<graph::Graph>();
+    std::string path;
+    if (!resolveMapPath(req, path) || !graph->loadFromFile(path))
+    {
+        res.status = 400;
+        res.set_content("Invalid graph file", "text/plain");
+        return;
+    }
+    std::cout << "Graph file: " << graph->getNumNodes() << " nodes loaded in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+    prepareGraph(*graph);
+    std::lock_guard<std::mutex> lock(_publish_mutex);
+    _graphs->publish(std::move(graph));
+    res.status = 200; });
+
+    _svr.Post("/import_map", [&](const httplib::Request &req, httplib::Response &res)
+              {
+    // Floor plan given as a grid map or, for .csv files, as a node/edge list, read from the maps directory
+    auto start = std::chrono::steady_clock::now();
+    auto graph = std::make_shared<graph::ImportedGraph>();
+    std::string path;
+    if (!resolveMapPath(req, path) || !graph->importFile(path))
+    {
+        res.status = 400;
+        res.set_content("Invalid map file (line " + std::to_string(graph->getErrorLine()) + ")", "text/plain");
+        return;
+    }
+    std::cout << "Map file: " << graph->getNumNodes() << " nodes imported in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+    prepareGraph(*graph);
+    std::lock_guard<std::mutex> lock(_publish_mutex);
+    _graphs->publish(std::move(graph));
+    res.status = 200; });
+
+    // Map edits, nodes are named by their identifiers
+    _svr.Post("/add_node", [&](const httplib::Request &req, httplib::Response &res)
+              {
+    try {
+        auto id = std::stoi(req.get_param_value("id"));
+        auto x = std::stoi(req.get_param_value("x"));
+        auto y = std::stoi(req.get_param_value("y"));
+        graph::Property prop = graph::Property::node;
+        if (req.has_param("p") && !graph::getPropertyFromName(req.get_param_value("p"), prop))
+        {
+            throw std::invalid_argument("p");
+        }
+        editGraph([&](graph::Graph &graph)
+                  { return graph.addNode(id, x, y, prop) != -1; }, res);
+    } catch (const std::exception &e) {
+        res.status = 400;
+        res.set_content("Invalid parameters", "text/plain");
+    } });
+
+    _svr.Post("/remove_node", [&](const httplib::Request &req, httplib::Response &res)
+              {
+    try {
+        auto id = std::stoi(req.get_param_value("id"));
+        editGraph([&](graph::Graph &graph)
+                  { return graph.removeNode(graph.getNodeIndex(id)); }, res);
+    } catch (const std::exception &e) {
+        res.status = 400;
+        res.set_content("Invalid parameters", "text/plain");
+    } });
+
+    _svr.Post("/add_edge", [&](const httplib::Request &req, httplib::Response &res)
+              {
+    try {
+        auto n1 = std::stoi(req.get_param_value("n1"));
+        auto n2 = std::stoi(req.get_param_value("n2"));
+        auto weight = req.has_param("weight") ? std::stoi(req.get_param_value("weight")) : -1;
+        editGraph([&](graph::Graph &graph)
+                  { return graph.addEdge(graph.getNodeIndex(n1), graph.getNodeIndex(n2), weight); }, res);
+    } catch (const std::exception &e) {
+        res.status = 400;
+        res.set_content("Invalid parameters", "text/plain");
+    } });
+
+    _svr.Post("/remove_edge", [&](const httplib::Request &req, httplib::Response &res)
+              {
+    try {
+        auto n1 = std::stoi(req.get_param_value("n1"));
+        auto n2 = std::stoi(req.get_param_value("n2"));
+        editGraph([&](graph::Graph &graph)
+                  { return graph.removeEdge(graph.getNodeIndex(n1), graph.getNodeIndex(n2)); }, res);
+    } catch (const std::exception &e) {
+        res.status = 400;
+        res.set_content("Invalid parameters", "text/plain");
+    } });
+
+    _svr.Post("/save_graph", [&](const httplib::Request &req, httplib::Response &res)
+              {
+    // Only written under MAPS_DIRECTORY, like every path a request names
+    std::string path;
+    if (!resolveMapPath(req, path) || !_graphs->load()->saveToFile(path))
+    {
+        res.status = 400;
+        res.set_content("Cannot write the graph file", "text/plain");
+        return;
+    }
+    res.status = 200; });
+
     _svr.Post("/add_robot", [&](const httplib::Request &req, httplib::Response &res)
               {
     try {
@@ -80,6 +264,11 @@ namespace web
               {
     try {
         auto num_tasks = std::stoi(req.get_param_value("num_tasks"));
+        // Optional seed, replays the same pick and drop nodes on the same graph
+        if (req.has_param("seed"))
+        {
+            _tasks_manager->seed(std::stoull(req.get_param_value("seed")));
+        }
         _tasks_manager->addRandomTasks(num_tasks);
         res.status = 200;
     } catch (const std::exception &e) {
@@ -97,10 +286,17 @@ namespace web
     _svr.Get("/graph", [&](const httplib::Request &req, httplib::Response &res)
              {
     (void)req;
-    std::string graph_json = _graph->getToJson();
+    std::string graph_json = _graphs->load()->getToJson();
     res.set_content(graph_json, "application/json");
     res.status = 200; });
 
+    _svr.Get("/path_cache", [&](const httplib::Request &req, httplib::Response &res)
+             {
+    (void)req;
+    std::string cache_json = _graphs->load()->getPathCache().getToJson();
+    res.set_content(cache_json, "application/json");
+    res.status = 200; });
+
     _svr.Get("/robots", [&](const httplib::Request &req, httplib::Response &res)
              {
     (void)req;
@@ -137,6 +333,74 @@ namespace web
           } });
   }
 
+  bool Server::resolveMapPath(const httplib::Request &req, std::string &path)
+  {
+    if (!req.has_param("path"))
+    {
+      return false;
+    }
+    const std::filesystem::path relative(req.get_param_value("path"));
+    if (relative.empty() || relative.has_root_name() || relative.has_root_directory())
+    {
+      return false;
+    }
+    for (const auto &component : relative)
+    {
+      if (component == "..")
+      {
+        return false;
+      }
+    }
+    path = (std::filesystem::path(MAPS_DIRECTORY) / relative).string();
+    return true;
+  }
+
+  void Server::prepareGraph(graph::Graph &graph)
+  {
+    // Large graphs get a contraction hierarchy instead of the quadratic routing table
+    if (!graph.buildRoutingTable())
+    {
+      if (!graph.getLandmarks())
+      {
+        graph.buildLandmarks();
+      }
+      if (!graph.getContractionHierarchy())
+      {
+        graph.buildContractionHierarchy();
+      }
+      const auto *hierarchy = graph.getContractionHierarchy();
+      std::cout << "Contraction hierarchy: " << hierarchy->getNumShortcuts() << " shortcuts built in "
+                << hierarchy->getBuildTime() << " ms" << std::endl;
+      // Robots plan on the cluster graph and refine their routes while moving
+      graph.buildHierarchy();
+      auto clusters = graph.getHierarchy();
+      std::cout << "Cluster graph: " << clusters->getNumClusters() << " clusters, " << clusters->getNumEntrances()
+                << " entrances built in " << clusters->getBuildTime() << " ms" << std::endl;
+    }
+  }
+
+  void Server::editGraph(const std::function<bool(graph::Graph &)> &edit, httplib::Response &res)
+  {
+    std::lock_guard<std::mutex> lock(_publish_mutex);
+    auto start = std::chrono::steady_clock::now();
+    auto graph = std::make_shared<graph::Graph>(*_graphs->load());
+    if (!edit(*graph))
+    {
+      res.status = 400;
+      res.set_content("Invalid edit", "text/plain");
+      return;
+    }
+    // Edge edits repair the routing structures in place, node edits drop those sized by the node count
+    if (!graph->getRoutingTable() && !graph->buildRoutingTable() && !graph->getHierarchy())
+    {
+      graph->buildHierarchy();
+    }
+    std::cout << "Graph edit applied in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+    _graphs->publish(std::move(graph));
+    res.status = 200;
+  }
+
   void Server::listen()
   {
     std::cout << "Server is listening on port " << _port << std::endl;
@@ -0,0 +1,1274 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <limits>
+#include <thread>
+#include "graph.hpp"
+#include "contractionhierarchy.hpp"
+#include "distancefield.hpp"
+#include "graphfile.hpp"
+#include "graphstore.hpp"
+#include "hierarchicalgraph.hpp"
+#include "importedgraph.hpp"
+#include "landmarks.hpp"
+#include "randomgraph.hpp"
+#include "routingtable.hpp"
+#include "warehousegraph.hpp"
+
+namespace
+{
+    // Graph exposing the builder so tests can lay out small maps by hand
+    class TestGraph : public graph::Graph
+    {
+    public:
+        using graph::Graph::_addEdge;
+        using graph::Graph::_addNode;
+        using graph::Graph::_freeze;
+    };
+
+    // Builds a width x height lattice, every node connected to its right and down neighbours
+    void buildLattice(TestGraph &g, int width, int height)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                g._addNode(y * width + x, x * SCALE, y * SCALE, graph::Property::node);
+            }
+        }
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                if (x + 1 < width)
+                    g._addEdge(y * width + x, y * width + x + 1);
+                if (y + 1 < height)
+                    g._addEdge(y * width + x, (y + 1) * width + x);
+            }
+        }
+        g._freeze();
+    }
+} // namespace
+
+TEST(GraphCsr, FreezeBuildsSortedDeduplicatedRows) {
+    TestGraph g;
+    for (int i = 0; i < 4; ++i)
+        g._addNode(i, i * SCALE, 0, graph::Property::node);
+    g._addEdge(0, 2);
+    g._addEdge(0, 1);
+    g._addEdge(1, 0); // Duplicate in the other direction
+    g._addEdge(2, 3);
+
+    EXPECT_EQ(g.isEdge(0, 1), 1); // Visible before the freeze
+    g._freeze();
+
+    auto row = g.getNeighbours(0);
+    ASSERT_EQ(row.size(), 2u);
+    EXPECT_EQ(row[0], 1);
+    EXPECT_EQ(row[1], 2);
+    EXPECT_EQ(g.getNumEdges(), 3);
+    EXPECT_EQ(g.isEdge(3, 2), 1);
+    EXPECT_EQ(g.isEdge(1, 3), 0);
+    EXPECT_EQ(g.isEdge(-1, 3), 0);
+
+    // Edges added after a freeze are merged into the existing rows
+    g._addEdge(1, 3);
+    g._freeze();
+    EXPECT_EQ(g.isEdge(3, 1), 1);
+    EXPECT_EQ(g.getNumEdges(), 4);
+}
+
+TEST(GraphCsr, ShortestPathOnLattice) {
+    TestGraph g;
+    buildLattice(g, 5, 4);
+
+    auto path = g.getShortestPath(0, 19);
+    ASSERT_EQ(path.size(), 8u); // 4 steps right and 3 steps down
+    EXPECT_EQ(path.front(), 0);
+    EXPECT_EQ(path.back(), 19);
+    for (std::size_t k = 0; k + 1 < path.size(); ++k)
+        EXPECT_EQ(g.isEdge(path[k], path[k + 1]), 1);
+
+    EXPECT_EQ(g.getShortestPath(7, 7), std::vector<int>{7});
+    EXPECT_TRUE(g.getShortestPath(0, 42).empty());
+}
+
+TEST(GraphCsr, UnreachableNodeGivesEmptyPath) {
+    TestGraph g;
+    g._addNode(0, 0, 0, graph::Property::node);
+    g._addNode(1, SCALE, 0, graph::Property::node);
+    g._addNode(2, 5 * SCALE, 0, graph::Property::node);
+    g._addEdge(0, 1);
+    g._freeze();
+
+    EXPECT_TRUE(g.getShortestPath(0, 2).empty());
+}
+
+TEST(GraphCsr, WorkspaceIsReusedAcrossQueries) {
+    TestGraph g;
+    buildLattice(g, 6, 6);
+
+    graph::SearchWorkspace workspace;
+    std::vector<int> path;
+    ASSERT_TRUE(g.getShortestPath(0, 35, workspace, path));
+    EXPECT_EQ(path.size(), 11u);
+    const int *buffer = path.data();
+
+    // Later queries reuse the buffers and never see marks of earlier searches
+    for (int target = 34; target >= 0; --target)
+    {
+        ASSERT_TRUE(g.getShortestPath(35, target, workspace, path));
+        EXPECT_EQ(path, g.getShortestPath(35, target));
+    }
+    EXPECT_EQ(path.data(), buffer);
+    EXPECT_FALSE(g.getShortestPath(0, 36, workspace, path));
+    EXPECT_TRUE(path.empty());
+}
+
+TEST(GraphSearch, AStarMatchesBfsAndExpandsLess) {
+    TestGraph g;
+    buildLattice(g, 60, 60);
+
+    graph::SearchWorkspace bfs_workspace, astar_workspace;
+    std::vector<int> bfs_path, astar_path;
+    ASSERT_TRUE(g.getShortestPath(1800, 1859, bfs_workspace, bfs_path, graph::SearchAlgorithm::bfs));
+    ASSERT_TRUE(g.getShortestPath(1800, 1859, astar_workspace, astar_path, graph::SearchAlgorithm::astar));
+    EXPECT_EQ(astar_path.size(), bfs_path.size());
+    EXPECT_LT(astar_workspace.getExpanded() * 10, bfs_workspace.getExpanded());
+
+    graph::RandomGraph r;
+    r.genRandomGraph(300, 10, 10, 20);
+    for (int i = 0; i < r.getNumNodes(); i += 7)
+    {
+        for (int j = 0; j < r.getNumNodes(); j += 11)
+        {
+            ASSERT_EQ(r.getShortestPath(i, j, graph::SearchAlgorithm::astar).size(),
+                      r.getShortestPath(i, j, graph::SearchAlgorithm::bfs).size());
+        }
+    }
+}
+
+TEST(GraphRoutingTable, MatchesBfs) {
+    graph::RandomGraph g;
+    g.genRandomGraph(300, 10, 10, 20);
+    ASSERT_TRUE(g.buildRoutingTable());
+    const graph::RoutingTable *table = g.getRoutingTable();
+    ASSERT_NE(table, nullptr);
+    EXPECT_GE(table->getMemoryUsage(), 4u * g.getNumNodes() * g.getNumNodes());
+
+    std::vector<int> path;
+    for (int i = 0; i < g.getNumNodes(); i += 3)
+    {
+        for (int j = 0; j < g.getNumNodes(); j += 5)
+        {
+            auto bfs_path = g.getShortestPath(i, j, graph::SearchAlgorithm::bfs);
+            ASSERT_TRUE(table->getPath(i, j, path));
+            ASSERT_EQ(path.size(), bfs_path.size());
+            ASSERT_EQ(g.getDistance(i, j), static_cast<int>(bfs_path.size()) - 1);
+            for (std::size_t k = 0; k + 1 < path.size(); ++k)
+                ASSERT_EQ(g.isEdge(path[k], path[k + 1]), 1);
+        }
+    }
+
+    g.clear();
+    EXPECT_EQ(g.getRoutingTable(), nullptr);
+}
+
+TEST(GraphPathCache, HitsMissesAndEpochInvalidation) {
+    graph::PathCache cache(2 * PATH_CACHE_SHARDS);
+    std::vector<int> path;
+
+    EXPECT_FALSE(cache.find(1, 0, 5, 0, path));
+    cache.insert(1, 0, 5, 0, {0, 3, 5});
+    ASSERT_TRUE(cache.find(1, 0, 5, 0, path));
+    EXPECT_EQ(path, (std::vector<int>{0, 3, 5}));
+    EXPECT_FALSE(cache.find(1, 0, 5, 1, path)); // Another engine is another entry
+
+    // A newer epoch drops the routes and older inserts are ignored
+    EXPECT_FALSE(cache.find(2, 0, 5, 0, path));
+    cache.insert(1, 0, 5, 0, {0, 3, 5});
+    EXPECT_FALSE(cache.find(2, 0, 5, 0, path));
+    EXPECT_EQ(cache.getHits(), 1u);
+    EXPECT_EQ(cache.getMisses(), 4u);
+
+    for (int j = 0; j < 1000; ++j)
+        cache.insert(2, 1, j, 0, {1, j});
+    EXPECT_EQ(cache.getSize(), cache.getCapacity());
+    EXPECT_EQ(cache.getEvictions(), 1000u - cache.getCapacity());
+
+    // Recycled entries answer for their new key only
+    ASSERT_TRUE(cache.find(2, 1, 999, 0, path));
+    EXPECT_EQ(path, (std::vector<int>{1, 999}));
+    EXPECT_FALSE(cache.find(2, 1, 0, 0, path));
+}
+
+TEST(GraphPathCache, RegeneratedGraphNeverServesStaleRoutes) {
+    graph::RandomGraph g;
+    g.genRandomGraph(100, 5, 5, 10);
+    auto first = g.getShortestPath(0, g.getNumNodes() - 1);
+    EXPECT_EQ(g.getShortestPath(0, g.getNumNodes() - 1), first);
+    EXPECT_EQ(g.getPathCache().getHits(), 1u);
+
+    // Bypassing the cache neither reads nor records the route
+    graph::SearchWorkspace workspace;
+    std::vector<int> path;
+    ASSERT_TRUE(g.getShortestPath(0, g.getNumNodes() - 1, workspace, path, graph::SearchAlgorithm::bfs, false));
+    EXPECT_EQ(path, first);
+    EXPECT_EQ(g.getPathCache().getHits(), 1u);
+    EXPECT_EQ(g.getPathCache().getMisses(), 1u);
+
+    auto epoch = g.getEpoch();
+    g.genRandomGraph(100, 5, 5, 10);
+    EXPECT_GT(g.getEpoch(), epoch);
+
+    auto second = g.getShortestPath(0, g.getNumNodes() - 1);
+    EXPECT_EQ(g.getPathCache().getHits(), 1u); // Recomputed on the new graph
+    ASSERT_FALSE(second.empty());
+    for (std::size_t k = 0; k + 1 < second.size(); ++k)
+        EXPECT_EQ(g.isEdge(second[k], second[k + 1]), 1);
+}
+
+TEST(GraphWeighted, DijkstraAndAStarFindTheCheapestRoute) {
+    // A 10 x 10 lattice where the edges of every third row are five times slower
+    TestGraph g;
+    const int width = 10;
+    for (int k = 0; k < width * width; ++k)
+        g._addNode(k, (k % width) * SCALE, (k / width) * SCALE, graph::Property::node);
+    for (int k = 0; k < width * width; ++k)
+    {
+        int slow = (k / width) % 3 == 0 ? 5 : 1;
+        if (k % width + 1 < width)
+            g._addEdge(k, k + 1, slow * SCALE);
+        if (k / width + 1 < width)
+            g._addEdge(k, k + width);
+    }
+    g._freeze();
+    EXPECT_EQ(g.getEdgeWeight(0, 1), 5 * SCALE);
+    EXPECT_EQ(g.getEdgeWeight(0, 10), SCALE);
+    EXPECT_EQ(g.getEdgeWeight(0, 11), -1);
+    EXPECT_FALSE(g.buildRoutingTable()); // Hops do not rank routes on mixed weights
+
+    // Reference costs from Bellman-Ford relaxations
+    std::vector<int> reference(width * width, std::numeric_limits<int>::max());
+    reference[0] = 0;
+    for (int round = 0; round < width * width; ++round)
+        for (int k = 0; k < width * width; ++k)
+            for (std::size_t e = 0; e < g.getNeighbours(k).size(); ++e)
+                if (reference[k] != std::numeric_limits<int>::max())
+                    reference[g.getNeighbours(k)[e]] = std::min(reference[g.getNeighbours(k)[e]], reference[k] + g.getEdgeWeights(k)[e]);
+
+    for (int target = 0; target < width * width; ++target)
+    {
+        EXPECT_EQ(g.getPathCost(g.getShortestPath(0, target, graph::SearchAlgorithm::dijkstra)), reference[target]);
+        EXPECT_EQ(g.getPathCost(g.getShortestPath(0, target, graph::SearchAlgorithm::astar)), reference[target]);
+    }
+    EXPECT_EQ(g.getPathCost(std::vector<int>{0, 11}), -1);
+
+    // The cheapest route to 3 goes through the next row, the fewest hops stay on the slow one
+    EXPECT_EQ(g.getShortestPath(0, 3, graph::SearchAlgorithm::automatic).size(), 6u);
+    EXPECT_EQ(g.getDistance(0, 3), 3);
+}
+
+TEST(GraphWeighted, RadixHeapPopsInKeyOrder) {
+    graph::RadixHeap heap;
+    heap.clear();
+    for (int k : {40, 7, 7, 300, 12, 1000000})
+        heap.push(k, static_cast<std::uint32_t>(k));
+
+    std::uint32_t key, previous = 0;
+    int popped = 0;
+    while (!heap.empty())
+    {
+        int item = heap.pop(key);
+        EXPECT_EQ(static_cast<std::uint32_t>(item), key);
+        EXPECT_GE(key, previous);
+        previous = key;
+        if (++popped == 2)
+            heap.push(9, 9); // Monotone insert after some pops
+    }
+    EXPECT_EQ(popped, 7);
+}
+
+TEST(GraphContractionHierarchy, MatchesDijkstra) {
+    // Lattice with a few missing edges and varied travel times
+    TestGraph g;
+    const int width = 30;
+    for (int k = 0; k < width * width; ++k)
+        g._addNode(k, (k % width) * SCALE, (k / width) * SCALE, graph::Property::node);
+    for (int k = 0; k < width * width; ++k)
+    {
+        if (k % width + 1 < width && k % 7 != 3)
+            g._addEdge(k, k + 1, SCALE + (k * 37) % 90);
+        if (k / width + 1 < width && k % 11 != 5)
+            g._addEdge(k, k + width, SCALE + (k * 53) % 70);
+    }
+    g._freeze();
+    g.buildContractionHierarchy();
+    const graph::ContractionHierarchy *hierarchy = g.getContractionHierarchy();
+    ASSERT_NE(hierarchy, nullptr);
+    EXPECT_GT(hierarchy->getNumShortcuts(), 0);
+    EXPECT_GE(hierarchy->getBuildTime(), 0.0);
+
+    for (int i = 0; i < width * width; i += 13)
+    {
+        for (int j = 0; j < width * width; j += 17)
+        {
+            auto reference = g.getShortestPath(i, j, graph::SearchAlgorithm::dijkstra);
+            auto path = g.getShortestPath(i, j, graph::SearchAlgorithm::contraction_hierarchy);
+            ASSERT_EQ(path.empty(), reference.empty());
+            if (path.empty())
+                continue;
+            EXPECT_EQ(path.front(), i);
+            EXPECT_EQ(path.back(), j);
+            ASSERT_EQ(g.getPathCost(path), g.getPathCost(reference)) << i << " -> " << j;
+        }
+    }
+}
+
+TEST(GraphBitset, DirectionOptimizingBfsMatchesCsr) {
+    // Dense layout: every node linked to a fixed pseudo-random set of others, plus a sparse tail
+    TestGraph g;
+    const int num_nodes = 300;
+    for (int k = 0; k < num_nodes; ++k)
+        g._addNode(k, (k % 20) * SCALE, (k / 20) * SCALE, graph::Property::node);
+    for (int k = 0; k < 200; ++k)
+        for (int step = 1; step <= 40; ++step)
+            g._addEdge(k, (k * 7 + step * 13) % 200);
+    for (int k = 200; k < num_nodes - 1; ++k)
+        g._addEdge(k, k + 1);
+    g._addEdge(0, 200);
+    g._freeze();
+
+    std::vector<int> expected;
+    for (int target = 0; target < num_nodes; ++target)
+        expected.push_back(static_cast<int>(g.getShortestPath(5, target).size()));
+
+    ASSERT_TRUE(g.setAdjacencyBackend(graph::AdjacencyBackend::bitset));
+    EXPECT_EQ(g.getAdjacencyBackend(), graph::AdjacencyBackend::bitset);
+    g.getPathCache().clear();
+    graph::SearchWorkspace workspace;
+    std::vector<int> path;
+    for (int target = 0; target < num_nodes; ++target)
+    {
+        ASSERT_TRUE(g.getShortestPath(5, target, workspace, path));
+        EXPECT_EQ(static_cast<int>(path.size()), expected[target]);
+        EXPECT_EQ(path.front(), 5);
+        EXPECT_EQ(path.back(), target);
+        for (std::size_t k = 0; k + 1 < path.size(); ++k)
+            ASSERT_EQ(g.isEdge(path[k], path[k + 1]), 1);
+    }
+    EXPECT_EQ(g.isEdge(0, 200), 1);
+    EXPECT_EQ(g.isEdge(0, 201), 0);
+
+    // Nodes added after the freeze have no bit row yet, the CSR store answers for them
+    g._addNode(num_nodes, 0, -SCALE, graph::Property::node);
+    g._addEdge(num_nodes, 0);
+    EXPECT_EQ(g.isEdge(num_nodes, 0), 1);
+    g._freeze();
+    EXPECT_EQ(static_cast<int>(g.getShortestPath(num_nodes, 5).size()), expected[0] + 1);
+}
+
+TEST(GraphLandmarks, AltMatchesDijkstraAndSettlesLessOnAWindingMap) {
+    // Corridors four rows tall, separated by walls with a single gap at alternating ends, so the straight line misleads A*
+    TestGraph g;
+    const int width = 40;
+    const int height = 24;
+    for (int k = 0; k < width * height; ++k)
+        g._addNode(k, (k % width) * SCALE, (k / width) * SCALE, graph::Property::node);
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            if (x + 1 < width)
+                g._addEdge(y * width + x, y * width + x + 1);
+            bool wall = (y + 1) % 4 == 0;
+            int gap = (y / 4) % 2 == 0 ? width - 1 : 0;
+            if (y + 1 < height && (!wall || x == gap))
+                g._addEdge(y * width + x, (y + 1) * width + x);
+        }
+    }
+    g._freeze();
+    g.buildLandmarks();
+    ASSERT_NE(g.getLandmarks(), nullptr);
+    EXPECT_LE(g.getLandmarks()->getLandmarks().size(), static_cast<std::size_t>(ALT_NUM_LANDMARKS));
+
+    graph::SearchWorkspace workspace;
+    std::vector<int> path;
+    int alt_expanded = 0;
+    int astar_expanded = 0;
+    for (int source : {0, 5 * width + 3, 12 * width + 30})
+    {
+        for (int target : {4 * width, 23 * width + 39, 9 * width + 20})
+        {
+            ASSERT_TRUE(g.getShortestPath(source, target, workspace, path, graph::SearchAlgorithm::dijkstra));
+            const int expected = g.getPathCost(path);
+
+            ASSERT_TRUE(g.getShortestPath(source, target, workspace, path, graph::SearchAlgorithm::alt));
+            EXPECT_EQ(g.getPathCost(path), expected);
+            alt_expanded += workspace.getExpanded();
+
+            ASSERT_TRUE(g.getShortestPath(source, target, workspace, path, graph::SearchAlgorithm::astar));
+            astar_expanded += workspace.getExpanded();
+        }
+    }
+    EXPECT_LT(alt_expanded * 2, astar_expanded);
+}
+
+TEST(GraphJumpPoint, MatchesBfsWithMissingLinksAndNodes) {
+    // 24 x 24 lattice with pseudo-random holes and missing links between adjacent nodes
+    TestGraph g;
+    const int width = 24;
+    std::vector<int> index(width * width, -1);
+    unsigned state = 12345;
+    auto next_random = [&state]()
+    {
+        state = state * 1103515245u + 12345u;
+        return (state >> 16) % 100;
+    };
+    int num_nodes = 0;
+    for (int k = 0; k < width * width; ++k)
+    {
+        if (next_random() < 10)
+            continue; // Hole
+        index[k] = num_nodes;
+        g._addNode(num_nodes++, (k % width) * SCALE, (k / width) * SCALE, graph::Property::node);
+    }
+    for (int k = 0; k < width * width; ++k)
+    {
+        if (index[k] == -1)
+            continue;
+        if (k % width + 1 < width && index[k + 1] != -1 && next_random() >= 20)
+            g._addEdge(index[k], index[k + 1]);
+        if (k + width < width * width && index[k + width] != -1 && next_random() >= 20)
+            g._addEdge(index[k], index[k + width]);
+    }
+    g._freeze();
+    ASSERT_TRUE(g.isLattice());
+
+    graph::SearchWorkspace workspace;
+    std::vector<int> path;
+    for (int source = 0; source < num_nodes; source += 7)
+    {
+        for (int target = 0; target < num_nodes; target += 5)
+        {
+            auto expected = g.getShortestPath(source, target, graph::SearchAlgorithm::bfs);
+            bool found = g.getShortestPath(source, target, workspace, path, graph::SearchAlgorithm::jump_point);
+            ASSERT_EQ(found, !expected.empty());
+            if (!found)
+                continue;
+            ASSERT_EQ(path.size(), expected.size()) << source << " -> " << target;
+            EXPECT_EQ(path.front(), source);
+            EXPECT_EQ(path.back(), target);
+            for (std::size_t k = 0; k + 1 < path.size(); ++k)
+                ASSERT_EQ(g.isEdge(path[k], path[k + 1]), 1);
+        }
+    }
+}
+
+TEST(GraphJumpPoint, OpenLatticeExpandsFewerNodesThanAStar) {
+    TestGraph g;
+    buildLattice(g, 60, 60);
+    graph::SearchWorkspace workspace;
+    std::vector<int> path;
+
+    ASSERT_TRUE(g.getShortestPath(0, 60 * 60 - 1, workspace, path, graph::SearchAlgorithm::jump_point));
+    EXPECT_EQ(path.size(), 119u);
+    const int jump_expanded = workspace.getExpanded();
+    ASSERT_TRUE(g.getShortestPath(0, 60 * 60 - 1, workspace, path, graph::SearchAlgorithm::astar));
+    EXPECT_LT(jump_expanded * 10, workspace.getExpanded());
+
+    // Non-lattice graphs fall back to A*
+    TestGraph line;
+    line._addNode(0, 0, 0, graph::Property::node);
+    line._addNode(1, 3 * SCALE, 0, graph::Property::node);
+    line._addEdge(0, 1);
+    line._freeze();
+    EXPECT_FALSE(line.isLattice());
+    EXPECT_EQ(line.getShortestPath(0, 1, graph::SearchAlgorithm::jump_point).size(), 2u);
+}
+
+TEST(GraphHierarchy, ClusterRoutesMatchDijkstraAndRefineSegmentBySegment) {
+    // 45 x 45 lattice with pseudo-random missing links, cut into clusters of 10 x 10 cells
+    TestGraph g;
+    const int width = 45;
+    for (int k = 0; k < width * width; ++k)
+        g._addNode(k, (k % width) * SCALE, (k / width) * SCALE, graph::Property::node);
+    unsigned state = 99;
+    auto next_random = [&state]()
+    {
+        state = state * 1103515245u + 12345u;
+        return (state >> 16) % 100;
+    };
+    for (int k = 0; k < width * width; ++k)
+    {
+        if (k % width + 1 < width && next_random() >= 35)
+            g._addEdge(k, k + 1, 1 + next_random() % 3 * SCALE);
+        if (k + width < width * width && next_random() >= 35)
+            g._addEdge(k, k + width, 1 + next_random() % 3 * SCALE);
+    }
+    g._freeze();
+    g.buildHierarchy(10);
+    auto hierarchy = g.getHierarchy();
+    ASSERT_NE(hierarchy, nullptr);
+    EXPECT_EQ(hierarchy->getNumClusters(), 25);
+
+    graph::SearchWorkspace workspace;
+    std::vector<int> expected;
+    std::vector<int> path;
+    std::vector<int> waypoints;
+    for (int source = 0; source < width * width; source += 97)
+    {
+        for (int target = 11; target < width * width; target += 131)
+        {
+            bool found = g.getShortestPath(source, target, workspace, expected, graph::SearchAlgorithm::dijkstra);
+            ASSERT_EQ(g.getShortestPath(source, target, workspace, path, graph::SearchAlgorithm::hierarchical), found);
+            if (!found)
+                continue;
+            EXPECT_EQ(g.getPathCost(path), g.getPathCost(expected));
+
+            // Refining the abstract route one segment at a time gives the same route
+            ASSERT_TRUE(hierarchy->getAbstractPath(source, target, waypoints));
+            EXPECT_LT(waypoints.size(), path.size() + 1);
+            std::vector<int> lazy{source};
+            for (std::size_t k = 1; k < waypoints.size(); ++k)
+                ASSERT_TRUE(hierarchy->refineSegment(waypoints[k - 1], waypoints[k], lazy));
+            EXPECT_EQ(lazy, path);
+        }
+    }
+}
+
+TEST(GraphBatch, MatchesSingleQueries) {
+    TestGraph g;
+    buildLattice(g, 30, 30);
+    g._addEdge(0, 899, 7 * SCALE); // A long but fast shortcut across the map
+    g._freeze();
+
+    // Several queries per source, in shuffled order, with a repeated target and invalid ones
+    std::vector<std::pair<int, int>> queries;
+    for (int k = 0; k < 120; ++k)
+        queries.emplace_back((k * 37) % 5 * 101, (k * 53) % 900);
+    queries.emplace_back(101, 101);
+    queries.emplace_back(-1, 3);
+    queries.emplace_back(3, 900);
+
+    std::vector<int> costs(queries.size());
+    graph::BatchPaths paths;
+    g.getShortestPaths(queries, costs, &paths);
+    ASSERT_EQ(paths.offsets.size(), queries.size() + 1);
+
+    graph::SearchWorkspace workspace;
+    std::vector<int> expected;
+    for (std::size_t k = 0; k < queries.size(); ++k)
+    {
+        auto [source, target] = queries[k];
+        bool found = g.getShortestPath(source, target, workspace, expected, graph::SearchAlgorithm::dijkstra);
+        EXPECT_EQ(costs[k], found ? g.getPathCost(expected) : -1);
+
+        std::vector<int> route(paths.nodes.begin() + paths.offsets[k], paths.nodes.begin() + paths.offsets[k + 1]);
+        EXPECT_EQ(route.empty(), !found);
+        if (found)
+        {
+            EXPECT_EQ(route.front(), source);
+            EXPECT_EQ(route.back(), target);
+            EXPECT_EQ(g.getPathCost(route), costs[k]);
+        }
+    }
+}
+
+TEST(GraphNodes, ArraysViewsAndPropertyLists) {
+    TestGraph g;
+    g._addNode(10, 0, 0, graph::Property::pickdrop);
+    g._addNode(11, SCALE, 0, graph::Property::node);
+    g._addNode(12, 2 * SCALE, 0, graph::Property::charging);
+    g._addNode(13, 2 * SCALE, SCALE, graph::Property::pickdrop);
+    g._freeze();
+
+    graph::Node node = g.getNode(3);
+    EXPECT_EQ(node.getId(), 13);
+    EXPECT_EQ(node.getX(), 2 * SCALE);
+    EXPECT_EQ(node.getY(), SCALE);
+    EXPECT_EQ(node.getProperty(), graph::Property::pickdrop);
+    EXPECT_EQ(g.getXs()[2], 2 * SCALE);
+    EXPECT_EQ(g.getYs()[2], 0);
+
+    auto pickdrop = g.getNodesWith(graph::Property::pickdrop);
+    ASSERT_EQ(pickdrop.size(), 2u);
+    EXPECT_EQ(pickdrop[0], 0);
+    EXPECT_EQ(pickdrop[1], 3);
+    EXPECT_EQ(g.getNodesWith(graph::Property::charging).size(), 1u);
+    EXPECT_TRUE(g.getNodesWith(graph::Property::waiting).empty());
+
+    // The graph JSON matches the per-node serialisation
+    EXPECT_NE(g.getToJson().find(node.getToJson()), std::string::npos);
+
+    g.clear();
+    EXPECT_TRUE(g.getNodesWith(graph::Property::pickdrop).empty());
+}
+
+TEST(GraphDistanceField, MatchesPerCandidateSearchAndFollowsEpoch) {
+    // 8 x 8 lattice without its middle column links, charging stations in two corners
+    TestGraph g;
+    const int width = 8;
+    for (int k = 0; k < width * width; ++k)
+    {
+        bool charging = k == 0 || k == width * width - 1;
+        g._addNode(k, (k % width) * SCALE, (k / width) * SCALE, charging ? graph::Property::charging : graph::Property::node);
+    }
+    for (int k = 0; k < width * width; ++k)
+    {
+        if (k % width + 1 < width && k % width != 3)
+            g._addEdge(k, k + 1);
+        if (k + width < width * width)
+            g._addEdge(k, k + width);
+    }
+    g._freeze();
+
+    auto field = g.getDistanceField(graph::Property::charging);
+    std::vector<int> path;
+    for (int node = 0; node < width * width; ++node)
+    {
+        int best = std::numeric_limits<int>::max();
+        for (int station : g.getNodesWith(graph::Property::charging))
+        {
+            auto route = g.getShortestPath(node, station);
+            if (!route.empty())
+                best = std::min(best, static_cast<int>(route.size()) - 1);
+        }
+        EXPECT_EQ(field->getDistance(node), best);
+
+        ASSERT_TRUE(field->getPath(node, path));
+        EXPECT_EQ(static_cast<int>(path.size()) - 1, best);
+        EXPECT_EQ(path.back(), field->getNearestSource(node));
+        EXPECT_EQ(g.getNearestWith(node, graph::Property::charging), path.back());
+    }
+    EXPECT_EQ(g.getNearestWith(3, graph::Property::waiting), -1);
+
+    // Bridging the two halves moves the graph to a new epoch, the field is rebuilt on the next request
+    EXPECT_EQ(g.getDistanceField(graph::Property::charging), field);
+    g._addEdge(width * width - 4, width * width - 5);
+    g._freeze();
+    auto rebuilt = g.getDistanceField(graph::Property::charging);
+    EXPECT_NE(rebuilt, field);
+    EXPECT_EQ(rebuilt->getEpoch(), g.getEpoch());
+    EXPECT_EQ(rebuilt->getDistance(width * width - 5), 4);
+}
+
+TEST(GraphSpatialIndex, LookupAndSnap) {
+    TestGraph g;
+    buildLattice(g, 4, 3);
+
+    EXPECT_EQ(g.getNodeAt(2 * SCALE, SCALE), 6);
+    EXPECT_EQ(g.getNodeAt(2 * SCALE + 1, SCALE), -1);
+    EXPECT_EQ(g.getNearestNode(2.4f * SCALE, 0.8f * SCALE), 6);
+    EXPECT_EQ(g.getNearestNode(-3.0f * SCALE, -2.0f * SCALE), 0);
+    EXPECT_EQ(g.getNearestNode(1000.0f * SCALE, 1.0f * SCALE), 7); // Beyond the ring search
+
+    g.clear();
+    EXPECT_EQ(g.getNodeAt(2 * SCALE, SCALE), -1);
+    EXPECT_EQ(g.getNearestNode(0.0f, 0.0f), -1);
+}
+
+TEST(GraphRenumber, HilbertOrderKeepsIdentifiersRoutesAndTightensEdges) {
+    // 16 x 16 lattice added in a shuffled order, with some links missing and a few charging stations
+    TestGraph g;
+    const int width = 16;
+    std::vector<int> shuffled(width * width);
+    for (int k = 0; k < width * width; ++k)
+        shuffled[k] = (k * 97) % (width * width); // 97 is coprime with 256
+    for (int id : shuffled)
+        g._addNode(id, (id % width) * SCALE, (id / width) * SCALE, id % 37 == 0 ? graph::Property::charging : graph::Property::node);
+    std::vector<std::pair<int, int>> edges; // By identifier
+    for (int id = 0; id < width * width; ++id)
+    {
+        if (id % width + 1 < width && id % 5 != 2)
+            edges.emplace_back(id, id + 1);
+        if (id + width < width * width)
+            edges.emplace_back(id, id + width);
+    }
+    for (auto [a, b] : edges)
+        g._addEdge(g.getNodeIndex(a), g.getNodeIndex(b));
+    g._freeze();
+
+    auto spread = [&g]
+    {
+        long total = 0;
+        for (int i = 0; i < g.getNumNodes(); ++i)
+            for (int j : g.getNeighbours(i))
+                total += std::abs(i - j);
+        return total;
+    };
+    std::vector<int> hops;
+    for (int a = 0; a < width * width; a += 7)
+        hops.push_back(g.getDistance(g.getNodeIndex(a), g.getNodeIndex(width * width - 1 - a)));
+    const long before = spread();
+    const auto epoch = g.getEpoch();
+
+    g.renumberNodes();
+    EXPECT_GT(g.getEpoch(), epoch);
+    EXPECT_LT(spread(), before);
+    EXPECT_TRUE(g.isLattice());
+    ASSERT_EQ(g.getNumEdges(), static_cast<int>(edges.size()));
+    for (auto [a, b] : edges)
+        EXPECT_EQ(g.isEdge(g.getNodeIndex(a), g.getNodeIndex(b)), 1);
+
+    for (int id = 0; id < width * width; ++id)
+    {
+        const int i = g.getNodeIndex(id);
+        ASSERT_NE(i, -1);
+        EXPECT_EQ(g.getNode(i).getId(), id);
+        EXPECT_EQ(g.getNodeAt((id % width) * SCALE, (id / width) * SCALE), i);
+    }
+    EXPECT_EQ(g.getNodeIndex(width * width), -1);
+
+    auto charging = g.getNodesWith(graph::Property::charging);
+    EXPECT_EQ(charging.size(), 7u);
+    EXPECT_TRUE(std::is_sorted(charging.begin(), charging.end()));
+    for (int i : charging)
+        EXPECT_EQ(g.getNode(i).getId() % 37, 0);
+
+    for (int a = 0, k = 0; a < width * width; a += 7, ++k)
+    {
+        const int i = g.getNodeIndex(a);
+        const int j = g.getNodeIndex(width * width - 1 - a);
+        EXPECT_EQ(g.getDistance(i, j), hops[k]);
+        EXPECT_EQ(g.getShortestPath(i, j, graph::SearchAlgorithm::jump_point).size(), g.getShortestPath(i, j).size());
+    }
+}
+
+TEST(GraphSnapshot, ReadersPinTheirVersionWhileNewGraphsArePublished) {
+    graph::GraphStore store;
+    ASSERT_NE(store.load(), nullptr);
+    EXPECT_EQ(store.load()->getNumNodes(), 0);
+    EXPECT_EQ(store.getVersion(), 0u);
+
+    auto first = std::make_shared<TestGraph>();
+    buildLattice(*first, 6, 6);
+    store.publish(first);
+    std::weak_ptr<const graph::Graph> watched = store.load();
+    first.reset();
+
+    // A pinned snapshot outlives its replacement and is freed with its last reader
+    auto pinned = store.load();
+    auto second = std::make_shared<TestGraph>();
+    buildLattice(*second, 3, 3);
+    store.publish(second);
+    EXPECT_EQ(store.getVersion(), 2u);
+    EXPECT_EQ(store.load()->getNumNodes(), 9);
+    EXPECT_EQ(pinned->getShortestPath(0, 35).size(), 11u);
+    EXPECT_FALSE(watched.expired());
+    pinned.reset();
+    EXPECT_TRUE(watched.expired());
+
+    // Readers always see a whole lattice, whichever version they load
+    std::atomic<bool> done{false};
+    std::atomic<int> failures{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r)
+    {
+        readers.emplace_back([&]
+                             {
+            graph::SearchWorkspace workspace;
+            std::vector<int> path;
+            while (!done)
+            {
+                auto graph = store.load();
+                const int n = graph->getNumNodes();
+                const int side = static_cast<int>(std::lround(std::sqrt(n)));
+                if (!graph->getShortestPath(0, n - 1, workspace, path) || static_cast<int>(path.size()) != 2 * side - 1)
+                    failures++;
+            } });
+    }
+    for (int side = 4; side < 24; ++side)
+    {
+        auto next = std::make_shared<TestGraph>();
+        buildLattice(*next, side, side);
+        store.publish(next);
+    }
+    done = true;
+    for (auto &reader : readers)
+        reader.join();
+    EXPECT_EQ(failures, 0);
+    EXPECT_EQ(store.getVersion(), 22u);
+}
+
+TEST(GraphFile, RoundTripKeepsArraysAndIndexesAndRejectsDamagedFiles) {
+    // 12 x 12 lattice with weighted rows and a few special nodes, contracted and with landmarks
+    TestGraph g;
+    const int width = 12;
+    for (int k = 0; k < width * width; ++k)
+        g._addNode(100 + k, (k % width) * SCALE, (k / width) * SCALE, static_cast<graph::Property>(k % 4));
+    for (int k = 0; k < width * width; ++k)
+    {
+        if (k % width + 1 < width)
+            g._addEdge(k, k + 1, 1 + k % 3);
+        if (k + width < width * width && k % 5 != 0)
+            g._addEdge(k, k + width, 2);
+    }
+    g._freeze();
+    g.renumberNodes();
+    g.buildContractionHierarchy();
+    g.buildLandmarks(4);
+
+    const std::string path = ::testing::TempDir() + "graph_file_test.bin";
+    ASSERT_TRUE(g.saveToFile(path));
+
+    TestGraph loaded;
+    ASSERT_TRUE(loaded.loadFromFile(path));
+    ASSERT_EQ(loaded.getNumNodes(), g.getNumNodes());
+    EXPECT_EQ(loaded.getNumEdges(), g.getNumEdges());
+    EXPECT_EQ(loaded.isLattice(), g.isLattice());
+    for (int i = 0; i < g.getNumNodes(); ++i)
+    {
+        EXPECT_EQ(loaded.getNode(i).getId(), g.getNode(i).getId());
+        EXPECT_EQ(loaded.getNode(i).getX(), g.getNode(i).getX());
+        EXPECT_EQ(loaded.getNode(i).getProperty(), g.getNode(i).getProperty());
+        EXPECT_EQ(loaded.getNodeIndex(g.getNode(i).getId()), i);
+        EXPECT_EQ(loaded.getNodeAt(g.getNode(i).getX(), g.getNode(i).getY()), i);
+        ASSERT_TRUE(std::ranges::equal(loaded.getNeighbours(i), g.getNeighbours(i)));
+        ASSERT_TRUE(std::ranges::equal(loaded.getEdgeWeights(i), g.getEdgeWeights(i)));
+    }
+    for (int p = 0; p < NUM_PROPERTIES; ++p)
+        EXPECT_TRUE(std::ranges::equal(loaded.getNodesWith(static_cast<graph::Property>(p)), g.getNodesWith(static_cast<graph::Property>(p))));
+
+    // The stored hierarchy and landmarks answer like the original ones
+    ASSERT_NE(loaded.getContractionHierarchy(), nullptr);
+    ASSERT_NE(loaded.getLandmarks(), nullptr);
+    EXPECT_EQ(loaded.getContractionHierarchy()->getNumShortcuts(), g.getContractionHierarchy()->getNumShortcuts());
+    for (int i = 0; i < g.getNumNodes(); i += 5)
+    {
+        const int j = g.getNumNodes() - 1 - i;
+        const int expected = g.getPathCost(g.getShortestPath(i, j, graph::SearchAlgorithm::dijkstra));
+        EXPECT_EQ(loaded.getPathCost(loaded.getShortestPath(i, j, graph::SearchAlgorithm::contraction_hierarchy)), expected);
+        EXPECT_EQ(loaded.getPathCost(loaded.getShortestPath(i, j, graph::SearchAlgorithm::alt)), expected);
+    }
+
+    // Truncated files and foreign files are refused and leave an empty graph
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto writeBytes = [&path](const std::string &content)
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    };
+    writeBytes(bytes.substr(0, bytes.size() / 2));
+    EXPECT_FALSE(loaded.loadFromFile(path));
+    EXPECT_EQ(loaded.getNumNodes(), 0);
+    std::string foreign = bytes;
+    foreign[0] ^= 0x5a;
+    writeBytes(foreign);
+    EXPECT_FALSE(loaded.loadFromFile(path));
+    EXPECT_FALSE(loaded.loadFromFile(path + ".missing"));
+
+    // A neighbour out of range is caught before it is used
+    std::string damaged = bytes;
+    graph::GraphFileHeader header;
+    std::memcpy(&header, damaged.data(), sizeof(header));
+    const int bad = g.getNumNodes() + 7;
+    std::memcpy(damaged.data() + header.offsets[static_cast<int>(graph::GraphSection::neighbours)], &bad, sizeof(bad));
+    writeBytes(damaged);
+    EXPECT_FALSE(loaded.loadFromFile(path));
+
+    // So are a row out of order and an arc whose reverse has another travel time
+    int node = 0;
+    std::size_t first = 0; // Position of the row of node in the neighbour array
+    while (g.getNeighbours(node).size() < 2)
+        first += g.getNeighbours(node++).size();
+    damaged = bytes;
+    char *row = damaged.data() + header.offsets[static_cast<int>(graph::GraphSection::neighbours)] + first * sizeof(int);
+    std::swap_ranges(row, row + sizeof(int), row + sizeof(int));
+    writeBytes(damaged);
+    EXPECT_FALSE(loaded.loadFromFile(path));
+    damaged = bytes;
+    const int heavier = g.getEdgeWeight(0, g.getNeighbours(0)[0]) + 1;
+    std::memcpy(damaged.data() + header.offsets[static_cast<int>(graph::GraphSection::weights)], &heavier, sizeof(heavier));
+    writeBytes(damaged);
+    EXPECT_FALSE(loaded.loadFromFile(path));
+    writeBytes(bytes);
+    EXPECT_TRUE(loaded.loadFromFile(path));
+    std::remove(path.c_str());
+}
+
+TEST(GraphImport, GridMapAndCsvListStreamIntoTheGraph) {
+    // Two aisles joined at the bottom, shorter lines leave their last cells empty
+    std::istringstream grid("P..#C\r\n"
+                            ".#.#.\n"
+                            "...W\n"
+                            "  .\n");
+    graph::ImportedGraph g;
+    ASSERT_TRUE(g.importGrid(grid));
+    EXPECT_EQ(g.getErrorLine(), 0);
+    ASSERT_EQ(g.getNumNodes(), 12);
+    EXPECT_EQ(g.getNumEdges(), 11);
+    EXPECT_TRUE(g.isLattice());
+
+    auto at = [&g](int x, int y)
+    { return g.getNodeAt(x * SCALE, y * SCALE); };
+    EXPECT_EQ(g.getNode(at(0, 0)).getProperty(), graph::Property::pickdrop);
+    EXPECT_EQ(g.getNode(at(4, 0)).getProperty(), graph::Property::charging);
+    EXPECT_EQ(g.getNode(at(3, 2)).getProperty(), graph::Property::waiting);
+    EXPECT_EQ(at(3, 0), -1);
+    EXPECT_EQ(at(4, 2), -1);
+    EXPECT_EQ(g.isEdge(at(2, 2), at(2, 3)), 1);
+    EXPECT_EQ(g.isEdge(at(0, 1), at(1, 1)), 0);
+    EXPECT_EQ(g.getDistance(at(0, 0), at(3, 2)), 5);
+    EXPECT_EQ(g.getDistance(at(0, 0), at(4, 0)), -1); // The charging aisle is cut off by the wall
+    EXPECT_EQ(g.getNearestWith(at(2, 3), graph::Property::waiting), at(3, 2));
+
+    std::istringstream bad_grid("...\n.x.\n");
+    EXPECT_FALSE(g.importGrid(bad_grid));
+    EXPECT_EQ(g.getErrorLine(), 2);
+    EXPECT_EQ(g.getNumNodes(), 0);
+
+    std::istringstream csv("# Three nodes in an L, the corner link is slow\n"
+                           "node,7,0,0,pickdrop\n"
+                           "node,8,50,0,node\n"
+                           "\n"
+                           "node,9,50,50,charging\r\n"
+                           "edge,7,8\n"
+                           "edge,8,9,400\n");
+    ASSERT_TRUE(g.importCsv(csv));
+    ASSERT_EQ(g.getNumNodes(), 3);
+    EXPECT_EQ(g.getEdgeWeight(g.getNodeIndex(7), g.getNodeIndex(8)), SCALE);
+    EXPECT_EQ(g.getEdgeWeight(g.getNodeIndex(9), g.getNodeIndex(8)), 400);
+    EXPECT_EQ(g.getNode(g.getNodeIndex(9)).getProperty(), graph::Property::charging);
+
+    for (const char *line : {"node,7,0,0,shelf\n", "node,7,0,0\n", "edge,7,8\n", "node,7,0,0,node\nnode,7,50,0,node\n",
+                             "node,7,0,0,node\nnode,8,0,0,node\n",
+                             "node,7,0,0,node\nnode,8,50,0,node\nedge,7,8,0\n", "vertex,1,2\n"})
+    {
+        std::istringstream invalid(line);
+        EXPECT_FALSE(g.importCsv(invalid)) << line;
+        EXPECT_GT(g.getErrorLine(), 0);
+    }
+    std::istringstream same_cell("node,7,0,0,node\n# Another node on the same cell\nnode,8,0,0,pickdrop\n");
+    EXPECT_FALSE(g.importCsv(same_cell));
+    EXPECT_EQ(g.getErrorLine(), 3);
+}
+
+TEST(GraphEdit, RepairedStructuresMatchRebuiltOnesAndTheSourceSnapshotIsKept) {
+    // 10 x 10 lattice, charging stations in two corners, every precomputed structure built
+    TestGraph g;
+    const int width = 10;
+    for (int k = 0; k < width * width; ++k)
+    {
+        bool charging = k == 0 || k == width * width - 1;
+        g._addNode(k, (k % width) * SCALE, (k / width) * SCALE, charging ? graph::Property::charging : graph::Property::node);
+    }
+    for (int k = 0; k < width * width; ++k)
+    {
+        if (k % width + 1 < width)
+            g._addEdge(k, k + 1);
+        if (k + width < width * width)
+            g._addEdge(k, k + width);
+    }
+    g._freeze();
+    ASSERT_TRUE(g.buildRoutingTable());
+    g.buildLandmarks(4);
+    g.buildHierarchy(3);
+    g.buildDistanceFields();
+
+    // Compares the repaired structures with structures built from scratch
+    auto expectRepaired = [](const graph::Graph &edited)
+    {
+        const int n = edited.getNumNodes();
+        if (const auto *table = edited.getRoutingTable())
+        {
+            graph::RoutingTable rebuilt(edited);
+            for (int i = 0; i < n; ++i)
+                for (int j = 0; j < n; ++j)
+                    ASSERT_EQ(table->getDistance(i, j), rebuilt.getDistance(i, j)) << i << " " << j;
+        }
+        auto field = edited.getDistanceField(graph::Property::charging);
+        graph::DistanceField rebuilt(edited, graph::Property::charging);
+        std::vector<int> path;
+        for (int i = 0; i < n; ++i)
+        {
+            ASSERT_EQ(field->getDistance(i), rebuilt.getDistance(i)) << i;
+            if (field->getPath(i, path))
+            {
+                EXPECT_EQ(edited.getPathCost(path), field->getDistance(i) * SCALE);
+                EXPECT_EQ(path.back(), field->getNearestSource(i));
+                EXPECT_EQ(edited.getNode(path.back()).getProperty(), graph::Property::charging);
+            }
+        }
+        for (int i = 0; i < n; i += 3)
+        {
+            for (int j = 1; j < n; j += 7)
+            {
+                auto route = edited.getShortestPath(i, j, graph::SearchAlgorithm::dijkstra);
+                const int cost = route.empty() ? -1 : edited.getPathCost(route);
+                if (edited.getLandmarks() && cost != -1)
+                {
+                    EXPECT_LE(edited.getLandmarks()->getLowerBound(i, j), cost);
+                }
+                if (auto hierarchy = edited.getHierarchy())
+                {
+                    EXPECT_EQ(hierarchy->getPath(i, j, path) ? edited.getPathCost(path) : -1, cost) << i << " " << j;
+                }
+                EXPECT_EQ(static_cast<int>(edited.getShortestPath(i, j, graph::SearchAlgorithm::alt).size()),
+                          static_cast<int>(route.size()));
+            }
+        }
+    };
+
+    // Walls cut the lattice in two, every edit works on a copy of the published graph
+    graph::Graph edited(g);
+    EXPECT_EQ(edited.getEpoch(), g.getEpoch());
+    for (int y = 0; y < width - 1; ++y)
+    {
+        ASSERT_TRUE(edited.removeEdge(y * width + 4, y * width + 5));
+        expectRepaired(edited);
+    }
+    EXPECT_FALSE(edited.removeEdge(4, 5));
+    EXPECT_EQ(edited.getShortestPath(0, 9).size(), 28u); // Around the wall through the last row
+    EXPECT_EQ(g.getShortestPath(0, 9).size(), 10u);      // The source graph is untouched
+    EXPECT_EQ(g.getDistanceField(graph::Property::charging)->getDistance(9), 9);
+    EXPECT_GT(edited.getEpoch(), g.getEpoch());
+    EXPECT_NE(edited.getRoutingTable(), nullptr);
+    EXPECT_NE(edited.getHierarchy(), nullptr);
+    EXPECT_TRUE(edited.isLattice());
+
+    // Opening a door shortens the routes again
+    ASSERT_TRUE(edited.addEdge(4, 5));
+    EXPECT_FALSE(edited.addEdge(4, 5));
+    expectRepaired(edited);
+    EXPECT_EQ(edited.getShortestPath(0, 9).size(), 10u);
+
+    // A new charging station outside the lattice, then a node taken out of the middle
+    const int station = edited.addNode(1000, width * SCALE, 5 * SCALE, graph::Property::charging);
+    ASSERT_EQ(station, width * width);
+    EXPECT_EQ(edited.addNode(1001, width * SCALE, 5 * SCALE, graph::Property::node), -1); // Position taken
+    ASSERT_TRUE(edited.addEdge(station, 5 * width + width - 1));
+    expectRepaired(edited);
+    EXPECT_EQ(edited.getNearestWith(5 * width + width - 2, graph::Property::charging), station);
+
+    const std::uint64_t before = edited.getEpoch();
+    ASSERT_TRUE(edited.removeNode(edited.getNodeIndex(55)));
+    EXPECT_EQ(edited.getEpoch(), before + 1); // One epoch for the node and all its edges
+    EXPECT_EQ(edited.getNumNodes(), width * width);
+    EXPECT_EQ(edited.getNodeIndex(55), -1);
+    EXPECT_EQ(edited.getNodeAt(5 * SCALE, 5 * SCALE), -1);
+    const int moved = edited.getNodeIndex(1000); // The last node took the index of the removed one
+    EXPECT_EQ(moved, 55);
+    EXPECT_EQ(edited.getNodeAt(width * SCALE, 5 * SCALE), moved);
+    EXPECT_EQ(edited.isEdge(moved, 5 * width + width - 1), 1);
+    EXPECT_EQ(edited.getNearestWith(5 * width + width - 2, graph::Property::charging), moved);
+    std::vector<int> stations(edited.getNodesWith(graph::Property::charging).begin(), edited.getNodesWith(graph::Property::charging).end());
+    std::ranges::sort(stations);
+    EXPECT_EQ(stations, (std::vector<int>{0, moved, width * width - 1}));
+    EXPECT_EQ(edited.getNodesWith(graph::Property::node).size(), static_cast<std::size_t>(width * width - 3));
+    EXPECT_EQ(std::ranges::count(edited.getNodesWith(graph::Property::node), width * width), 0);
+    expectRepaired(edited);
+    EXPECT_EQ(edited.getRoutingTable(), nullptr); // Sized by the number of nodes, built again on demand
+    ASSERT_TRUE(edited.buildRoutingTable());
+    edited.buildHierarchy(3);
+    expectRepaired(edited);
+
+    // An edge off the lattice with its own travel time turns the lattice into a weighted graph
+    ASSERT_TRUE(edited.addEdge(0, width * width - 1, 3));
+    EXPECT_FALSE(edited.isLattice());
+    EXPECT_EQ(edited.getRoutingTable(), nullptr);
+    expectRepaired(edited);
+    EXPECT_EQ(edited.getShortestPath(0, width * width - 1, graph::SearchAlgorithm::dijkstra).size(), 2u);
+}
+
+TEST(GraphRandom, GeneratedGraphIsConnected) {
+    graph::RandomGraph g;
+    g.genRandomGraph(200, 5, 5, 10);
+
+    ASSERT_GT(g.getNumNodes(), 2);
+    for (int i = 1; i < g.getNumNodes(); ++i)
+        EXPECT_FALSE(g.getShortestPath(0, i).empty());
+
+    // Generated edges always link lattice neighbours, so jump point search applies
+    EXPECT_TRUE(g.isLattice());
+    for (int i = 1; i < g.getNumNodes(); i += 3)
+        EXPECT_EQ(g.getShortestPath(0, i, graph::SearchAlgorithm::jump_point).size(), g.getShortestPath(0, i).size());
+}
+
+TEST(GraphRandom, RequestedCountsAreReachedInOneComponent) {
+    struct Request
+    {
+        int num_node, num_waiting, num_charging, num_pickdrop;
+    };
+    // Near one special node per normal node, up to the 2N + 2 cells around a straight line of N normal nodes
+    for (Request request : {Request{200, 5, 5, 10}, Request{1500, 15, 15, 75}, Request{40, 10, 10, 20}, Request{1, 0, 0, 2},
+                            Request{10, 5, 5, 5}, Request{1000, 300, 300, 300}, Request{10000, 3000, 3000, 3000},
+                            Request{40, 27, 27, 28}})
+    {
+        for (std::uint64_t seed : {1u, 2u, 3u})
+        {
+            graph::RandomGraph g{graph::Rng(seed)};
+            ASSERT_TRUE(g.genRandomGraph(request.num_node, request.num_waiting, request.num_charging, request.num_pickdrop));
+            EXPECT_EQ(g.getNodesWith(graph::Property::node).size(), static_cast<std::size_t>(request.num_node));
+            EXPECT_EQ(g.getNodesWith(graph::Property::waiting).size(), static_cast<std::size_t>(request.num_waiting));
+            EXPECT_EQ(g.getNodesWith(graph::Property::charging).size(), static_cast<std::size_t>(request.num_charging));
+            EXPECT_EQ(g.getNodesWith(graph::Property::pickdrop).size(), static_cast<std::size_t>(request.num_pickdrop));
+
+            // Special nodes are leaves and every node is reached from the first one
+            for (int i = 0; i < g.getNumNodes(); ++i)
+            {
+                if (g.getNode(i).getProperty() != graph::Property::node)
+                {
+                    ASSERT_EQ(g.getNeighbours(i).size(), 1u);
+                }
+            }
+            std::vector<std::pair<int, int>> queries;
+            for (int i = 0; i < g.getNumNodes(); ++i)
+                queries.emplace_back(0, i);
+            std::vector<int> costs(queries.size());
+            g.getShortestPaths(queries, costs);
+            EXPECT_EQ(std::ranges::count(costs, -1), 0);
+        }
+    }
+
+    // A single normal node has room for four leaves only, 40 normal nodes for 82
+    graph::RandomGraph g;
+    EXPECT_FALSE(g.genRandomGraph(40, 28, 27, 28));
+    EXPECT_FALSE(g.genRandomGraph(1, 0, 0, 6));
+    EXPECT_EQ(g.getNodesWith(graph::Property::pickdrop).size(), 4u);
+    EXPECT_FALSE(g.genRandomGraph(0, 1, 1, 1));
+    EXPECT_EQ(g.getNumNodes(), 0);
+}
+
+TEST(GraphRandom, SameSeedGivesSameGraphAndTasks) {
+    graph::RandomGraph a(graph::Rng(7));
+    graph::RandomGraph b(graph::Rng(7));
+    graph::RandomGraph c(graph::Rng(8));
+    a.genRandomGraph(500, 10, 10, 30);
+    b.genRandomGraph(500, 10, 10, 30);
+    c.genRandomGraph(500, 10, 10, 30);
+
+    ASSERT_EQ(a.getNumNodes(), b.getNumNodes());
+    ASSERT_EQ(a.getNumEdges(), b.getNumEdges());
+    bool same_as_c = a.getNumNodes() == c.getNumNodes();
+    for (int i = 0; i < a.getNumNodes(); ++i)
+    {
+        ASSERT_EQ(a.getNode(i).getId(), b.getNode(i).getId());
+        ASSERT_EQ(a.getNode(i).getX(), b.getNode(i).getX());
+        ASSERT_EQ(a.getNode(i).getY(), b.getNode(i).getY());
+        ASSERT_EQ(a.getNode(i).getProperty(), b.getNode(i).getProperty());
+        same_as_c = same_as_c && a.getNode(i).getX() == c.getNode(i).getX() && a.getNode(i).getY() == c.getNode(i).getY();
+    }
+    EXPECT_FALSE(same_as_c);
+
+    graph::Rng first(42);
+    graph::Rng second(42);
+    for (int k = 0; k < 100; ++k)
+    {
+        int pickdrop = a.getRandomPickDrop(first);
+        ASSERT_EQ(pickdrop, a.getRandomPickDrop(second));
+        ASSERT_EQ(a.getNode(pickdrop).getProperty(), graph::Property::pickdrop);
+        int value = first.below(10);
+        ASSERT_EQ(value, second.below(10));
+        ASSERT_TRUE(value >= 0 && value < 10);
+    }
+}
+
+TEST(GraphWarehouse, TemplateLaysOutAislesStationsAndCrossAisles) {
+    graph::WarehouseLayout layout;
+    layout.num_aisles = 3;
+    layout.aisle_length = 9;
+    layout.rack_depth = 1;
+    layout.cross_aisle_spacing = 4;
+    layout.pickdrop_spacing = 2;
+    layout.charging_spacing = 4;
+    layout.waiting_spacing = 3;
+    graph::WarehouseGraph g;
+    ASSERT_TRUE(g.genWarehouseGraph(layout));
+
+    // 9 columns: 3 cross-aisles of 9 cells, 8 aisle rows of 3 cells, pick-drop stations on 4 of those rows,
+    // charging spots in columns 0, 4, 8 and waiting spots in columns 3, 6
+    EXPECT_EQ(g.getNumNodes(), 80);
+    int counts[4] = {};
+    for (int i = 0; i < g.getNumNodes(); ++i)
+    {
+        const auto prop = g.getNode(i).getProperty();
+        counts[static_cast<int>(prop)]++;
+        EXPECT_EQ(g.getNodeIndex(g.getNode(i).getId()), i);
+        EXPECT_EQ(g.getNodeAt(g.getNode(i).getX(), g.getNode(i).getY()), i);
+        if (prop != graph::Property::node)
+        {
+            // Stations are leaves hanging off a corridor cell
+            ASSERT_EQ(g.getNeighbours(i).size(), 1u);
+            EXPECT_EQ(g.getNode(g.getNeighbours(i)[0]).getProperty(), graph::Property::node);
+        }
+    }
+    EXPECT_EQ(counts[static_cast<int>(graph::Property::node)], 51);
+    EXPECT_EQ(counts[static_cast<int>(graph::Property::pickdrop)], 24);
+    EXPECT_EQ(counts[static_cast<int>(graph::Property::charging)], 3);
+    EXPECT_EQ(counts[static_cast<int>(graph::Property::waiting)], 2);
+    EXPECT_EQ(g.getNumEdges(), 51 - 1 + 2 * 2 + 29); // A spanning tree of the corridors, 2 cycles per block, 29 stations
+
+    EXPECT_TRUE(g.isLattice());
+    for (int i = 1; i < g.getNumNodes(); ++i)
+        EXPECT_FALSE(g.getShortestPath(0, i).empty());
+    graph::Rng rng(3);
+    EXPECT_NE(g.getRandomPickDrop(rng), -1);
+
+    layout.rack_depth = 0;
+    EXPECT_FALSE(g.genWarehouseGraph(layout));
+    EXPECT_EQ(g.getNumNodes(), 0);
+}
+
+TEST(GraphWarehouse, StreamedFileLoadsAsTheGeneratedGraph) {
+    graph::WarehouseLayout layout;
+    layout.num_aisles = 4;
+    layout.aisle_length = 12;
+    layout.rack_depth = 2;
+    layout.cross_aisle_spacing = 5;
+    const char *path = "test_warehouse.bin";
+    ASSERT_TRUE(graph::WarehouseGraph::genWarehouseFile(layout, path));
+
+    graph::WarehouseGraph expected;
+    ASSERT_TRUE(expected.genWarehouseGraph(layout));
+    graph::Graph loaded;
+    ASSERT_TRUE(loaded.loadFromFile(path));
+    ASSERT_EQ(loaded.getNumNodes(), expected.getNumNodes());
+    EXPECT_EQ(loaded.getNumEdges(), expected.getNumEdges());
+    EXPECT_TRUE(loaded.isLattice());
+
+    // Both graphs number their nodes differently, they are matched by their cells
+    for (int i = 0; i < loaded.getNumNodes(); ++i)
+    {
+        const auto &node = loaded.getNode(i);
+        ASSERT_EQ(loaded.getNodeIndex(node.getId()), i);
+        const int j = expected.getNodeAt(node.getX(), node.getY());
+        ASSERT_NE(j, -1);
+        EXPECT_EQ(node.getProperty(), expected.getNode(j).getProperty());
+        auto row = loaded.getNeighbours(i);
+        ASSERT_EQ(row.size(), expected.getNeighbours(j).size());
+        for (int neighbour : row)
+            EXPECT_EQ(expected.isEdge(j, expected.getNodeAt(loaded.getNode(neighbour).getX(), loaded.getNode(neighbour).getY())), 1);
+    }
+    for (int i = 1; i < loaded.getNumNodes(); i += 5)
+        EXPECT_EQ(loaded.getShortestPath(0, i, graph::SearchAlgorithm::jump_point).size(), loaded.getShortestPath(0, i).size());
+
+    // The sections can also be scanned in place without loading the graph
+    {
+        graph::GraphFileReader reader(path, false);
+        ASSERT_TRUE(reader.isValid());
+        EXPECT_EQ(reader.getSection(graph::GraphSection::ids).size(), static_cast<std::size_t>(loaded.getNumNodes()));
+        EXPECT_TRUE(reader.getSection(graph::GraphSection::spatial_keys).empty());
+    }
+    std::remove(path);
+
+    layout.num_aisles = 0;
+    EXPECT_FALSE(graph::WarehouseGraph::genWarehouseFile(layout, path));
+}
+
+int testgraph(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    ::testing::GTEST_FLAG(filter) = "Graph*";
+    return RUN_ALL_TESTS();
+}